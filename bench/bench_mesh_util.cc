@@ -0,0 +1,294 @@
+/**
+ * @file bench_mesh_util.cc
+ * @brief Micro-benchmarks of the mesh kernels in mesh_util.h, mesh_loader.h
+ *        and bvh.h, over icospheres of 20 to 1.3M triangles.
+ *
+ * Usage: bench_mesh_util [--filter=SUBSTRING] [--min_time=SECONDS]
+ *                        [--format=console|csv]
+ *
+ * The argument of each run is the number of triangles (columns, for
+ * CrossCol). ReorientMeshNormals runs both on one closed icosphere and on
+ * as many separate icosahedra, which it orients in parallel. From 320
+ * triangles, the icospheres are smooth enough that ComputeCreasedNormals
+ * splits no vertices.
+ *
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "bvh.h"
+#include "mesh_loader.h"
+#include "mesh_util.h"
+#include "microbench.h"
+
+namespace {
+
+using librender::microbench::State;
+
+struct Mesh {
+  // Row-major, 3 per vertex and 3 per face.
+  std::vector<double> v;
+  std::vector<int> f;
+};
+
+/**
+ * @brief \a count unit icospheres subdivided \a level times, side by side:
+ *        20 * 4^level triangles each.
+ */
+Mesh GenerateIcospheres(int level, int count) {
+  const double t = (1 + std::sqrt(5.0)) / 2;
+  std::vector<double> v = {-1, t,  0, 1,  t,  0, -1, -t, 0, 1,  -t, 0,
+                           0,  -1, t, 0,  1,  t, 0,  -1, -t, 0, 1,  -t,
+                           t,  0,  -1, t, 0,  1, -t, 0,  -1, -t, 0,  1};
+  std::vector<int> f = {0, 11, 5,  0, 5,  1, 0, 1, 7, 0, 7,  10, 0, 10,
+                        11, 1, 5,  9, 5,  11, 4, 11, 10, 2, 10, 7,  6, 7,
+                        1,  8, 3,  9, 4,  3, 4, 2, 3,  2, 6,  3,  6, 8,
+                        3,  8, 9,  4, 9,  5, 2, 4, 11, 6, 2,  10, 8, 6,
+                        7,  9, 8,  1};
+  for (int i = 0; i < level; ++i) {
+    // Midpoint of each edge, shared by both of its faces.
+    std::unordered_map<uint64_t, int> midpoints;
+    auto midpoint = [&](int a, int b) {
+      uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+      auto it = midpoints.find(key);
+      if (it != midpoints.end()) return it->second;
+      int index = v.size() / 3;
+      for (int k = 0; k < 3; ++k)
+        v.push_back((v[3 * a + k] + v[3 * b + k]) / 2);
+      midpoints[key] = index;
+      return index;
+    };
+    std::vector<int> subdivided;
+    subdivided.reserve(f.size() * 4);
+    for (size_t j = 0; j < f.size(); j += 3) {
+      int a = f[j], b = f[j + 1], c = f[j + 2];
+      int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+      subdivided.insert(subdivided.end(),
+                        {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+    }
+    f.swap(subdivided);
+  }
+  for (size_t i = 0; i < v.size(); i += 3) {
+    double norm =
+        std::sqrt(v[i] * v[i] + v[i + 1] * v[i + 1] + v[i + 2] * v[i + 2]);
+    for (int k = 0; k < 3; ++k) v[i + k] /= norm;
+  }
+
+  Mesh mesh;
+  for (int i = 0; i < count; ++i) {
+    int base = mesh.v.size() / 3;
+    for (size_t j = 0; j < v.size(); j += 3)
+      mesh.v.insert(mesh.v.end(), {v[j] + 2.5 * i, v[j + 1], v[j + 2]});
+    for (int index : f) mesh.f.push_back(base + index);
+  }
+  return mesh;
+}
+
+/**
+ * @brief The icosphere with the most triangles not above \a num_faces, or
+ *        \a num_faces / 20 icosahedra if \a is_separate. Generated once.
+ */
+const Mesh& Icospheres(int64_t num_faces, bool is_separate = false) {
+  static std::map<std::pair<int64_t, bool>, Mesh> cache;
+  auto key = std::make_pair(num_faces, is_separate);
+  auto it = cache.find(key);
+  if (it != cache.end()) return it->second;
+
+  int level = 0, count = std::max<int64_t>(num_faces / 20, 1);
+  if (!is_separate) {
+    while (20 * std::pow(4.0, level + 1) <= num_faces) level++;
+    count = 1;
+  }
+  return cache[key] = GenerateIcospheres(level, count);
+}
+
+void ToEigen(const Mesh& mesh, Eigen::MatrixX3d& v, Eigen::MatrixX3i& f) {
+  v.resize(mesh.v.size() / 3, 3);
+  for (int i = 0; i < v.rows(); ++i)
+    v.row(i) << mesh.v[3 * i], mesh.v[3 * i + 1], mesh.v[3 * i + 2];
+  f.resize(mesh.f.size() / 3, 3);
+  for (int i = 0; i < f.rows(); ++i)
+    f.row(i) << mesh.f[3 * i], mesh.f[3 * i + 1], mesh.f[3 * i + 2];
+}
+
+void ToArma(const Mesh& mesh, arma::fmat& v, librender::IndexMat& f) {
+  v.set_size(3, mesh.v.size() / 3);
+  for (size_t i = 0; i < mesh.v.size(); ++i) v(i % 3, i / 3) = mesh.v[i];
+  f.set_size(3, mesh.f.size() / 3);
+  for (size_t i = 0; i < mesh.f.size(); ++i) f(i % 3, i / 3) = mesh.f[i];
+}
+
+// 9 floats per triangle, as Bvh::Build() takes them.
+std::vector<float> ToTriangles(const Mesh& mesh) {
+  std::vector<float> triangles;
+  triangles.reserve(3 * mesh.f.size());
+  for (int index : mesh.f) {
+    for (int k = 0; k < 3; ++k) triangles.push_back(mesh.v[3 * index + k]);
+  }
+  return triangles;
+}
+
+void BM_ComputeConnectivity(State& state) {
+  Eigen::MatrixX3d v;
+  Eigen::MatrixX3i f;
+  ToEigen(Icospheres(state.range(0)), v, f);
+  state.SetComplexityN(f.rows());
+  while (state.KeepRunning()) {
+    librender::util::Connectivity conn;
+    librender::util::ComputeConnectivity(f, v.rows(), conn);
+  }
+}
+BENCHMARK(BM_ComputeConnectivity)->RangeMultiplier(4)->Range(20, 1310720);
+
+void BM_FindConnectedComponents(State& state) {
+  Eigen::MatrixX3d v;
+  Eigen::MatrixX3i f;
+  ToEigen(Icospheres(state.range(0)), v, f);
+  librender::util::Connectivity conn;
+  librender::util::ComputeConnectivity(f, v.rows(), conn);
+  state.SetComplexityN(f.rows());
+  while (state.KeepRunning()) {
+    std::vector<std::vector<int>> components;
+    librender::util::FindConnectedComponents(conn, components);
+  }
+}
+BENCHMARK(BM_FindConnectedComponents)
+    ->RangeMultiplier(4)
+    ->Range(20, 1310720);
+
+void BM_FindOneFaceNormal(State& state) {
+  Eigen::MatrixX3d v;
+  Eigen::MatrixX3i f;
+  ToEigen(Icospheres(state.range(0)), v, f);
+  state.SetComplexityN(f.rows());
+  while (state.KeepRunning()) {
+    int face_index;
+    Eigen::RowVector3d normal;
+    Eigen::Matrix<double, 1, 6> line;
+    librender::util::FindOneFaceNormal(v, f, face_index, normal, line);
+  }
+}
+BENCHMARK(BM_FindOneFaceNormal)->RangeMultiplier(4)->Range(20, 81920);
+
+void BM_BuildBvh(State& state) {
+  std::vector<float> triangles = ToTriangles(Icospheres(state.range(0)));
+  size_t num_triangles = triangles.size() / 9;
+  state.SetComplexityN(num_triangles);
+  while (state.KeepRunning()) {
+    librender::Bvh bvh;
+    bvh.Build(triangles.data(), num_triangles);
+  }
+}
+BENCHMARK(BM_BuildBvh)->RangeMultiplier(4)->Range(20, 1310720);
+
+// 1000 lines through the origin.
+void BM_IntersectBvh(State& state) {
+  std::vector<float> triangles = ToTriangles(Icospheres(state.range(0)));
+  librender::Bvh bvh;
+  bvh.Build(triangles.data(), triangles.size() / 9);
+  std::vector<float> directions(3000);
+  for (float& x : directions) x = rand() / (float)RAND_MAX * 2 - 1;
+  const float origin[3] = {0, 0, 0};
+  const float kInfinity = std::numeric_limits<float>::infinity();
+  state.SetComplexityN(bvh.NumTriangles());
+  std::vector<librender::Bvh::Hit> hits;
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < directions.size(); i += 3)
+      bvh.Intersect(origin, &directions[i], -kInfinity, kInfinity, hits);
+  }
+}
+BENCHMARK(BM_IntersectBvh)->RangeMultiplier(4)->Range(20, 1310720);
+
+void BM_ReorientMeshNormals(State& state) {
+  Eigen::MatrixX3d v;
+  Eigen::MatrixX3i f;
+  ToEigen(Icospheres(state.range(0), true), v, f);
+  Eigen::MatrixX3i f_out(f.rows(), 3);
+  state.SetComplexityN(f.rows());
+  while (state.KeepRunning()) {
+    librender::util::ReorientMeshNormals(f, v, f_out);
+  }
+}
+BENCHMARK(BM_ReorientMeshNormals)->RangeMultiplier(4)->Range(20, 81920);
+
+void BM_ReorientMeshNormalsClosed(State& state) {
+  Eigen::MatrixX3d v;
+  Eigen::MatrixX3i f;
+  ToEigen(Icospheres(state.range(0)), v, f);
+  Eigen::MatrixX3i f_out(f.rows(), 3);
+  state.SetComplexityN(f.rows());
+  while (state.KeepRunning()) {
+    librender::util::ReorientMeshNormals(f, v, f_out);
+  }
+}
+BENCHMARK(BM_ReorientMeshNormalsClosed)->RangeMultiplier(4)->Range(20, 81920);
+
+void BM_ComputeNormals(State& state) {
+  arma::fmat v, vn;
+  librender::IndexMat f;
+  ToArma(Icospheres(state.range(0)), v, f);
+  state.SetComplexityN(f.n_cols);
+  while (state.KeepRunning()) {
+    librender::ComputeNormals(v, f, vn);
+  }
+}
+BENCHMARK(BM_ComputeNormals)->RangeMultiplier(4)->Range(20, 1310720);
+
+void BM_ComputeNormalsAngle(State& state) {
+  arma::fmat v, vn;
+  librender::IndexMat f;
+  ToArma(Icospheres(state.range(0)), v, f);
+  state.SetComplexityN(f.n_cols);
+  while (state.KeepRunning()) {
+    librender::ComputeNormals(v, f, vn, librender::NormalWeighting::kAngle);
+  }
+}
+BENCHMARK(BM_ComputeNormalsAngle)->RangeMultiplier(4)->Range(20, 1310720);
+
+void BM_ComputeCreasedNormals(State& state) {
+  librender::Shape original;
+  ToArma(Icospheres(state.range(0)), original.v, original.ind);
+  state.SetComplexityN(original.ind.n_cols);
+  while (state.KeepRunning()) {
+    // Includes the copy, as the mesh is split in place.
+    librender::Shape mesh = original;
+    librender::ComputeCreasedNormals(librender::kPi / 6,
+                                     librender::NormalWeighting::kArea, mesh);
+  }
+}
+BENCHMARK(BM_ComputeCreasedNormals)->RangeMultiplier(4)->Range(20, 1310720);
+
+void BM_CrossCol(State& state) {
+  arma::fmat a(3, state.range(0)), b(3, state.range(0)), c;
+  a.randu();
+  b.randu();
+  while (state.KeepRunning()) {
+    librender::CrossCol(a, b, c);
+  }
+}
+BENCHMARK(BM_CrossCol)->Range(1 << 10, 1 << 20);
+
+void BM_NormalizeCoords(State& state) {
+  arma::fmat v;
+  librender::IndexMat f;
+  ToArma(Icospheres(state.range(0)), v, f);
+  state.SetComplexityN(v.n_cols);
+  while (state.KeepRunning()) {
+    librender::NormalizeCoords(v);
+  }
+}
+BENCHMARK(BM_NormalizeCoords)->RangeMultiplier(4)->Range(20, 1310720);
+}
+
+BENCHMARK_MAIN()
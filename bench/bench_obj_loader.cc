@@ -0,0 +1,125 @@
+/**
+ * @file bench_obj_loader.cc
+ * @brief Load time of tinyobj::LoadObj and ParseObj on textured grids of 1M
+ *        to 20M face corners, held in memory, and of LoadObj from a file.
+ *
+ * Usage: bench_obj_loader [--filter=SUBSTRING] [--min_time=SECONDS]
+ *                         [--format=console|csv]
+ *
+ * Every corner is "v/vt/vn". Each row of quads has a texture seam every 16
+ * columns, where the same position is used with two texture coordinates.
+ *
+ * The peak memory of LoadObj is best compared with the shape it returns, of
+ * 48 bytes per vertex (positions, normals, texture coordinates and colors)
+ * and 12 per triangle. The grids have about one vertex per two triangles.
+ *
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "graphics.h"
+#include "mesh_loader.h"
+#include "microbench.h"
+#include "obj_parser.h"
+#include "shape.h"
+#include "third_party/tinyobjloader/tiny_obj_loader.h"
+
+namespace {
+
+using librender::microbench::State;
+
+/**
+ * @brief An n by n grid of triangles with about \a num_corners corners in
+ *        total. Generated once.
+ */
+const std::string& TexturedGridObj(int64_t num_corners) {
+  static std::map<int64_t, std::string> cache;
+  auto it = cache.find(num_corners);
+  if (it != cache.end()) return it->second;
+
+  int n = std::max<int>(std::sqrt(num_corners / 6.0), 1);
+  const int kSeamInterval = 16;
+  // The seam copy of column x is at vt index (n + 1)^2 + y * (n + 1) + x.
+  const int num_positions = (n + 1) * (n + 1);
+  std::ostringstream out;
+  out.precision(6);
+  for (int y = 0; y <= n; ++y) {
+    for (int x = 0; x <= n; ++x) {
+      out << "v " << (float)x / n << " " << (float)y / n << " "
+          << std::sin(x * 0.1f) * 0.05f << "\n";
+      out << "vn 0 0 1\n";
+      out << "vt " << (float)x / n << " " << (float)y / n << "\n";
+    }
+  }
+  for (int y = 0; y <= n; ++y) {
+    for (int x = 0; x <= n; ++x)
+      out << "vt " << (float)x / n + 0.5f << " " << (float)y / n << "\n";
+  }
+  for (int y = 0; y < n; ++y) {
+    for (int x = 0; x < n; ++x) {
+      int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+      // Quads left of a seam use the copy of its texture coordinates.
+      bool is_seam = (x + 1) % kSeamInterval == 0;
+      int bt = is_seam ? b + num_positions : b;
+      int dt = is_seam ? d + num_positions : d;
+      out << "f " << a << "/" << a << "/" << a << " " << b << "/" << bt << "/"
+          << b << " " << d << "/" << dt << "/" << d << "\n";
+      out << "f " << a << "/" << a << "/" << a << " " << d << "/" << dt << "/"
+          << d << " " << c << "/" << c << "/" << c << "\n";
+    }
+  }
+  return cache[num_corners] = out.str();
+}
+
+void BM_TinyObjLoadObj(State& state) {
+  const std::string& text = TexturedGridObj(state.range(0));
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::istringstream stream(text);
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    tinyobj::MaterialFileReader reader("");
+    state.ResumeTiming();
+    tinyobj::LoadObj(shapes, materials, stream, reader);
+    state.SetComplexityN(shapes[0].mesh.indices.size());
+  }
+}
+BENCHMARK(BM_TinyObjLoadObj)->RangeMultiplier(4)->Range(1 << 20, 20 << 20);
+
+void BM_ParseObj(State& state) {
+  const std::string& text = TexturedGridObj(state.range(0));
+  while (state.KeepRunning()) {
+    librender::ObjMesh mesh;
+    librender::ParseObj(text.data(), text.size(), 0, mesh);
+    state.SetComplexityN(mesh.indices.size());
+  }
+}
+BENCHMARK(BM_ParseObj)->RangeMultiplier(4)->Range(1 << 20, 20 << 20);
+
+void BM_LoadObj(State& state) {
+  const std::string filename = "/tmp/librender_bench_obj_loader.obj";
+  std::ofstream(filename, std::ios::binary) << TexturedGridObj(state.range(0));
+  librender::RenderParams params;
+  params.in_filename = filename;
+  while (state.KeepRunning()) {
+    librender::Shape mesh;
+    librender::LoadObj(params, mesh);
+    state.SetComplexityN(3 * mesh.ind.n_cols);
+  }
+  std::remove(filename.c_str());
+}
+BENCHMARK(BM_LoadObj)->RangeMultiplier(4)->Range(1 << 20, 20 << 20);
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,118 @@
+/**
+ * @file bench_png.cc
+ * @brief Compare the parallel PNG encoder and its png-compression presets
+ *        with lodepng.
+ *
+ * Usage: bench_png [num_threads] [num_repeats]
+ *
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#include "png_encoder.h"
+#include "third_party/lodepng/lodepng.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief Something that looks like a render: flat background, a shaded disk
+ *        with dark patches and a grid.
+ */
+std::vector<uint8_t> SyntheticImage(int w, int h) {
+  std::vector<uint8_t> rgba((size_t)w * h * 4);
+  float cx = w / 2.0f, cy = h / 2.0f, radius = std::min(w, h) * 0.4f;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      uint8_t* p = &rgba[((size_t)y * w + x) * 4];
+      float dx = (x - cx) / radius, dy = (y - cy) / radius;
+      float d2 = dx * dx + dy * dy;
+      int r = 255, g = 255, b = 255;
+      if (d2 < 1) {
+        float shade = 1 - d2;
+        r = 40 + 180 * shade;
+        g = 90 + 120 * shade;
+        b = 160 + 80 * shade;
+        if (((x / 16) + (y / 16)) % 7 == 0) r = g = b = 30;
+      } else if (x % 64 == 0 || y % 64 == 0) {
+        r = g = b = 200;
+      }
+      p[0] = std::min(std::max(r, 0), 255);
+      p[1] = std::min(std::max(g, 0), 255);
+      p[2] = std::min(std::max(b, 0), 255);
+      p[3] = 255;
+    }
+  }
+  return rgba;
+}
+
+template <typename Fn>
+double BestOfMs(int num_repeats, Fn fn) {
+  double best = 0;
+  for (int i = 0; i < num_repeats; ++i) {
+    auto start = Clock::now();
+    fn();
+    double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (i == 0 || ms < best) best = ms;
+  }
+  return best;
+}
+}
+
+int main(int argc, char* argv[]) {
+  int num_threads = argc > 1 ? atoi(argv[1]) : 0;
+  int num_repeats = argc > 2 ? atoi(argv[2]) : 3;
+
+  std::cout << std::setw(6) << "size" << std::setw(10) << "encoder"
+            << std::setw(12) << "ms" << std::setw(12) << "MB" << std::setw(12)
+            << "speedup" << std::endl;
+
+  for (int size : {1024, 4096, 8192}) {
+    std::vector<uint8_t> rgba = SyntheticImage(size, size);
+
+    std::vector<uint8_t> lodepng_out;
+    double lodepng_ms = BestOfMs(num_repeats, [&] {
+      lodepng_out.clear();
+      lodepng::encode(lodepng_out, rgba.data(), size, size);
+    });
+    std::cout << std::fixed << std::setprecision(1) << std::setw(6) << size
+              << std::setw(10) << "lodepng" << std::setw(12) << lodepng_ms
+              << std::setprecision(2) << std::setw(12)
+              << lodepng_out.size() / 1e6 << std::setw(11) << 1.0 << "x"
+              << std::endl;
+
+    for (const char* preset : {"store", "fast", "default", "best"}) {
+      librender::io::PngOptions options = librender::io::PngPreset(preset);
+      std::vector<uint8_t> out;
+      double ms = BestOfMs(num_repeats, [&] {
+        librender::io::EncodePNG(rgba.data(), size, size, out, options,
+                                 num_threads);
+      });
+
+      // The output has to decode to the input.
+      std::vector<uint8_t> decoded;
+      unsigned w, h;
+      unsigned error = lodepng::decode(decoded, w, h, out);
+      if (error || w != (unsigned)size || h != (unsigned)size ||
+          decoded != rgba)
+        throw std::runtime_error("Round trip failed: " +
+                                 std::string(lodepng_error_text(error)));
+
+      std::cout << std::fixed << std::setprecision(1) << std::setw(6) << size
+                << std::setw(10) << preset << std::setw(12) << ms
+                << std::setprecision(2) << std::setw(12) << out.size() / 1e6
+                << std::setw(11) << lodepng_ms / ms << "x" << std::endl;
+    }
+  }
+}
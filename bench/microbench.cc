@@ -0,0 +1,355 @@
+/**
+ * @file microbench.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "microbench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <errno.h>
+#include <iomanip>
+#include <iostream>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+std::atomic<int64_t> num_allocs(0);
+std::atomic<int64_t> num_alloc_bytes(0);
+std::atomic<int64_t> num_live_bytes(0);
+std::atomic<int64_t> peak_live_bytes(0);
+
+void CountLive(int64_t bytes) {
+  int64_t live =
+      num_live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !peak_live_bytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+void CountAlloc(size_t size) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  num_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+void* CountLive(void* ptr) {
+  if (ptr != nullptr) CountLive(malloc_usable_size(ptr));
+  return ptr;
+}
+#endif
+}
+
+#ifdef __GLIBC__
+// Every allocation, including those of Armadillo and Eigen which bypass
+// operator new, goes through these. They forward to glibc's allocator, so the
+// memory is released by its free(). Live memory is counted in usable sizes,
+// which free() can look up.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+  CountAlloc(size);
+  return CountLive(__libc_malloc(size));
+}
+
+void* calloc(size_t count, size_t size) {
+  CountAlloc(count * size);
+  return CountLive(__libc_calloc(count, size));
+}
+
+void* realloc(void* ptr, size_t size) {
+  CountAlloc(size);
+  int64_t old_size = (ptr != nullptr) ? malloc_usable_size(ptr) : 0;
+  void* result = __libc_realloc(ptr, size);
+  // Not moved or freed if it fails.
+  if (result != nullptr || size == 0) CountLive(-old_size);
+  return CountLive(result);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  CountAlloc(size);
+  return CountLive(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  CountAlloc(size);
+  return CountLive(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+  if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  CountAlloc(size);
+  void* result = CountLive(__libc_memalign(alignment, size));
+  if (result == nullptr) return ENOMEM;
+  *ptr = result;
+  return 0;
+}
+
+void free(void* ptr) {
+  if (ptr != nullptr) CountLive(-(int64_t)malloc_usable_size(ptr));
+  __libc_free(ptr);
+}
+}
+#endif
+
+namespace librender {
+namespace microbench {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch()).count();
+}
+
+std::vector<Benchmark*>& Registry() {
+  static std::vector<Benchmark*> benchmarks;
+  return benchmarks;
+}
+
+struct Run {
+  std::string name;
+  int64_t n;
+  int64_t iterations;
+  double ns_per_iteration;
+  double allocs_per_iteration;
+  double bytes_per_iteration;
+  int64_t peak_bytes;
+};
+
+/**
+ * @brief Run \a benchmark with \a arg for at least \a min_time seconds,
+ *        growing the number of iterations as Google Benchmark does.
+ */
+Run RunOne(const Benchmark& benchmark, int64_t arg, double min_time) {
+  int64_t iterations = 1;
+  while (true) {
+    State state(arg, iterations);
+    benchmark.function(state);
+    double seconds = state.elapsed_ns() * 1e-9;
+    if (seconds >= min_time || iterations >= 1000000000) {
+      std::ostringstream name;
+      name << benchmark.name << "/" << arg;
+      double count = state.iterations();
+      return {name.str(), state.complexity_n(), state.iterations(),
+              state.elapsed_ns() / count, state.num_allocs() / count,
+              state.num_alloc_bytes() / count, state.peak_bytes()};
+    }
+    // Aim 40% past the target so the next attempt is usually the last.
+    double multiplier = seconds > 0 ? min_time * 1.4 / seconds : 10;
+    multiplier = std::min(std::max(multiplier, 2.0), 10.0);
+    iterations = std::max<int64_t>(iterations * multiplier, iterations + 1);
+  }
+}
+
+std::string FormatTime(double ns) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(ns < 10 ? 2 : 0);
+  if (ns < 1e4) {
+    out << ns << " ns";
+  } else if (ns < 1e7) {
+    out << ns / 1e3 << " us";
+  } else {
+    out << ns / 1e6 << " ms";
+  }
+  return out.str();
+}
+
+void PrintConsoleHeader() {
+  std::cout << std::left << std::setw(40) << "Benchmark" << std::right
+            << std::setw(12) << "Time" << std::setw(12) << "Iterations"
+            << std::setw(12) << "Allocs" << std::setw(14) << "Bytes"
+            << std::setw(14) << "Peak" << std::endl
+            << std::string(104, '-') << std::endl;
+}
+
+void PrintConsole(const std::vector<Run>& runs, double exponent) {
+  for (const Run& run : runs) {
+    std::cout << std::left << std::setw(40) << run.name << std::right
+              << std::setw(12) << FormatTime(run.ns_per_iteration)
+              << std::setw(12) << run.iterations << std::fixed
+              << std::setprecision(1) << std::setw(12)
+              << run.allocs_per_iteration << std::setprecision(0)
+              << std::setw(14) << run.bytes_per_iteration << std::setw(14)
+              << run.peak_bytes << std::endl;
+  }
+  if (runs.size() > 1) {
+    std::string name = runs[0].name.substr(0, runs[0].name.rfind('/'));
+    std::cout << std::left << std::setw(40) << name + "_BigO" << std::right
+              << std::setw(12) << "n^" << std::setprecision(2) << exponent
+              << std::endl;
+  }
+}
+
+void PrintCsv(const std::vector<Run>& runs, double exponent) {
+  for (const Run& run : runs) {
+    std::cout << run.name << "," << run.n << "," << run.iterations << ","
+              << std::fixed << std::setprecision(1) << run.ns_per_iteration
+              << "," << run.allocs_per_iteration << ","
+              << run.bytes_per_iteration << "," << run.peak_bytes << ","
+              << std::setprecision(3)
+              << exponent << std::endl;
+  }
+}
+}
+
+State::State(int64_t arg, int64_t max_iterations)
+    : arg_(arg), max_iterations_(max_iterations), complexity_n_(arg) {}
+
+void State::PauseTiming() {
+  if (!is_running_) return;
+  elapsed_ns_ += NowNs() - start_ns_;
+  num_allocs_ += NumAllocs() - start_allocs_;
+  num_alloc_bytes_ += NumAllocBytes() - start_alloc_bytes_;
+  peak_bytes_ = std::max(peak_bytes_, PeakLiveBytes() - start_live_bytes_);
+  is_running_ = false;
+}
+
+void State::ResumeTiming() {
+  if (is_running_) return;
+  is_running_ = true;
+  start_allocs_ = NumAllocs();
+  start_alloc_bytes_ = NumAllocBytes();
+  start_live_bytes_ = ResetPeakLiveBytes();
+  start_ns_ = NowNs();
+}
+
+Benchmark* Benchmark::Arg(int64_t arg) {
+  args.push_back(arg);
+  return this;
+}
+
+Benchmark* Benchmark::Range(int64_t lo, int64_t hi) {
+  for (int64_t arg = lo; arg < hi; arg *= range_multiplier) args.push_back(arg);
+  args.push_back(hi);
+  return this;
+}
+
+Benchmark* Benchmark::RangeMultiplier(int multiplier) {
+  range_multiplier = multiplier;
+  return this;
+}
+
+Benchmark* RegisterBenchmark(const char* name, Function function) {
+  Benchmark* benchmark = new Benchmark(name, function);
+  Registry().push_back(benchmark);
+  return benchmark;
+}
+
+int64_t NumAllocs() { return num_allocs.load(std::memory_order_relaxed); }
+
+int64_t NumAllocBytes() {
+  return num_alloc_bytes.load(std::memory_order_relaxed);
+}
+
+int64_t PeakLiveBytes() {
+  return peak_live_bytes.load(std::memory_order_relaxed);
+}
+
+int64_t ResetPeakLiveBytes() {
+  int64_t live = num_live_bytes.load(std::memory_order_relaxed);
+  peak_live_bytes.store(live, std::memory_order_relaxed);
+  return live;
+}
+
+bool CountsAllocs() {
+#ifdef __GLIBC__
+  return true;
+#else
+  return false;
+#endif
+}
+
+double FitExponent(const std::vector<int64_t>& n,
+                   const std::vector<double>& time) {
+  size_t count = std::min(n.size(), time.size());
+  if (count < 2) return 0;
+  double mean_x = 0, mean_y = 0;
+  for (size_t i = 0; i < count; ++i) {
+    mean_x += std::log((double)n[i]) / count;
+    mean_y += std::log(time[i]) / count;
+  }
+  double sxy = 0, sxx = 0;
+  for (size_t i = 0; i < count; ++i) {
+    double dx = std::log((double)n[i]) - mean_x;
+    sxy += dx * (std::log(time[i]) - mean_y);
+    sxx += dx * dx;
+  }
+  return sxx > 0 ? sxy / sxx : 0;
+}
+
+int RunSpecifiedBenchmarks(int argc, char* argv[]) {
+  std::string filter, format = "console";
+  double min_time = 0.5;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--filter=", 9) == 0) {
+      filter = argv[i] + 9;
+    } else if (strncmp(argv[i], "--min_time=", 11) == 0) {
+      min_time = atof(argv[i] + 11);
+    } else if (strncmp(argv[i], "--format=", 9) == 0) {
+      format = argv[i] + 9;
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--filter=SUBSTRING] [--min_time=SECONDS]"
+                   " [--format=console|csv]" << std::endl;
+      return 1;
+    }
+  }
+  if (format != "console" && format != "csv") {
+    std::cerr << "Unknown format: " << format << std::endl;
+    return 1;
+  }
+
+  if (format == "csv") {
+    std::cout << "name,n,iterations,ns_per_iteration,allocs_per_iteration,"
+                 "bytes_per_iteration,peak_bytes,exponent" << std::endl;
+  } else {
+    if (!CountsAllocs())
+      std::cout << "Allocations are not counted on this platform."
+                << std::endl;
+    PrintConsoleHeader();
+  }
+
+  for (const Benchmark* benchmark : Registry()) {
+    if (benchmark->name.find(filter) == std::string::npos) continue;
+    std::vector<int64_t> args = benchmark->args;
+    if (args.empty()) args.push_back(0);
+
+    std::vector<Run> runs;
+    std::vector<int64_t> n;
+    std::vector<double> time;
+    for (int64_t arg : args) {
+      runs.push_back(RunOne(*benchmark, arg, min_time));
+      n.push_back(runs.back().n);
+      time.push_back(runs.back().ns_per_iteration);
+    }
+    double exponent = FitExponent(n, time);
+    if (format == "csv") {
+      PrintCsv(runs, exponent);
+    } else {
+      PrintConsole(runs, exponent);
+    }
+  }
+  return 0;
+}
+}
+}
@@ -0,0 +1,135 @@
+/**
+ * @file microbench.h
+ * @brief A minimal micro-benchmark harness with the interface of Google
+ *        Benchmark: functions registered with BENCHMARK() loop on
+ *        State::KeepRunning() and are run over a range of input sizes.
+ *
+ *   void BM_Kernel(microbench::State& state) {
+ *     Input input = MakeInput(state.range(0));
+ *     while (state.KeepRunning()) Kernel(input);
+ *   }
+ *   BENCHMARK(BM_Kernel)->Range(1 << 10, 1 << 20);
+ *
+ * Each run reports the time and the heap allocations per iteration, and the
+ * most heap memory in use at once during an iteration beyond what was in use
+ * before it. Over the sizes of a benchmark, the time is fitted to c * n^k and
+ * k is reported, so that a change in the scaling of a kernel shows up as a
+ * change in k.
+ *
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace librender {
+namespace microbench {
+
+/**
+ * @brief Passed to a benchmark function. Only the time and the allocations
+ *        between the first and the last call to KeepRunning() are counted,
+ *        minus those between PauseTiming() and ResumeTiming().
+ */
+class State {
+ public:
+  State(int64_t arg, int64_t max_iterations);
+
+  bool KeepRunning() {
+    if (num_iterations_ == 0 && !is_running_) ResumeTiming();
+    if (num_iterations_ < max_iterations_) {
+      ++num_iterations_;
+      return true;
+    }
+    PauseTiming();
+    return false;
+  }
+
+  void PauseTiming();
+  void ResumeTiming();
+
+  int64_t range(int index = 0) const { return arg_; }
+  // Size of the input that the scaling curve is fitted against. Defaults to
+  // range(0).
+  void SetComplexityN(int64_t n) { complexity_n_ = n; }
+
+  int64_t iterations() const { return num_iterations_; }
+  int64_t elapsed_ns() const { return elapsed_ns_; }
+  int64_t num_allocs() const { return num_allocs_; }
+  int64_t num_alloc_bytes() const { return num_alloc_bytes_; }
+  // Largest over the iterations.
+  int64_t peak_bytes() const { return peak_bytes_; }
+  int64_t complexity_n() const { return complexity_n_; }
+
+ private:
+  int64_t arg_;
+  int64_t max_iterations_;
+  int64_t num_iterations_ = 0;
+  int64_t complexity_n_;
+  bool is_running_ = false;
+
+  int64_t start_ns_ = 0;
+  int64_t start_allocs_ = 0;
+  int64_t start_alloc_bytes_ = 0;
+  int64_t elapsed_ns_ = 0;
+  int64_t num_allocs_ = 0;
+  int64_t num_alloc_bytes_ = 0;
+  int64_t start_live_bytes_ = 0;
+  int64_t peak_bytes_ = 0;
+};
+
+typedef void (*Function)(State&);
+
+/**
+ * @brief A registered function and the sizes it is run with.
+ */
+class Benchmark {
+ public:
+  Benchmark(const char* name, Function function)
+      : name(name), function(function) {}
+
+  Benchmark* Arg(int64_t arg);
+  // \a lo, then powers of the range multiplier times \a lo, up to \a hi.
+  Benchmark* Range(int64_t lo, int64_t hi);
+  Benchmark* RangeMultiplier(int multiplier);
+
+  std::string name;
+  Function function;
+  std::vector<int64_t> args;
+  int range_multiplier = 8;
+};
+
+Benchmark* RegisterBenchmark(const char* name, Function function);
+// Flags: --filter=SUBSTRING, --min_time=SECONDS, --format=console|csv.
+int RunSpecifiedBenchmarks(int argc, char* argv[]);
+// Heap allocations made by this process so far. Zero where they cannot be
+// counted.
+int64_t NumAllocs();
+int64_t NumAllocBytes();
+// Most heap memory in use at once since the last reset, which returns the
+// memory in use.
+int64_t PeakLiveBytes();
+int64_t ResetPeakLiveBytes();
+bool CountsAllocs();
+// Least-squares slope of log(time) over log(n).
+double FitExponent(const std::vector<int64_t>& n,
+                   const std::vector<double>& time);
+}
+}
+
+#define MICROBENCH_CONCAT2(a, b) a##b
+#define MICROBENCH_CONCAT(a, b) MICROBENCH_CONCAT2(a, b)
+#define BENCHMARK(function)                                            \
+  static ::librender::microbench::Benchmark* MICROBENCH_CONCAT(        \
+      microbench_registered_, __LINE__) __attribute__((unused)) =      \
+      ::librender::microbench::RegisterBenchmark(#function, function)
+
+#define BENCHMARK_MAIN()                                               \
+  int main(int argc, char* argv[]) {                                   \
+    return ::librender::microbench::RunSpecifiedBenchmarks(argc, argv); \
+  }
@@ -0,0 +1,394 @@
+/**
+ * @file render_bench.cc
+ * @brief End-to-end throughput of the off-screen pipeline (load, normals,
+ *        render, encode) on synthetic meshes: icospheres and noisy grids of
+ *        one or several connected components, with and without normals.
+ *
+ * Usage: render_bench [--max-triangles N] [--resolutions 256,1024]
+ *                     [--msaa 0,4] [--repeats 4] [--format csv|json] ...
+ *
+ * Meshes are written as .obj files into a temporary directory, so that the
+ * parser is part of the measurement. One row is reported per mesh,
+ * resolution and MSAA level, with the time spent in each stage.
+ *
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include "config.h"
+#include "graphics.h"
+#include "pipeline.h"
+#include "profiler.h"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Stages that get a column of their own in CSV output.
+const char* kCsvStages[] = {"parse", "normals",  "upload",     "compile",
+                            "draw",  "readback", "encode png", "write"};
+
+enum class MeshKind { kIcosphere, kGrid };
+
+struct MeshSpec {
+  MeshKind kind;
+  size_t target_triangles;
+  int num_components;
+  bool has_normals;
+};
+
+struct Mesh {
+  std::vector<float> v, vn;
+  std::vector<uint32_t> f;
+};
+
+std::string KindName(MeshKind kind) {
+  return kind == MeshKind::kIcosphere ? "icosphere" : "grid";
+}
+
+/**
+ * @brief Unit icosphere subdivided \a level times: 20 * 4^level triangles.
+ */
+void AddIcosphere(int level, float cx, Mesh& mesh) {
+  const float t = (1 + std::sqrt(5.0f)) / 2;
+  std::vector<float> v = {-1, t,  0, 1,  t,  0, -1, -t, 0, 1,  -t, 0,
+                          0,  -1, t, 0,  1,  t, 0,  -1, -t, 0, 1,  -t,
+                          t,  0,  -1, t, 0,  1, -t, 0,  -1, -t, 0,  1};
+  std::vector<uint32_t> f = {0, 11, 5,  0, 5,  1, 0, 1, 7, 0, 7,  10, 0, 10,
+                             11, 1, 5,  9, 5,  11, 4, 11, 10, 2, 10, 7,  6, 7,
+                             1,  8, 3,  9, 4,  3, 4, 2, 3,  2, 6,  3,  6, 8,
+                             3,  8, 9,  4, 9,  5, 2, 4, 11, 6, 2,  10, 8, 6,
+                             7,  9, 8,  1};
+  for (int i = 0; i < level; ++i) {
+    // Midpoint of each edge, shared by both of its faces.
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    auto midpoint = [&](uint32_t a, uint32_t b) {
+      uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+      auto it = midpoints.find(key);
+      if (it != midpoints.end()) return it->second;
+      uint32_t index = v.size() / 3;
+      for (int k = 0; k < 3; ++k)
+        v.push_back((v[3 * a + k] + v[3 * b + k]) / 2);
+      midpoints[key] = index;
+      return index;
+    };
+    std::vector<uint32_t> subdivided;
+    subdivided.reserve(f.size() * 4);
+    for (size_t j = 0; j < f.size(); j += 3) {
+      uint32_t a = f[j], b = f[j + 1], c = f[j + 2];
+      uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+      subdivided.insert(subdivided.end(),
+                        {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+    }
+    f.swap(subdivided);
+  }
+
+  uint32_t base = mesh.v.size() / 3;
+  for (size_t i = 0; i < v.size(); i += 3) {
+    float norm =
+        std::sqrt(v[i] * v[i] + v[i + 1] * v[i + 1] + v[i + 2] * v[i + 2]);
+    for (int k = 0; k < 3; ++k) mesh.vn.push_back(v[i + k] / norm);
+    mesh.v.insert(mesh.v.end(),
+                  {cx + v[i] / norm, v[i + 1] / norm, v[i + 2] / norm});
+  }
+  for (uint32_t index : f) mesh.f.push_back(base + index);
+}
+
+/**
+ * @brief n by n quads of height noise: 2 * n^2 triangles. Normals are those of
+ *        the flat grid.
+ */
+void AddGrid(size_t n, float cx, Mesh& mesh) {
+  uint32_t base = mesh.v.size() / 3;
+  uint32_t seed = 12345;
+  for (size_t y = 0; y <= n; ++y) {
+    for (size_t x = 0; x <= n; ++x) {
+      seed = seed * 1664525 + 1013904223;
+      float noise = (seed >> 8) / 16777216.0f - 0.5f;
+      mesh.v.insert(mesh.v.end(), {cx + (float)x / n, (float)y / n,
+                                   noise * 0.02f});
+      mesh.vn.insert(mesh.vn.end(), {0, 0, 1});
+    }
+  }
+  for (size_t y = 0; y < n; ++y) {
+    for (size_t x = 0; x < n; ++x) {
+      uint32_t a = base + y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+      mesh.f.insert(mesh.f.end(), {a, b, d, a, d, c});
+    }
+  }
+}
+
+Mesh GenerateMesh(const MeshSpec& spec) {
+  Mesh mesh;
+  size_t per_component = spec.target_triangles / spec.num_components;
+  for (int i = 0; i < spec.num_components; ++i) {
+    // Side by side, so the components stay disconnected.
+    float cx = 2.5f * i;
+    if (spec.kind == MeshKind::kIcosphere) {
+      // The level closest to the target on a log scale.
+      int level = 0;
+      while (20 * std::pow(4.0, level + 1) <= 2 * per_component) level++;
+      AddIcosphere(level, cx, mesh);
+    } else {
+      size_t n = std::max<size_t>(std::sqrt(per_component / 2.0), 1);
+      AddGrid(n, cx, mesh);
+    }
+  }
+  if (!spec.has_normals) mesh.vn.clear();
+  return mesh;
+}
+
+void WriteObj(const Mesh& mesh, const std::string& filename) {
+  FILE* file = fopen(filename.c_str(), "w");
+  if (file == nullptr) throw std::runtime_error("Unable to write " + filename);
+  for (size_t i = 0; i < mesh.v.size(); i += 3)
+    fprintf(file, "v %.6f %.6f %.6f\n", mesh.v[i], mesh.v[i + 1],
+            mesh.v[i + 2]);
+  for (size_t i = 0; i < mesh.vn.size(); i += 3)
+    fprintf(file, "vn %.5f %.5f %.5f\n", mesh.vn[i], mesh.vn[i + 1],
+            mesh.vn[i + 2]);
+  bool has_normals = !mesh.vn.empty();
+  for (size_t i = 0; i < mesh.f.size(); i += 3) {
+    uint32_t a = mesh.f[i] + 1, b = mesh.f[i + 1] + 1, c = mesh.f[i + 2] + 1;
+    if (has_normals) {
+      fprintf(file, "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c);
+    } else {
+      fprintf(file, "f %u %u %u\n", a, b, c);
+    }
+  }
+  if (fclose(file) != 0)
+    throw std::runtime_error("Unable to write " + filename);
+}
+
+/**
+ * @brief Reset the peak resident set size, so that it can be measured per
+ *        run. Linux only; elsewhere the peak is that of the whole process.
+ */
+void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (clear_refs) clear_refs << "5";
+}
+
+double PeakRssMb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return std::stod(line.substr(6)) / 1024;  // kB
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+std::vector<int> ParseList(const std::string& list) {
+  std::vector<int> values;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) values.push_back(std::stoi(item));
+  return values;
+}
+
+struct Result {
+  MeshSpec spec;
+  size_t num_triangles;
+  int resolution, msaa, num_meshes;
+  double seconds;
+  double peak_rss_mb;
+  std::vector<librender::profiler::StageStats> stages;
+};
+
+double StageTotalMs(const Result& result, const std::string& name) {
+  for (const auto& stats : result.stages) {
+    if (stats.name == name) return stats.total_ms;
+  }
+  return 0;
+}
+
+void PrintCsvHeader() {
+  std::cout << "kind,triangles,components,has_normals,resolution,msaa,"
+               "meshes,seconds,meshes_per_s,triangles_per_s,peak_rss_mb";
+  for (std::string stage : kCsvStages) {
+    std::replace(stage.begin(), stage.end(), ' ', '_');
+    std::cout << "," << stage << "_ms";
+  }
+  std::cout << std::endl;
+}
+
+void PrintCsv(const Result& r) {
+  std::cout << std::fixed << std::setprecision(3) << KindName(r.spec.kind)
+            << "," << r.num_triangles << "," << r.spec.num_components << ","
+            << r.spec.has_normals << "," << r.resolution << "," << r.msaa
+            << "," << r.num_meshes << "," << r.seconds << ","
+            << r.num_meshes / r.seconds << ","
+            << r.num_meshes * r.num_triangles / r.seconds << ","
+            << r.peak_rss_mb;
+  for (const char* stage : kCsvStages)
+    std::cout << "," << StageTotalMs(r, stage);
+  std::cout << std::endl;
+}
+
+void PrintJson(const Result& r, bool is_first) {
+  std::cout << (is_first ? "[\n" : ",\n") << std::fixed
+            << std::setprecision(3) << "  {\"kind\": \""
+            << KindName(r.spec.kind) << "\", \"triangles\": "
+            << r.num_triangles
+            << ", \"components\": " << r.spec.num_components
+            << ", \"has_normals\": " << (r.spec.has_normals ? "true" : "false")
+            << ", \"resolution\": " << r.resolution << ", \"msaa\": " << r.msaa
+            << ", \"meshes\": " << r.num_meshes << ", \"seconds\": "
+            << r.seconds << ", \"meshes_per_s\": " << r.num_meshes / r.seconds
+            << ", \"triangles_per_s\": "
+            << r.num_meshes * r.num_triangles / r.seconds
+            << ", \"peak_rss_mb\": " << r.peak_rss_mb << ", \"stages\": {";
+  for (size_t i = 0; i < r.stages.size(); ++i) {
+    const auto& s = r.stages[i];
+    std::cout << (i ? ", " : "") << "\"" << s.name << "\": {\"count\": "
+              << s.count << ", \"total_ms\": " << s.total_ms
+              << ", \"p50_ms\": " << s.p50_ms << ", \"p95_ms\": " << s.p95_ms
+              << ", \"max_ms\": " << s.max_ms << "}";
+  }
+  std::cout << "}}" << std::flush;
+}
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description desc("Options");
+  desc.add_options()
+
+      ("help", "produce help message")
+
+      ("max-triangles", po::value<size_t>()->default_value(1000000),
+       "largest mesh in the corpus of 1k, 10k, 100k, 1M, 10M and 50M "
+       "triangles")
+
+      ("resolutions", po::value<std::string>()->default_value("256,1024"),
+       "comma-separated image sizes")
+
+      ("msaa", po::value<std::string>()->default_value("0,4"),
+       "comma-separated MSAA sample counts")
+
+      ("repeats", po::value<int>()->default_value(4),
+       "number of times each mesh is rendered per run")
+
+      ("jobs,j", po::value<int>()->default_value(0),
+       "loader and encoder threads. default: number of cores")
+
+      ("backend", po::value<std::string>()->default_value("gl"), "gl or cpu")
+
+      ("format", po::value<std::string>()->default_value("csv"), "csv or json");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  if (vm.count("help")) {
+    std::cout << desc;
+    return 1;
+  }
+  po::notify(vm);
+
+  size_t max_triangles = vm["max-triangles"].as<size_t>();
+  std::vector<int> resolutions = ParseList(vm["resolutions"].as<std::string>());
+  std::vector<int> msaa_levels = ParseList(vm["msaa"].as<std::string>());
+  int num_repeats = std::max(vm["repeats"].as<int>(), 1);
+  int num_jobs = vm["jobs"].as<int>();
+  if (num_jobs <= 0) num_jobs = std::max<int>(sysconf(_SC_NPROCESSORS_ONLN), 1);
+  bool is_json = vm["format"].as<std::string>() == "json";
+
+  librender::config::is_verbose = false;
+  librender::config::backend = vm["backend"].as<std::string>();
+  librender::profiler::is_enabled = true;
+
+  std::vector<MeshSpec> corpus;
+  for (size_t size : {1000, 10000, 100000, 1000000, 10000000, 50000000}) {
+    if (size > max_triangles) break;
+    corpus.push_back({MeshKind::kIcosphere, size, 1, false});
+    corpus.push_back({MeshKind::kIcosphere, size, 8, true});
+    corpus.push_back({MeshKind::kGrid, size, 1, true});
+    corpus.push_back({MeshKind::kGrid, size, 8, false});
+  }
+
+  fs::path dir = fs::temp_directory_path() /
+                 fs::unique_path("librender_bench_%%%%%%%%");
+  fs::create_directories(dir);
+
+  if (!is_json) PrintCsvHeader();
+  bool is_first = true;
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    const MeshSpec& spec = corpus[i];
+    std::string obj_filename = (dir / "mesh.obj").string();
+    size_t num_triangles;
+    {
+      Mesh mesh = GenerateMesh(spec);
+      num_triangles = mesh.f.size() / 3;
+      WriteObj(mesh, obj_filename);
+    }
+    std::cerr << KindName(spec.kind) << " " << num_triangles << " triangles, "
+              << spec.num_components << " components" << std::endl;
+
+    for (int resolution : resolutions) {
+      for (int msaa : msaa_levels) {
+        std::vector<librender::RenderParams> all_params(num_repeats);
+        for (int j = 0; j < num_repeats; ++j) {
+          librender::RenderParams& params = all_params[j];
+          params.in_filename = obj_filename;
+          params.out_filename =
+              (dir / ("out_" + std::to_string(j) + ".png")).string();
+          params.job_index = j;
+          params.image_width = params.image_height = resolution;
+          params.num_msaa_samples = msaa;
+          params.can_overwrite = true;
+          params.shader_params.lights.push_back(librender::LightProperties());
+        }
+
+        // The threads of the previous run are joined, so none is timing.
+        librender::profiler::Reset();
+        ResetPeakRss();
+        auto start = Clock::now();
+        librender::RunPipeline(all_params,
+                               librender::DefaultPipelineOptions(num_jobs));
+        Result result;
+        result.seconds =
+            std::chrono::duration<double>(Clock::now() - start).count();
+        result.spec = spec;
+        result.num_triangles = num_triangles;
+        result.resolution = resolution;
+        result.msaa = msaa;
+        result.num_meshes = num_repeats;
+        result.peak_rss_mb = PeakRssMb();
+        result.stages = librender::profiler::AggregateStats();
+
+        if (is_json) {
+          PrintJson(result, is_first);
+        } else {
+          PrintCsv(result);
+        }
+        is_first = false;
+      }
+    }
+  }
+  if (is_json) std::cout << (is_first ? "[" : "") << "\n]" << std::endl;
+
+  fs::remove_all(dir);
+}
@@ -10,10 +10,21 @@
 
 #include "line_shader_object.h"
 #include "debug.h"
+#include "gpu_timer.h"
 
 namespace librender {
 
-Annotation::Annotation(float grid_z, RenderParams& render_params) {
+Annotation::Annotation(float grid_z, RenderParams& render_params)
+    : Annotation(grid_z, render_params, shader::Shader(shader::kLineShader)) {}
+
+/**
+ * @brief Build the axis and grid line shapes.
+ * @param grid_z Height of the grid plane.
+ * @param render_params
+ * @param line_shader A program compiled from shader::kLineShader. Not owned.
+ */
+Annotation::Annotation(float grid_z, RenderParams& render_params,
+                       GLuint line_shader) {
   grid_data = axis_data = nullptr;
   gl_axes = gl_grid = nullptr;
 
@@ -22,7 +33,7 @@ Annotation::Annotation(float grid_z, RenderParams& render_params) {
   arma::fmat origin = {0, 0, 0};
   arma::fmat marking_range = {0, 1};
 
-  this->line_shader = shader::Shader(shader::kLineShader);
+  this->line_shader = line_shader;
 
   if (render_params.are_axes_visible) {
     this->axis_data = new Shape();
@@ -112,6 +123,8 @@ Annotation::~Annotation() {
 }
 
 void Annotation::Draw(const RenderParams& render_params) {
+  // Includes the line passes.
+  ScopedGpuTimer gpu_timer("gpu annotation");
   if (gl_axes != nullptr) {
     gl_axes->Draw(render_params, true);
   }
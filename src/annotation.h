@@ -23,6 +23,7 @@ namespace librender {
 class Annotation {
  public:
   Annotation(float grid_z, RenderParams& render_params);
+  Annotation(float grid_z, RenderParams& render_params, GLuint line_shader);
   ~Annotation();
   void Draw(const RenderParams& render_params);
 
@@ -0,0 +1,434 @@
+/**
+ * @file bvh.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include "simd.h"
+
+namespace librender {
+namespace {
+
+const size_t kMaxLeafSize = 4;
+const int kNumBins = 16;
+// Smaller subtrees are built by the thread that reaches them.
+const size_t kMinParallelSize = 1 << 12;
+// Direction components are at least this large, so that their inverses are
+// finite.
+const float kMinDirection = 1e-30f;
+// Traversal stacks of trees up to 42 levels deep are not allocated.
+const int kLocalStackSize = 127;
+
+const float kInfinity = std::numeric_limits<float>::infinity();
+
+// Axis-aligned box. The fourth lane is unused.
+struct Box {
+  Float4 lo, hi;
+
+  Box() : lo(kInfinity), hi(-kInfinity) {}
+  void Grow(Float4 p) {
+    lo = Min(lo, p);
+    hi = Max(hi, p);
+  }
+  void Grow(const Box& box) {
+    lo = Min(lo, box.lo);
+    hi = Max(hi, box.hi);
+  }
+  Float4 Center() const { return (lo + hi) * Float4(0.5f); }
+  // Half of the surface area. 0 if empty.
+  float HalfArea() const {
+    float d[4];
+    Max(hi - lo, Float4(0)).Store(d);
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+  }
+};
+
+struct BuildInput {
+  std::vector<Box> boxes;
+  // Triangles, partitioned so that each node has a range.
+  std::vector<int> ids;
+  int max_parallel_depth;
+};
+
+// Three coordinates of four lanes.
+struct Float4x3 {
+  Float4 x, y, z;
+};
+
+inline Float4x3 Load(const float (*p)[4]) {
+  return {Float4::Load(p[0]), Float4::Load(p[1]), Float4::Load(p[2])};
+}
+inline Float4x3 operator-(const Float4x3& a, const Float4x3& b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+inline Float4 Dot(const Float4x3& a, const Float4x3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline Float4x3 Cross(const Float4x3& a, const Float4x3& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+inline float Dot3(const float* a, const float* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+inline void Cross3(const float* a, const float* b, float* c) {
+  c[0] = a[1] * b[2] - a[2] * b[1];
+  c[1] = a[2] * b[0] - a[0] * b[2];
+  c[2] = a[0] * b[1] - a[1] * b[0];
+}
+}
+
+struct Bvh::BuildNode {
+  Box box;
+  std::unique_ptr<BuildNode> children[2];
+  // Triangles under the node, in BuildInput::ids.
+  size_t begin = 0, end = 0;
+
+  bool IsLeaf() const { return !children[0]; }
+  void Build(BuildInput& input, size_t begin, size_t end, int depth);
+};
+
+/**
+ * @brief Split the triangles in [\a begin, \a end) of \a input.ids where the
+ *        binned surface area heuristic is lowest, and recurse. The two
+ *        halves are built in parallel near the root.
+ */
+void Bvh::BuildNode::Build(BuildInput& input, size_t begin, size_t end,
+                           int depth) {
+  this->begin = begin;
+  this->end = end;
+  Box centroid_box;
+  for (size_t i = begin; i < end; ++i) {
+    const Box& triangle = input.boxes[input.ids[i]];
+    box.Grow(triangle);
+    centroid_box.Grow(triangle.Center());
+  }
+  // A leaf is tested in one go, so it is never worth splitting.
+  size_t count = end - begin;
+  if (count <= kMaxLeafSize) return;
+
+  // Bins of the centers along each axis, filled in one pass.
+  float extents[4], scales[4] = {0, 0, 0, 0};
+  (centroid_box.hi - centroid_box.lo).Store(extents);
+  for (int axis = 0; axis < 3; ++axis) {
+    if (extents[axis] > 0) scales[axis] = kNumBins / extents[axis];
+  }
+  const Float4 scale = Float4::Load(scales);
+  auto bins_of = [&](const Box& triangle, int* bins) {
+    float offsets[4];
+    ((triangle.Center() - centroid_box.lo) * scale).Store(offsets);
+    for (int axis = 0; axis < 3; ++axis)
+      bins[axis] = std::min((int)offsets[axis], kNumBins - 1);
+  };
+  Box bins[3][kNumBins];
+  size_t counts[3][kNumBins] = {};
+  for (size_t i = begin; i < end; ++i) {
+    const Box& triangle = input.boxes[input.ids[i]];
+    int bin[3];
+    bins_of(triangle, bin);
+    for (int axis = 0; axis < 3; ++axis) {
+      ++counts[axis][bin[axis]];
+      bins[axis][bin[axis]].Grow(triangle);
+    }
+  }
+
+  float best_cost = kInfinity;
+  int best_axis = -1, best_bin = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (!(extents[axis] > 0)) continue;
+    // Split b puts bins [0, b) on the left.
+    float right_areas[kNumBins];
+    size_t right_counts[kNumBins];
+    Box right;
+    size_t right_count = 0;
+    for (int b = kNumBins - 1; b > 0; --b) {
+      right.Grow(bins[axis][b]);
+      right_count += counts[axis][b];
+      right_areas[b] = right.HalfArea();
+      right_counts[b] = right_count;
+    }
+    Box left;
+    size_t left_count = 0;
+    for (int b = 1; b < kNumBins; ++b) {
+      left.Grow(bins[axis][b - 1]);
+      left_count += counts[axis][b - 1];
+      if (left_count == 0 || right_counts[b] == 0) continue;
+      float cost =
+          left.HalfArea() * left_count + right_areas[b] * right_counts[b];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = b;
+      }
+    }
+  }
+
+  auto first = input.ids.begin();
+  size_t mid = begin + count / 2;
+  if (best_axis >= 0) {
+    mid = std::partition(first + begin, first + end, [&](int id) {
+            int bin[3];
+            bins_of(input.boxes[id], bin);
+            return bin[best_axis] < best_bin;
+          }) - first;
+  }
+
+  for (auto& child : children) child.reset(new BuildNode);
+  if (depth < input.max_parallel_depth && count >= kMinParallelSize) {
+    std::thread left(&BuildNode::Build, children[0].get(), std::ref(input),
+                     begin, mid, depth + 1);
+    children[1]->Build(input, mid, end, depth + 1);
+    left.join();
+  } else {
+    children[0]->Build(input, begin, mid, depth + 1);
+    children[1]->Build(input, mid, end, depth + 1);
+  }
+}
+
+/**
+ * @param triangles 9 floats per triangle: x, y, z of its three corners.
+ * @param max_threads 0 for the number of cores.
+ */
+void Bvh::Build(const float* triangles, size_t num_triangles,
+                int max_threads) {
+  nodes_.clear();
+  leaves_.clear();
+  num_triangles_ = num_triangles;
+  depth_ = 0;
+  if (num_triangles == 0) return;
+
+  BuildInput input;
+  input.boxes.resize(num_triangles);
+  input.ids.resize(num_triangles);
+  std::iota(input.ids.begin(), input.ids.end(), 0);
+  for (size_t i = 0; i < num_triangles; ++i) {
+    for (const float* v = triangles + 9 * i; v < triangles + 9 * i + 9;
+         v += 3)
+      input.boxes[i].Grow(Float4(v[0], v[1], v[2], 0));
+  }
+  // About one thread per core, or per thread allowed.
+  unsigned num_threads =
+      (max_threads > 0) ? max_threads
+                        : std::max(1u, std::thread::hardware_concurrency());
+  input.max_parallel_depth = 0;
+  while ((1u << input.max_parallel_depth) < num_threads)
+    ++input.max_parallel_depth;
+
+  BuildNode root;
+  root.Build(input, 0, num_triangles, 0);
+  if (root.IsLeaf()) {
+    // The root is always a Node.
+    BuildNode parent;
+    parent.box = root.box;
+    parent.children[0].reset(new BuildNode(std::move(root)));
+    Collapse(parent, input.ids, triangles, 1);
+  } else {
+    Collapse(root, input.ids, triangles, 1);
+  }
+}
+
+/**
+ * @brief Append \a node and its subtree, with the binary levels merged into
+ *        nodes of up to four children.
+ * @return Index of the Node, or ~index of the Leaf.
+ */
+int Bvh::Collapse(const BuildNode& node, const std::vector<int>& ids,
+                  const float* triangles, int depth) {
+  if (node.IsLeaf()) {
+    int index = leaves_.size();
+    leaves_.emplace_back();
+    Leaf& leaf = leaves_.back();
+    std::fill_n(leaf.triangles, 4, -1);
+    for (size_t i = node.begin; i < node.end; ++i) {
+      int lane = i - node.begin, id = ids[i];
+      const float* v = triangles + 9 * id;
+      for (int k = 0; k < 3; ++k) {
+        leaf.v0[k][lane] = v[k];
+        leaf.e1[k][lane] = v[3 + k] - v[k];
+        leaf.e2[k][lane] = v[6 + k] - v[k];
+      }
+      leaf.triangles[lane] = id;
+    }
+    return ~index;
+  }
+
+  // Replace the largest inner child by its children while there is room.
+  std::vector<const BuildNode*> children;
+  for (const auto& child : node.children) {
+    if (child) children.push_back(child.get());
+  }
+  while (children.size() < 4) {
+    int largest = -1;
+    for (size_t i = 0; i < children.size(); ++i) {
+      if (!children[i]->IsLeaf() &&
+          (largest < 0 ||
+           children[i]->box.HalfArea() > children[largest]->box.HalfArea()))
+        largest = i;
+    }
+    if (largest < 0) break;
+    const BuildNode* inner = children[largest];
+    children[largest] = inner->children[0].get();
+    children.push_back(inner->children[1].get());
+  }
+
+  int index = nodes_.size();
+  nodes_.emplace_back();
+  depth_ = std::max(depth_, depth);
+  for (size_t lane = 0; lane < children.size(); ++lane) {
+    int child = Collapse(*children[lane], ids, triangles, depth + 1);
+    // The vector may have grown.
+    Node& out = nodes_[index];
+    float lo[4], hi[4];
+    children[lane]->box.lo.Store(lo);
+    children[lane]->box.hi.Store(hi);
+    for (int k = 0; k < 3; ++k) {
+      out.lo[k][lane] = lo[k];
+      out.hi[k][lane] = hi[k];
+    }
+    out.children[lane] = child;
+  }
+  return index;
+}
+
+/**
+ * @brief Call \a on_hit(triangle, t) for each triangle that the ray crosses
+ *        at \a t_min < t < \a t_max. \a t_max may shrink meanwhile.
+ */
+template <typename Fn>
+void Bvh::Traverse(const float* origin, const float* direction, float t_min,
+                   const float& t_max, Fn on_hit) const {
+  if (nodes_.empty()) return;
+  Float4x3 o = {origin[0], origin[1], origin[2]};
+  Float4x3 d = {direction[0], direction[1], direction[2]};
+  float inverse[3];
+  for (int k = 0; k < 3; ++k) {
+    float dk = direction[k];
+    if (std::abs(dk) < kMinDirection) dk = (dk < 0) ? -kMinDirection
+                                                    : kMinDirection;
+    inverse[k] = 1 / dk;
+  }
+  Float4x3 inv = {inverse[0], inverse[1], inverse[2]};
+
+  // Each level leaves at most three siblings behind.
+  int local_stack[kLocalStackSize];
+  std::vector<int> heap_stack;
+  int* stack = local_stack;
+  if (3 * depth_ + 1 > kLocalStackSize) {
+    heap_stack.resize(3 * depth_ + 1);
+    stack = heap_stack.data();
+  }
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    const Node& node = nodes_[stack[--stack_size]];
+
+    // Slab test of the four boxes.
+    Float4x3 t0 = (Load(node.lo) - o), t1 = (Load(node.hi) - o);
+    t0 = {t0.x * inv.x, t0.y * inv.y, t0.z * inv.z};
+    t1 = {t1.x * inv.x, t1.y * inv.y, t1.z * inv.z};
+    Float4 near = Max(Max(Min(t0.x, t1.x), Min(t0.y, t1.y)),
+                      Max(Min(t0.z, t1.z), Float4(t_min)));
+    Float4 far = Min(Min(Max(t0.x, t1.x), Max(t0.y, t1.y)),
+                     Min(Max(t0.z, t1.z), Float4(t_max)));
+    int bits = (near <= far).Bits();
+
+    for (int lane = 0; lane < 4; ++lane) {
+      int child = node.children[lane];
+      if (!(bits >> lane & 1) || child == 0) continue;
+      if (child > 0) {
+        stack[stack_size++] = child;
+        continue;
+      }
+
+      // Moeller-Trumbore on the four triangles of the leaf.
+      const Leaf& leaf = leaves_[~child];
+      Float4x3 e1 = Load(leaf.e1), e2 = Load(leaf.e2);
+      Float4x3 p = Cross(d, e2);
+      Float4 inverse_det = Float4(1) / Dot(e1, p);
+      Float4x3 s = o - Load(leaf.v0);
+      Float4 u = Dot(s, p) * inverse_det;
+      Float4x3 q = Cross(s, e1);
+      Float4 v = Dot(d, q) * inverse_det;
+      Float4 t = Dot(e2, q) * inverse_det;
+      // A zero determinant gives infinities or NaN, which fail.
+      int hits = ((u > 0) & (v > 0) & (u + v < 1) & (t > Float4(t_min)) &
+                  (t < Float4(t_max))).Bits();
+      if (!hits) continue;
+      float ts[4];
+      t.Store(ts);
+      for (int i = 0; i < 4; ++i) {
+        if ((hits >> i & 1) && leaf.triangles[i] >= 0)
+          on_hit(leaf.triangles[i], ts[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief All triangles that the ray crosses at \a t_min < t < \a t_max, in
+ *        no particular order. The edges of triangles are not crossed.
+ */
+void Bvh::Intersect(const float* origin, const float* direction, float t_min,
+                    float t_max, std::vector<Hit>& hits) const {
+  hits.clear();
+  Traverse(origin, direction, t_min, t_max,
+           [&](int triangle, float t) { hits.push_back({triangle, t}); });
+}
+
+/**
+ * @brief The first triangle that the ray crosses after \a t_min and before
+ *        \a t_max.
+ * @return false if there is none.
+ */
+bool Bvh::IntersectClosest(const float* origin, const float* direction,
+                           float t_min, float t_max, Hit& hit) const {
+  hit.triangle = -1;
+  Traverse(origin, direction, t_min, t_max, [&](int triangle, float t) {
+    if (t < t_max) {
+      t_max = t;
+      hit = {triangle, t};
+    }
+  });
+  return hit.triangle >= 0;
+}
+
+/**
+ * @brief Same as Intersect(), by testing every triangle. Cheaper than
+ *        building the tree for a few rays.
+ * @param triangles As in Build().
+ */
+void Bvh::IntersectEach(const float* triangles, size_t num_triangles,
+                        const float* origin, const float* direction,
+                        float t_min, float t_max, std::vector<Hit>& hits) {
+  hits.clear();
+  for (size_t i = 0; i < num_triangles; ++i) {
+    const float* v = triangles + 9 * i;
+    float e1[3], e2[3], s[3], p[3], q[3];
+    for (int k = 0; k < 3; ++k) {
+      e1[k] = v[3 + k] - v[k];
+      e2[k] = v[6 + k] - v[k];
+      s[k] = origin[k] - v[k];
+    }
+    Cross3(direction, e2, p);
+    float inverse_det = 1 / Dot3(e1, p);
+    float u = Dot3(s, p) * inverse_det;
+    Cross3(s, e1, q);
+    float w = Dot3(direction, q) * inverse_det;
+    float t = Dot3(e2, q) * inverse_det;
+    if (u > 0 && w > 0 && u + w < 1 && t > t_min && t < t_max)
+      hits.push_back({(int)i, t});
+  }
+}
+}
@@ -0,0 +1,82 @@
+/**
+ * @file bvh.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+namespace librender {
+
+/**
+ * @brief Bounding volume hierarchy over triangles, for casting rays.
+ *
+ * The tree is built with the binned surface area heuristic, with subtrees
+ * built in parallel, and then collapsed to four children per node. Rays are
+ * tested against the four boxes of a node, and against the up to four
+ * triangles of a leaf, at once with SSE.
+ */
+class Bvh {
+ public:
+  struct Hit {
+    int triangle;
+    // Distance from the origin in units of the direction.
+    float t;
+  };
+
+  /**
+   * @param triangles 9 floats per triangle: x, y, z of its three corners.
+   * @param max_threads 0 for the number of cores.
+   */
+  void Build(const float* triangles, size_t num_triangles,
+             int max_threads = 0);
+
+  void Intersect(const float* origin, const float* direction, float t_min,
+                 float t_max, std::vector<Hit>& hits) const;
+  bool IntersectClosest(const float* origin, const float* direction,
+                        float t_min, float t_max, Hit& hit) const;
+
+  size_t NumTriangles() const { return num_triangles_; }
+
+  static void IntersectEach(const float* triangles, size_t num_triangles,
+                            const float* origin, const float* direction,
+                            float t_min, float t_max, std::vector<Hit>& hits);
+
+ private:
+  // Four children, in lanes. Empty lanes have child 0, the root.
+  struct Node {
+    float lo[3][4];
+    float hi[3][4];
+    // Index of a Node if >= 0, ~index of a Leaf if < 0.
+    int children[4];
+  };
+
+  // Up to four triangles, in lanes. Unused lanes are zero and never hit.
+  struct Leaf {
+    float v0[3][4];
+    float e1[3][4];
+    float e2[3][4];
+    int triangles[4];
+  };
+
+  // Binary node while building.
+  struct BuildNode;
+
+  int Collapse(const BuildNode& node, const std::vector<int>& ids,
+               const float* triangles, int depth);
+  template <typename Fn>
+  void Traverse(const float* origin, const float* direction, float t_min,
+                const float& t_max, Fn on_hit) const;
+
+  std::vector<Node> nodes_;
+  std::vector<Leaf> leaves_;
+  size_t num_triangles_ = 0;
+  // Levels of Nodes.
+  int depth_ = 0;
+};
+}
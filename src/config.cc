@@ -18,5 +18,12 @@ namespace config {
 float window_control_speed = 1;
 std::string window_title = "librender";
 bool is_verbose = true;
+int num_jobs = 0;
+std::string npy_filename = "";
+std::string backend = "gl";
+std::string trace_filename = "";
+std::string mesh_cache_dir = "";
+int64_t mesh_cache_max_mb = 4096;
+bool is_vertex_quantized = false;
 }
 }
@@ -8,6 +8,7 @@
  */
 #pragma once
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <armadillo>
@@ -24,5 +25,18 @@ namespace config {
 extern float window_control_speed;
 extern std::string window_title;
 extern bool is_verbose;
+// Worker threads per pipeline stage. 0 for the number of cores.
+extern int num_jobs;
+// If set, every image is written into this .npy file instead of a PNG file.
+extern std::string npy_filename;
+// "gl", or "cpu" to render off-screen images without a GPU.
+extern std::string backend;
+// If set, stage timings are written here as a Chrome trace.
+extern std::string trace_filename;
+// If set, loaded meshes are cached here. See MeshCache.
+extern std::string mesh_cache_dir;
+extern int64_t mesh_cache_max_mb;
+// Upload meshes as VertexFormat::kQuantized instead of kInterleaved.
+extern bool is_vertex_quantized;
 }
 }
@@ -0,0 +1,508 @@
+/**
+ * @file cpu_rasterizer.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "cpu_rasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/type_ptr.hpp>
+#include "simd.h"
+
+namespace librender {
+namespace {
+
+// Sample offsets from the pixel center, in the standard GL/D3D patterns.
+const float kSamples1[] = {0, 0};
+const float kSamples2[] = {0.25, 0.25, -0.25, -0.25};
+const float kSamples4[] = {-0.125, -0.375, 0.375, -0.125,
+                           -0.375, 0.125,  0.125, 0.375};
+const float kSamples8[] = {0.0625,  -0.1875, -0.0625, 0.1875,  0.3125, 0.0625,
+                           -0.1875, -0.3125, -0.3125, 0.3125,  -0.4375,
+                           -0.0625, 0.1875,  0.4375,  0.4375,  -0.4375};
+
+const glm::vec3 kCorners[] = {glm::vec3(1, 0, 0), glm::vec3(0, 1, 0),
+                              glm::vec3(0, 0, 1)};
+
+inline uint8_t ToUnorm8(float x) {
+  return (uint8_t)(std::min(std::max(x, 0.0f), 1.0f) * 255 + 0.5f);
+}
+}
+
+const int CpuRasterizer::kTileSize;
+const int CpuRasterizer::kMaxSamples;
+
+/**
+ * @param num_threads 0 for the number of cores. The calling thread is one of
+ *        them.
+ */
+CpuRasterizer::CpuRasterizer(int num_threads) {
+  num_threads_ = (num_threads > 0) ? num_threads
+                                   : (int)std::thread::hardware_concurrency();
+  num_threads_ = std::max(num_threads_, 1);
+  triangles_.resize(num_threads_);
+  bins_.resize(num_threads_);
+  tile_buffers_.resize(num_threads_);
+  for (int i = 1; i < num_threads_; ++i)
+    workers_.emplace_back(&CpuRasterizer::WorkerLoop, this, i);
+}
+
+CpuRasterizer::~CpuRasterizer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  start_cv_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+/**
+ * @brief Draw \a shape as seen from the camera in \a params.shader_params.
+ *        Call ComputeMatrices() first.
+ * @param shape Triangles.
+ * @param params Image size, number of MSAA samples, background and shading.
+ * @param[out] pixels image_width * image_height RGBA values, starting from the
+ *             bottom row in window coordinates as with glReadPixels.
+ */
+void CpuRasterizer::Draw(const Shape& shape, const RenderParams& params,
+                         uint8_t* pixels) {
+  if (shape.type != ShapeType::kTriangles)
+    throw std::runtime_error("The cpu backend only draws triangles.");
+
+  shape_ = &shape;
+  params_ = &params;
+  width_ = params.image_width;
+  height_ = params.image_height;
+  num_tiles_x_ = (width_ + kTileSize - 1) / kTileSize;
+  num_tiles_y_ = (height_ + kTileSize - 1) / kTileSize;
+  int num_tiles = num_tiles_x_ * num_tiles_y_;
+
+  // Patterns exist for 1, 2, 4 and 8 samples. Others get the next lower one.
+  num_samples_ = params.num_msaa_samples;
+  if (num_samples_ >= 8) {
+    num_samples_ = 8;
+    sample_offsets_ = kSamples8;
+  } else if (num_samples_ >= 4) {
+    num_samples_ = 4;
+    sample_offsets_ = kSamples4;
+  } else if (num_samples_ >= 2) {
+    num_samples_ = 2;
+    sample_offsets_ = kSamples2;
+  } else {
+    num_samples_ = 1;
+    sample_offsets_ = kSamples1;
+  }
+
+  for (int i = 0; i < 4; ++i) background_[i] = ToUnorm8(params.background[i]);
+
+  const ShaderParams& shader_params = params.shader_params;
+  glm::mat4 mvp = shader_params.projection_mat * shader_params.view_mat *
+                  shader_params.model_mat;
+  size_t num_vertices = shape.v.n_cols;
+  size_t num_faces = shape.ind.n_cols;
+  clip_positions_.resize(num_vertices);
+
+  RunOnAllThreads([&](int thread) {
+    const float* v = shape.v.memptr();
+    size_t end = num_vertices * (thread + 1) / num_threads_;
+    for (size_t i = num_vertices * thread / num_threads_; i < end; ++i) {
+      clip_positions_[i] =
+          mvp * glm::vec4(v[3 * i], v[3 * i + 1], v[3 * i + 2], 1);
+    }
+  });
+
+  RunOnAllThreads([&](int thread) {
+    triangles_[thread].clear();
+    bins_[thread].resize(num_tiles);
+    for (std::vector<uint32_t>& bin : bins_[thread]) bin.clear();
+    SetupTriangles(thread, num_faces * thread / num_threads_,
+                   num_faces * (thread + 1) / num_threads_);
+  });
+
+  std::atomic<int> next_tile(0);
+  RunOnAllThreads([&](int thread) {
+    size_t buffer_size = (size_t)num_samples_ * kTileSize * kTileSize;
+    tile_buffers_[thread].depth.resize(buffer_size);
+    tile_buffers_[thread].triangles.resize(buffer_size);
+    int tile;
+    while ((tile = next_tile++) < num_tiles)
+      RasterizeTile(thread, tile, pixels);
+  });
+
+  shape_ = nullptr;
+  params_ = nullptr;
+}
+
+/**
+ * @brief Clip faces [begin, end) against the near plane and bin the visible
+ *        triangles into tiles.
+ */
+void CpuRasterizer::SetupTriangles(int thread, size_t begin, size_t end) {
+  const uint32_t* indices = shape_->ind.memptr();
+  const float* v = shape_->v.memptr();
+  bool has_edges = params_->shader_params.edge_thickness >= 1e-7;
+
+  for (size_t f = begin; f < end; ++f) {
+    const uint32_t* face = indices + 3 * f;
+    glm::vec4 clip[3];
+    float dist[3];
+    for (int k = 0; k < 3; ++k) {
+      clip[k] = clip_positions_[face[k]];
+      dist[k] = clip[k].z + clip[k].w;
+    }
+    if (dist[0] < 0 && dist[1] < 0 && dist[2] < 0) continue;
+
+    // Same as the geometry shader.
+    glm::vec3 heights(0);
+    if (has_edges) {
+      glm::vec3 pos[3];
+      for (int k = 0; k < 3; ++k) pos[k] = glm::make_vec3(v + 3 * face[k]);
+      for (int k = 0; k < 3; ++k) {
+        glm::vec3 a_p = pos[(k + 1) % 3] - pos[k];
+        glm::vec3 n = glm::normalize(pos[(k + 2) % 3] - pos[(k + 1) % 3]);
+        heights[k] = glm::length(a_p - glm::dot(a_p, n) * n);
+      }
+    }
+
+    if (dist[0] >= 0 && dist[1] >= 0 && dist[2] >= 0) {
+      AddTriangle(thread, f, clip, kCorners, heights);
+      continue;
+    }
+
+    // One or two vertices are behind the near plane. What remains is a
+    // triangle or a quad.
+    glm::vec4 poly[4];
+    glm::vec3 coords[4];
+    int n = 0;
+    for (int k = 0; k < 3; ++k) {
+      int next = (k + 1) % 3;
+      if (dist[k] >= 0) {
+        poly[n] = clip[k];
+        coords[n++] = kCorners[k];
+      }
+      if ((dist[k] >= 0) != (dist[next] >= 0)) {
+        float t = dist[k] / (dist[k] - dist[next]);
+        poly[n] = glm::mix(clip[k], clip[next], t);
+        coords[n++] = glm::mix(kCorners[k], kCorners[next], t);
+      }
+    }
+    for (int k = 1; k + 1 < n; ++k) {
+      glm::vec4 tri_clip[] = {poly[0], poly[k], poly[k + 1]};
+      glm::vec3 tri_coords[] = {coords[0], coords[k], coords[k + 1]};
+      AddTriangle(thread, f, tri_clip, tri_coords, heights);
+    }
+  }
+}
+
+/**
+ * @brief Project a triangle in front of the near plane to the screen and add
+ *        it to the bins of the tiles it overlaps.
+ */
+void CpuRasterizer::AddTriangle(int thread, size_t face, const glm::vec4* clip,
+                                const glm::vec3* face_coords,
+                                const glm::vec3& heights) {
+  Triangle tri;
+  float x[3], y[3];
+  bool is_behind_far = true;
+  for (int k = 0; k < 3; ++k) {
+    float inv_w = 1 / clip[k].w;
+    x[k] = (clip[k].x * inv_w * 0.5f + 0.5f) * width_;
+    y[k] = (clip[k].y * inv_w * 0.5f + 0.5f) * height_;
+    tri.z[k] = clip[k].z * inv_w * 0.5f + 0.5f;
+    tri.inv_w[k] = inv_w;
+    tri.face_coords[k] = face_coords[k];
+    is_behind_far &= tri.z[k] > 1;
+  }
+  if (is_behind_far) return;
+
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (!(std::abs(area) > 1e-12f)) return;
+
+  float min_x = std::min(std::min(x[0], x[1]), x[2]);
+  float max_x = std::max(std::max(x[0], x[1]), x[2]);
+  float min_y = std::min(std::min(y[0], y[1]), y[2]);
+  float max_y = std::max(std::max(y[0], y[1]), y[2]);
+  // Samples of pixel i lie within [i, i + 1].
+  tri.x_min = (int)std::max(std::ceil(min_x - 1), 0.0f);
+  tri.y_min = (int)std::max(std::ceil(min_y - 1), 0.0f);
+  tri.x_max = (int)std::min(std::floor(max_x), width_ - 1.0f);
+  tri.y_max = (int)std::min(std::floor(max_y), height_ - 1.0f);
+  if (tri.x_min > tri.x_max || tri.y_min > tri.y_max) return;
+
+  // The edge opposite vertex k runs from vertex i to j.
+  for (int k = 0; k < 3; ++k) {
+    int i = (k + 1) % 3, j = (k + 2) % 3;
+    tri.a[k] = (y[i] - y[j]) / area;
+    tri.b[k] = (x[j] - x[i]) / area;
+    // Of two triangles sharing an edge, exactly one owns it.
+    tri.is_top_left[k] = tri.a[k] > 0 || (tri.a[k] == 0 && tri.b[k] > 0);
+  }
+  tri.x0 = x[0];
+  tri.y0 = y[0];
+  tri.heights = heights;
+  tri.face = face;
+
+  uint32_t index = triangles_[thread].size();
+  triangles_[thread].push_back(tri);
+  for (int ty = tri.y_min / kTileSize; ty <= tri.y_max / kTileSize; ++ty)
+    for (int tx = tri.x_min / kTileSize; tx <= tri.x_max / kTileSize; ++tx)
+      bins_[thread][ty * num_tiles_x_ + tx].push_back(index);
+}
+
+/**
+ * @brief Depth test every sample of the tile against its triangles, then
+ *        shade and resolve each pixel into \a pixels.
+ */
+void CpuRasterizer::RasterizeTile(int thread, int tile, uint8_t* pixels) {
+  const int kTilePixels = kTileSize * kTileSize;
+  TileBuffer& buffer = tile_buffers_[thread];
+  int tile_x = (tile % num_tiles_x_) * kTileSize;
+  int tile_y = (tile / num_tiles_x_) * kTileSize;
+  int tile_w = std::min(kTileSize, width_ - tile_x);
+  int tile_h = std::min(kTileSize, height_ - tile_y);
+  // Loaded once, since stores to pixels may alias any member.
+  const int num_samples = num_samples_;
+  const float* sample_offsets = sample_offsets_;
+  uint32_t background;
+  std::memcpy(&background, background_, 4);
+
+  bool is_empty = true;
+  for (int t = 0; t < num_threads_; ++t) is_empty &= bins_[t][tile].empty();
+  if (is_empty) {
+    for (int y = tile_y; y < tile_y + tile_h; ++y) {
+      uint8_t* out = pixels + ((size_t)y * width_ + tile_x) * 4;
+      for (int x = 0; x < tile_w; ++x) std::memcpy(out + 4 * x, &background, 4);
+    }
+    return;
+  }
+
+  size_t buffer_size = (size_t)num_samples * kTilePixels;
+  std::fill_n(buffer.depth.begin(), buffer_size, 1.0f);
+  std::fill_n(buffer.triangles.begin(), buffer_size, nullptr);
+
+  const Float4 kZero(0), kLanes(0, 1, 2, 3);
+  for (int t = 0; t < num_threads_; ++t) {
+    for (uint32_t index : bins_[t][tile]) {
+      const Triangle& tri = triangles_[t][index];
+      Float4 a0(tri.a[0]), a1(tri.a[1]), a2(tri.a[2]);
+      Float4 z0(tri.z[0]), z1(tri.z[1]), z2(tri.z[2]);
+      // Whether samples exactly on an edge pass.
+      bool tl0 = tri.is_top_left[0], tl1 = tri.is_top_left[1],
+           tl2 = tri.is_top_left[2];
+
+      int x_begin = std::max(tri.x_min, tile_x) & ~3;
+      int x_end = std::min(tri.x_max + 1, tile_x + tile_w);
+      int y_begin = std::max(tri.y_min, tile_y);
+      int y_end = std::min(tri.y_max + 1, tile_y + tile_h);
+      Float4 x_limit((float)x_end);
+
+      for (int y = y_begin; y < y_end; ++y) {
+        size_t row = (size_t)(y - tile_y) * kTileSize;
+        for (int x = x_begin; x < x_end; x += 4) {
+          Float4 lane_x = Float4((float)x) + kLanes;
+          Float4 is_in_range = lane_x < x_limit;
+          size_t offset = row + (x - tile_x);
+
+          for (int s = 0; s < num_samples; ++s) {
+            Float4 dx = lane_x + Float4(0.5f + sample_offsets[2 * s] - tri.x0);
+            float dy = y + 0.5f + sample_offsets[2 * s + 1] - tri.y0;
+            Float4 e0 = a0 * dx + Float4(tri.b[0] * dy + 1);
+            Float4 e1 = a1 * dx + Float4(tri.b[1] * dy);
+            Float4 e2 = a2 * dx + Float4(tri.b[2] * dy);
+            Float4 inside = is_in_range & (tl0 ? e0 >= kZero : e0 > kZero) &
+                            (tl1 ? e1 >= kZero : e1 > kZero) &
+                            (tl2 ? e2 >= kZero : e2 > kZero);
+            if (inside.Bits() == 0) continue;
+
+            float* depth = &buffer.depth[s * kTilePixels + offset];
+            Float4 old_z = Float4::Load(depth);
+            Float4 z = e0 * z0 + e1 * z1 + e2 * z2;
+            Float4 pass = inside & (z < old_z);
+            int bits = pass.Bits();
+            if (bits == 0) continue;
+
+            Select(pass, z, old_z).Store(depth);
+            const Triangle** ids = &buffer.triangles[s * kTilePixels + offset];
+            for (int lane = 0; lane < 4; ++lane)
+              if (bits & (1 << lane)) ids[lane] = &tri;
+          }
+        }
+      }
+    }
+  }
+
+  // Resolve. Each triangle is shaded once per pixel, at the pixel center.
+  const Triangle* const* ids = buffer.triangles.data();
+  const Triangle* shaded[kMaxSamples];
+  uint8_t colors[kMaxSamples][4];
+  for (int y = 0; y < tile_h; ++y) {
+    uint8_t* row = pixels + ((size_t)(tile_y + y) * width_ + tile_x) * 4;
+    for (int x = 0; x < tile_w; ++x) {
+      int p = y * kTileSize + x;
+      float center_x = tile_x + x + 0.5f, center_y = tile_y + y + 0.5f;
+      uint8_t* out = row + 4 * x;
+
+      // Most pixels are covered by one triangle or none.
+      int s = 1;
+      while (s < num_samples && ids[s * kTilePixels + p] == ids[p]) ++s;
+      if (s == num_samples) {
+        if (ids[p] == nullptr) {
+          std::memcpy(out, &background, 4);
+        } else {
+          glm::vec4 c = Shade(*ids[p], center_x, center_y);
+          for (int ch = 0; ch < 4; ++ch) out[ch] = ToUnorm8(c[ch]);
+        }
+        continue;
+      }
+
+      int num_shaded = 0;
+      unsigned int sum[4] = {0, 0, 0, 0};
+      for (s = 0; s < num_samples; ++s) {
+        const Triangle* tri = ids[s * kTilePixels + p];
+        const uint8_t* color = background_;
+        if (tri != nullptr) {
+          int i = 0;
+          while (i < num_shaded && shaded[i] != tri) ++i;
+          if (i == num_shaded) {
+            glm::vec4 c = Shade(*tri, center_x, center_y);
+            for (int ch = 0; ch < 4; ++ch) colors[i][ch] = ToUnorm8(c[ch]);
+            shaded[num_shaded++] = tri;
+          }
+          color = colors[i];
+        }
+        for (int ch = 0; ch < 4; ++ch) sum[ch] += color[ch];
+      }
+      for (int ch = 0; ch < 4; ++ch)
+        out[ch] = (sum[ch] + num_samples / 2) / num_samples;
+    }
+  }
+}
+
+/**
+ * @brief The fragment shader of trimesh_shape.glsl. Attributes are
+ *        interpolated perspective-correctly, even if (x, y) is outside of the
+ *        triangle.
+ * @param tri
+ * @param x,y Window coordinates.
+ * @return Color before clamping.
+ */
+glm::vec4 CpuRasterizer::Shade(const Triangle& tri, float x, float y) const {
+  float dx = x - tri.x0, dy = y - tri.y0;
+  float w0 = (tri.a[0] * dx + tri.b[0] * dy + 1) * tri.inv_w[0];
+  float w1 = (tri.a[1] * dx + tri.b[1] * dy) * tri.inv_w[1];
+  float w2 = (tri.a[2] * dx + tri.b[2] * dy) * tri.inv_w[2];
+  glm::vec3 coords = (w0 * tri.face_coords[0] + w1 * tri.face_coords[1] +
+                      w2 * tri.face_coords[2]) /
+                     (w0 + w1 + w2);
+
+  const Shape& shape = *shape_;
+  const uint32_t* face = shape.ind.colptr(tri.face);
+  glm::vec3 position(0), normal(0);
+  // Defaults of unset vertex attributes in GL.
+  glm::vec4 color(0, 0, 0, 1);
+  if (!shape.vc.empty()) color = glm::vec4(0);
+  for (int k = 0; k < 3; ++k) {
+    position += coords[k] * glm::make_vec3(shape.v.colptr(face[k]));
+    if (!shape.vn.empty())
+      normal += coords[k] * glm::make_vec3(shape.vn.colptr(face[k]));
+    if (shape.vc.n_rows == 4) {
+      color += coords[k] * glm::make_vec4(shape.vc.colptr(face[k]));
+    } else if (shape.vc.n_rows == 3) {
+      color += coords[k] *
+               glm::vec4(glm::make_vec3(shape.vc.colptr(face[k])), 1);
+    }
+  }
+
+  const ShaderParams& params = params_->shader_params;
+  glm::vec3 rgb(color);
+  glm::vec4 col(params.ambient, color[3]);
+  size_t num_lights = std::min<size_t>(params.lights.size(), 20);
+  for (size_t i = 0; i < num_lights; ++i) {
+    const LightProperties& light = params.lights[i];
+    if (!light.is_enabled) continue;
+
+    glm::vec3 light_dir = light.light_position - position;
+    float light_dist = glm::length(light_dir);
+    light_dir = light_dir / light_dist;
+
+    // The interpolated normal is not normalized, as in the shader.
+    float lambertian = std::max(glm::dot(light_dir, normal), 0.0f);
+    float specular = 0;
+    float attenuation =
+        1 / (light.constant_attenuation +
+             light.linear_attenuation * light_dist +
+             light.quadratic_attenuation * light_dist * light_dist);
+
+    if (lambertian > 0) {
+      glm::vec3 half_dir = glm::normalize(light_dir + params.eye_direction);
+      float spec_angle = std::max(glm::dot(half_dir, normal), 0.0f);
+      specular = std::pow(spec_angle, params.shininess) * params.strength;
+    }
+
+    col += glm::vec4(lambertian * rgb * attenuation +
+                         specular * glm::mix(light.light_color, rgb, 0.3f) *
+                             attenuation,
+                     0);
+  }
+
+  glm::vec3 d = coords * tri.heights;
+  float edge_dist =
+      std::min(std::min(d[0], d[1]), d[2]) / params.edge_thickness;
+  if (edge_dist > 2.5f || params.edge_thickness < 1e-7) return col;
+
+  float edge_intensity = std::pow(4.0f, -edge_dist * edge_dist);
+  return glm::mix(col, params.edge_color, edge_intensity);
+}
+
+/**
+ * @brief Run \a task on every thread, including the calling one, and wait for
+ *        all of them to return.
+ */
+void CpuRasterizer::RunOnAllThreads(
+    const std::function<void(int thread)>& task) {
+  if (workers_.empty()) {
+    task(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    ++generation_;
+    num_busy_workers_ = workers_.size();
+  }
+  start_cv_.notify_all();
+  task(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return num_busy_workers_ == 0; });
+  task_ = nullptr;
+}
+
+void CpuRasterizer::WorkerLoop(int thread) {
+  size_t generation = 0;
+  while (true) {
+    const std::function<void(int)>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&] {
+        return is_stopping_ || generation_ != generation;
+      });
+      if (is_stopping_) return;
+      generation = generation_;
+      task = task_;
+    }
+    (*task)(thread);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--num_busy_workers_ == 0) done_cv_.notify_one();
+    }
+  }
+}
+}
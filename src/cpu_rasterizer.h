@@ -0,0 +1,106 @@
+/**
+ * @file cpu_rasterizer.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "graphics.h"
+#include "shape.h"
+
+namespace librender {
+
+/**
+ * @brief Software renderer for machines without a GPU. Draws a triangle mesh
+ *        with the shading of trimesh_shape.glsl into an RGBA buffer laid out
+ *        like Framebuffer::ReadPixels(), so that the two backends are
+ *        interchangeable.
+ *
+ * Triangles are clipped against the near plane and binned into screen tiles
+ * of kTileSize pixels. The tiles are then rasterized in parallel, four pixels
+ * at a time with SSE. Multisampling follows the GL model: depth and coverage
+ * per sample, shading once per pixel and triangle at the pixel center.
+ *
+ * Grid lines and face normal arrows are not drawn.
+ */
+class CpuRasterizer {
+ public:
+  CpuRasterizer(int num_threads = 0);
+  ~CpuRasterizer();
+
+  void Draw(const Shape& shape, const RenderParams& params, uint8_t* pixels);
+  int num_threads() const { return num_threads_; }
+
+  static const int kTileSize = 64;
+  static const int kMaxSamples = 8;
+
+ private:
+  // A screen-space triangle, possibly one part of a clipped face.
+  struct Triangle {
+    // Barycentric coordinates relative to the first vertex:
+    // b[i] = a[i] * (x - x0) + b[i] * (y - y0) + (i == 0).
+    float x0, y0;
+    float a[3], b[3];
+    // Whether pixels exactly on the edge opposite each vertex are covered.
+    bool is_top_left[3];
+    // Window-space depth and 1 / w of each vertex.
+    float z[3], inv_w[3];
+    // Barycentric coordinates of each vertex within the face.
+    glm::vec3 face_coords[3];
+    // Distance from each vertex of the face to its opposite edge.
+    glm::vec3 heights;
+    size_t face;
+    // Pixel bounds, inclusive.
+    int x_min, y_min, x_max, y_max;
+  };
+
+  struct TileBuffer {
+    // Sample-major: kTileSize * kTileSize values per sample.
+    std::vector<float> depth;
+    std::vector<const Triangle*> triangles;
+  };
+
+  void SetupTriangles(int thread, size_t begin, size_t end);
+  void AddTriangle(int thread, size_t face, const glm::vec4* clip,
+                   const glm::vec3* face_coords, const glm::vec3& heights);
+  void RasterizeTile(int thread, int tile, uint8_t* pixels);
+  glm::vec4 Shade(const Triangle& tri, float x, float y) const;
+
+  void RunOnAllThreads(const std::function<void(int thread)>& task);
+  void WorkerLoop(int thread);
+
+  int num_threads_;
+
+  // Per draw.
+  const Shape* shape_ = nullptr;
+  const RenderParams* params_ = nullptr;
+  int width_ = 0, height_ = 0, num_tiles_x_ = 0, num_tiles_y_ = 0;
+  int num_samples_ = 1;
+  const float* sample_offsets_ = nullptr;
+  uint8_t background_[4];
+  std::vector<glm::vec4> clip_positions_;
+
+  // Per thread. Triangles set up by each thread, and their indices per tile.
+  // Bins are visited in thread order, which keeps faces in draw order.
+  std::vector<std::vector<Triangle>> triangles_;
+  std::vector<std::vector<std::vector<uint32_t>>> bins_;
+  std::vector<TileBuffer> tile_buffers_;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_, done_cv_;
+  const std::function<void(int)>* task_ = nullptr;
+  size_t generation_ = 0;
+  int num_busy_workers_ = 0;
+  bool is_stopping_ = false;
+};
+}
@@ -48,6 +48,25 @@ VertexAttribBuffer::VertexAttribBuffer(GLenum target, GLuint attrib_index,
                         );
 };
 
+/**
+ * @brief One buffer of vertices whose attributes are next to each other.
+ */
+VertexAttribBuffer::VertexAttribBuffer(
+    GLenum target, const std::vector<VertexAttrib>& attribs, GLsizei stride,
+    const void* data, size_t data_bytes, bool is_static)
+    : DataBuffer(target, attribs[0].gl_type, data, data_bytes, is_static),
+      attrib_index(attribs[0].index),
+      attrib_size(attribs[0].size),
+      stride(stride) {
+  glBindBuffer(this->target, this->buffer_id);
+  for (const VertexAttrib& attrib : attribs) {
+    glEnableVertexAttribArray(attrib.index);
+    glVertexAttribPointer(attrib.index, attrib.size, attrib.gl_type,
+                          attrib.is_normalized, stride,
+                          (void*)attrib.offset);
+  }
+};
+
 IndexBuffer::IndexBuffer(GLenum target, GLenum mode, GLint num_item,
                          GLenum gl_type, const void* data, size_t data_bytes,
                          bool is_static)
@@ -8,11 +8,24 @@
  */
 #pragma once
 
+#include <stddef.h>
+#include <vector>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
 namespace librender {
 
+// One attribute of interleaved vertices.
+struct VertexAttrib {
+  GLuint index;
+  GLint size;
+  GLenum gl_type;
+  // Integers are mapped to [0, 1], or [-1, 1] if signed.
+  GLboolean is_normalized;
+  // From the start of the vertex.
+  size_t offset;
+};
+
 class DataBuffer {
  public:
   DataBuffer() : is_initialized(false){};
@@ -34,8 +47,14 @@ class VertexAttribBuffer : public DataBuffer {
   VertexAttribBuffer(GLenum target, GLuint attrib_index, GLint attrib_size,
                      GLenum gl_type, const void* data, size_t data_bytes,
                      bool is_static = true);
+  VertexAttribBuffer(GLenum target, const std::vector<VertexAttrib>& attribs,
+                     GLsizei stride, const void* data, size_t data_bytes,
+                     bool is_static = true);
+  // Of the first attribute if interleaved.
   GLuint attrib_index;
   GLint attrib_size;
+  // Bytes from one vertex to the next. 0 if tightly packed.
+  GLsizei stride = 0;
 };
 
 class IndexBuffer : public DataBuffer {
@@ -8,6 +8,9 @@
  */
 #include "framebuffer.h"
 
+#include <algorithm>
+#include "gpu_timer.h"
+
 namespace librender {
 
 /**
@@ -16,10 +19,21 @@ namespace librender {
  * @param width,height Size of the image in pixels.
  * @param num_msaa_samples Multisample anti-aliasing (MSAA) level. Typically
  *        2, 4, or 8.
+ * @param num_layers If greater than 0, color and depth are texture arrays
+ *        with this many layers, for use with gl_Layer.
+ * @param has_aux_outputs If true, view space normals and a foreground mask are
+ *        drawn to color attachments 1 and 2, and depth can be read back. Not
+ *        supported for layered framebuffers.
  */
-Framebuffer::Framebuffer(int width, int height, int num_msaa_samples) {
+Framebuffer::Framebuffer(int width, int height, int num_msaa_samples,
+                         int num_layers, bool has_aux_outputs) {
   w_ = width;
   h_ = height;
+  num_layers_ = num_layers;
+  has_aux_outputs_ = has_aux_outputs;
+  if (num_layers_ > 0 && has_aux_outputs_)
+    throw std::runtime_error(
+        "Layered framebuffers do not support depth, normal and mask outputs.");
 
   // Backup previous buffer IDs.
   GLint prevFBO, prevRBO;
@@ -27,8 +41,16 @@ Framebuffer::Framebuffer(int width, int height, int num_msaa_samples) {
   glGetIntegerv(GL_RENDERBUFFER_BINDING, &prevRBO);
 
   // Initialize both multisampled and normal buffers for anti-aliasing support.
-  InitializeFBO(draw_fbo_, num_msaa_samples);
-  InitializeFBO(read_fbo_, 0);
+  if (num_layers_ > 0) {
+    InitializeLayeredFBO(draw_fbo_, num_msaa_samples);
+    InitializeLayeredFBO(read_fbo_, 0);
+    glGenFramebuffers(1, &layer_fbo_);
+    glGenFramebuffers(1, &blit_src_fbo_);
+    glGenFramebuffers(1, &blit_dst_fbo_);
+  } else {
+    InitializeFBO(draw_fbo_, num_msaa_samples);
+    InitializeFBO(read_fbo_, 0);
+  }
 
   // Restore previous buffer IDs.
   glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
@@ -40,11 +62,27 @@ Framebuffer::Framebuffer(int width, int height, int num_msaa_samples) {
  */
 Framebuffer::~Framebuffer() {
   glDeleteFramebuffers(1, &draw_fbo_.id);
-  glDeleteRenderbuffers(1, &draw_fbo_.color_buf);
-  glDeleteRenderbuffers(1, &draw_fbo_.depth_buf);
   glDeleteFramebuffers(1, &read_fbo_.id);
-  glDeleteRenderbuffers(1, &read_fbo_.color_buf);
-  glDeleteRenderbuffers(1, &read_fbo_.depth_buf);
+  if (num_layers_ > 0) {
+    glDeleteTextures(1, &draw_fbo_.color_buf);
+    glDeleteTextures(1, &draw_fbo_.depth_buf);
+    glDeleteTextures(1, &read_fbo_.color_buf);
+    glDeleteTextures(1, &read_fbo_.depth_buf);
+    glDeleteFramebuffers(1, &layer_fbo_);
+    glDeleteFramebuffers(1, &blit_src_fbo_);
+    glDeleteFramebuffers(1, &blit_dst_fbo_);
+  } else {
+    for (FBO* fbo : {&draw_fbo_, &read_fbo_}) {
+      glDeleteRenderbuffers(1, &fbo->color_buf);
+      glDeleteRenderbuffers(1, &fbo->normal_buf);
+      glDeleteRenderbuffers(1, &fbo->mask_buf);
+      if (fbo->is_depth_texture) {
+        glDeleteTextures(1, &fbo->depth_buf);
+      } else {
+        glDeleteRenderbuffers(1, &fbo->depth_buf);
+      }
+    }
+  }
 }
 
 /**
@@ -72,12 +110,42 @@ void Framebuffer::InitializeFBO(FBO& fbo, int num_msaa_samples) {
   glBindFramebuffer(GL_FRAMEBUFFER, fbo.id);
   InitializeRBO(GL_COLOR_ATTACHMENT0, color_format_, num_msaa_samples,
                 fbo.color_buf);
-  InitializeRBO(GL_DEPTH_ATTACHMENT, GL_DEPTH_COMPONENT24, num_msaa_samples,
-                fbo.depth_buf);
+  if (has_aux_outputs_) {
+    InitializeRBO(GL_COLOR_ATTACHMENT1, GL_RGBA16, num_msaa_samples,
+                  fbo.normal_buf);
+    InitializeRBO(GL_COLOR_ATTACHMENT2, GL_R8, num_msaa_samples, fbo.mask_buf);
+  }
+
+  // Depth is read from the resolved buffer.
+  if (has_aux_outputs_ && num_msaa_samples == 0) {
+    InitializeDepthTexture(fbo.depth_buf);
+    fbo.is_depth_texture = true;
+  } else {
+    InitializeRBO(GL_DEPTH_ATTACHMENT, GL_DEPTH_COMPONENT24, num_msaa_samples,
+                  fbo.depth_buf);
+  }
+  SetAuxOutputsEnabled(true);
 
   CheckStatus();
 }
 
+/**
+ * @brief Initialize a depth texture with the same format as the multisampled
+ *        depth renderbuffer, which blits require.
+ * @param tex
+ */
+void Framebuffer::InitializeDepthTexture(GLuint& tex) {
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w_, h_, 0,
+               GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                         tex, 0);
+}
+
 /**
  * @brief Initialize a renderbuffer. If \a num_msaa_samples is greater than 0,
  *        it will be a multisampled buffer.
@@ -101,6 +169,54 @@ void Framebuffer::InitializeRBO(GLenum target, GLenum format,
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, target, GL_RENDERBUFFER, buf);
 }
 
+/**
+ * @brief Initialize a framebuffer whose attachments are texture arrays. All
+ *        layers are attached at once; the geometry shader selects one through
+ *        gl_Layer.
+ * @param fbo
+ * @param num_msaa_samples
+ */
+void Framebuffer::InitializeLayeredFBO(FBO& fbo, int num_msaa_samples) {
+  glGenFramebuffers(1, &fbo.id);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo.id);
+  InitializeTextureArray(GL_COLOR_ATTACHMENT0, GL_RGBA8, num_msaa_samples,
+                         fbo.color_buf);
+  InitializeTextureArray(GL_DEPTH_ATTACHMENT, GL_DEPTH_COMPONENT24,
+                         num_msaa_samples, fbo.depth_buf);
+
+  CheckStatus();
+}
+
+/**
+ * @brief Initialize a 2D texture array of \a num_layers_ layers. If
+ *        \a num_msaa_samples is greater than 0, it will be a multisampled
+ *        array.
+ * @param target GL_COLOR_ATTACHMENTi or GL_DEPTH_ATTACHMENT.
+ * @param format Sized internal format.
+ * @param num_msaa_samples
+ * @param tex
+ */
+void Framebuffer::InitializeTextureArray(GLenum target, GLenum format,
+                                         int num_msaa_samples, GLuint& tex) {
+  glGenTextures(1, &tex);
+  if (num_msaa_samples > 0) {
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, tex);
+    glTexImage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, num_msaa_samples,
+                            format, w_, h_, num_layers_, GL_TRUE);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, 0);
+  } else {
+    bool is_depth = target == GL_DEPTH_ATTACHMENT;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, w_, h_, num_layers_, 0,
+                 is_depth ? GL_DEPTH_COMPONENT : GL_RGBA,
+                 is_depth ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  }
+  glFramebufferTexture(GL_FRAMEBUFFER, target, tex, 0);
+}
+
 /**
  * @brief Backup the previous buffer and bind the draw buffer for writing.
  */
@@ -110,6 +226,52 @@ void Framebuffer::Bind() {
   CheckStatus();
 }
 
+/**
+ * @brief Bind a single layer of a layered framebuffer for writing. For draws
+ *        that do not set gl_Layer themselves.
+ * @param layer
+ */
+void Framebuffer::BindLayer(int layer) {
+  if (layer < 0 || layer >= num_layers_)
+    throw std::runtime_error("Framebuffer layer out of range.");
+  glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo_);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            draw_fbo_.color_buf, 0, layer);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            draw_fbo_.depth_buf, 0, layer);
+  CheckStatus();
+}
+
+/**
+ * @brief Clear the bound framebuffer: color to \a background, normals and mask
+ *        to zero and depth to the far plane. All layers are cleared.
+ * @param background RGBA.
+ */
+void Framebuffer::Clear(const float* background) {
+  static const float kZeros[] = {0, 0, 0, 0};
+  static const float kFarDepth = 1;
+  SetAuxOutputsEnabled(true);
+  glClearBufferfv(GL_COLOR, 0, background);
+  if (has_aux_outputs_) {
+    glClearBufferfv(GL_COLOR, 1, kZeros);
+    glClearBufferfv(GL_COLOR, 2, kZeros);
+  }
+  glClearBufferfv(GL_DEPTH, 0, &kFarDepth);
+}
+
+/**
+ * @brief Select whether draws into the bound framebuffer also write normals
+ *        and mask. Disable for geometry that should only show up in color,
+ *        since shaders without those outputs leave them undefined.
+ * @param is_enabled
+ */
+void Framebuffer::SetAuxOutputsEnabled(bool is_enabled) {
+  static const GLenum kDrawBuffers[] = {
+      GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+  if (!has_aux_outputs_) return;
+  glDrawBuffers(is_enabled ? 3 : 1, kDrawBuffers);
+}
+
 /**
  * @brief Restore the previous buffer. There is no need to call this function
  *        if the previous buffer is not needed.
@@ -117,38 +279,134 @@ void Framebuffer::Bind() {
 void Framebuffer::Unbind() {
   GLint current_buffer_id;
   glGetIntegerv(GL_FRAMEBUFFER_BINDING, &current_buffer_id);
-  if ((GLuint)current_buffer_id == draw_fbo_.id)
+  if ((GLuint)current_buffer_id == draw_fbo_.id ||
+      (layer_fbo_ != 0 && (GLuint)current_buffer_id == layer_fbo_))
     glBindFramebuffer(GL_FRAMEBUFFER, prev_buffer_id_);
 }
 
 /**
  * @brief Return the size of the buffer in bytes. Each R, G, B, A channel takes
  *        up one byte. ReadPixels() needs this amount of memory allocated.
+ *        Layered framebuffers need one image per layer, and aux outputs are
+ *        appended after the color image.
  * @return Size
  * @see ReadPixels
  */
-size_t Framebuffer::Size() { return sizeof(uint8_t) * w_ * h_ * pixel_size_; }
+size_t Framebuffer::Size() { return Offset(kNumOutputs); }
+
+/**
+ * @brief Byte offset of \a output in the memory filled by ReadPixels().
+ * @param output
+ * @return
+ */
+size_t Framebuffer::Offset(Output output) {
+  size_t offset = 0;
+  for (int i = kColor; i < output; ++i) offset += OutputSize((Output)i);
+  return offset;
+}
 
 /**
- * @brief Read color pixels from the framebuffer object.
+ * @brief 4 bytes per pixel for color and depth, three 16-bit values for
+ *        normals and one byte for the mask. 0 if the output is not available.
+ */
+size_t Framebuffer::OutputSize(Output output) {
+  size_t num_pixels = (size_t)w_ * h_;
+  switch (output) {
+    case kColor:
+      return num_pixels * pixel_size_ * std::max(num_layers_, 1);
+    case kDepth:
+      return has_aux_outputs_ ? num_pixels * sizeof(float) : 0;
+    case kNormal:
+      return has_aux_outputs_ ? num_pixels * 3 * sizeof(uint16_t) : 0;
+    case kMask:
+      return has_aux_outputs_ ? num_pixels : 0;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Read all outputs from the framebuffer object in one pass. The
+ *        multisampled draw buffer is resolved first.
+ *
+ * If a buffer is bound to GL_PIXEL_PACK_BUFFER, \a pixels is an offset into
+ * that buffer and the call returns without waiting for the GPU. Otherwise the
+ * driver blocks until the pixels are in client memory.
  *
- * @param[out] pixels A pointer to a preallocated block of memory. Output will
- *             be in R, G, B, A, R, G, B, ... order from the <b>bottom left</a>
- *             corner.
+ * @param[out] pixels A pointer to a preallocated block of Size() bytes. Color
+ *             will be in R, G, B, A, R, G, B, ... order from the <b>bottom
+ *             left</a> corner. Layers of a layered framebuffer follow each
+ *             other. Depth, normals and mask follow at Offset().
  * @see Size
  */
 void Framebuffer::ReadPixels(uint8_t* pixels) {
-  // Block until all GL execution is complete.
-  glFinish();
+  ScopedGpuTimer gpu_timer("gpu readback");
+  Resolve();
+
+  if (num_layers_ > 0) {
+    // One transfer for all layers.
+    glBindTexture(GL_TEXTURE_2D_ARRAY, read_fbo_.color_buf);
+    glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, color_format_, GL_UNSIGNED_BYTE,
+                  pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, read_fbo_.id);
+    return;
+  }
+
+  ReadColor(pixels);
+  if (has_aux_outputs_) {
+    ReadDepth((float*)(pixels + Offset(kDepth)));
+    ReadNormals((uint16_t*)(pixels + Offset(kNormal)));
+    ReadMask(pixels + Offset(kMask));
+  }
+}
+
+/**
+ * @brief Read from the multisampled draw buffer and write the antialiased
+ *        output to the read buffer. Depth is copied from a single sample.
+ */
+void Framebuffer::Resolve() {
+  if (num_layers_ > 0) {
+    ResolveLayers();
+    return;
+  }
 
-  // Read from the multisampled draw buffer and write the antialiased output to
-  // the read buffer.
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, read_fbo_.id);
   glBindFramebuffer(GL_READ_FRAMEBUFFER, draw_fbo_.id);
 
-  glBlitFramebuffer(0, 0, w_, h_, 0, 0, w_, h_, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  if (!has_aux_outputs_) {
+    glBlitFramebuffer(0, 0, w_, h_, 0, 0, w_, h_, GL_COLOR_BUFFER_BIT,
+                      GL_LINEAR);
+    return;
+  }
+
+  BlitAttachment(GL_COLOR_ATTACHMENT0);
+  BlitAttachment(GL_COLOR_ATTACHMENT1);
+  BlitAttachment(GL_COLOR_ATTACHMENT2);
+  glBlitFramebuffer(0, 0, w_, h_, 0, 0, w_, h_, GL_DEPTH_BUFFER_BIT,
+                    GL_NEAREST);
+
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  SetAuxOutputsEnabled(true);
+}
+
+/**
+ * @brief Blit one color attachment of the draw buffer to the same attachment
+ *        of the read buffer. Both must be bound.
+ * @param attachment
+ */
+void Framebuffer::BlitAttachment(GLenum attachment) {
+  glReadBuffer(attachment);
+  glDrawBuffers(1, &attachment);
+  glBlitFramebuffer(0, 0, w_, h_, 0, 0, w_, h_, GL_COLOR_BUFFER_BIT,
+                    GL_LINEAR);
+}
 
-  // Read the color pixels from the read buffer.
+/**
+ * @brief Read the resolved color image. Call Resolve() first.
+ * @param[out] pixels w * h * 4 bytes.
+ */
+void Framebuffer::ReadColor(uint8_t* pixels) {
   glBindFramebuffer(GL_FRAMEBUFFER, read_fbo_.id);
   CheckStatus();
 
@@ -156,6 +414,60 @@ void Framebuffer::ReadPixels(uint8_t* pixels) {
   glReadPixels(0, 0, w_, h_, color_format_, GL_UNSIGNED_BYTE, pixels);
 }
 
+/**
+ * @brief Read window space depth, 0 at the near plane and 1 at the far plane
+ *        or where nothing was drawn. Call Resolve() first.
+ * @param[out] depth w * h floats.
+ */
+void Framebuffer::ReadDepth(float* depth) {
+  glBindFramebuffer(GL_FRAMEBUFFER, read_fbo_.id);
+  glReadPixels(0, 0, w_, h_, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
+}
+
+/**
+ * @brief Read view space normals, mapped from [-1, 1] to [0, 65535]. Zero
+ *        where nothing was drawn. Call Resolve() first.
+ * @param[out] normals w * h * 3 values.
+ */
+void Framebuffer::ReadNormals(uint16_t* normals) {
+  glBindFramebuffer(GL_FRAMEBUFFER, read_fbo_.id);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadBuffer(GL_COLOR_ATTACHMENT1);
+  glReadPixels(0, 0, w_, h_, GL_RGB, GL_UNSIGNED_SHORT, normals);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+/**
+ * @brief Read the foreground mask: 255 where the mesh covers a pixel, 0 where
+ *        it does not and in between on antialiased edges. Call Resolve()
+ *        first.
+ * @param[out] mask w * h bytes.
+ */
+void Framebuffer::ReadMask(uint8_t* mask) {
+  glBindFramebuffer(GL_FRAMEBUFFER, read_fbo_.id);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadBuffer(GL_COLOR_ATTACHMENT2);
+  glReadPixels(0, 0, w_, h_, GL_RED, GL_UNSIGNED_BYTE, mask);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+/**
+ * @brief Resolve each multisampled layer into the read buffer. Blits only
+ *        operate on one layer at a time.
+ */
+void Framebuffer::ResolveLayers() {
+  for (int i = 0; i < num_layers_; ++i) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, blit_src_fbo_);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              draw_fbo_.color_buf, 0, i);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, blit_dst_fbo_);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              read_fbo_.color_buf, 0, i);
+    glBlitFramebuffer(0, 0, w_, h_, 0, 0, w_, h_, GL_COLOR_BUFFER_BIT,
+                      GL_LINEAR);
+  }
+}
+
 /**
  * @brief Translate the OpenGL framebuffer error codes to English.
  * @param status
@@ -18,27 +18,58 @@ namespace librender {
 
 class Framebuffer {
  public:
-  Framebuffer(int width, int height, int num_msaa_samples = 4);
+  // Images returned by ReadPixels(), in this order.
+  enum Output { kColor, kDepth, kNormal, kMask, kNumOutputs };
+
+  Framebuffer(int width, int height, int num_msaa_samples = 4,
+              int num_layers = 0, bool has_aux_outputs = false);
   ~Framebuffer();
   void Bind();
+  void BindLayer(int layer);
   void Unbind();
+  void Clear(const float* background);
+  void SetAuxOutputsEnabled(bool is_enabled);
   size_t Size();
+  size_t Offset(Output output);
+  int num_layers() const { return num_layers_; }
+  bool has_aux_outputs() const { return has_aux_outputs_; }
   void ReadPixels(uint8_t* pixels);
+  void Resolve();
+  void ReadColor(uint8_t* pixels);
+  void ReadDepth(float* depth);
+  void ReadNormals(uint16_t* normals);
+  void ReadMask(uint8_t* mask);
 
  private:
   struct FBO {
     GLuint id = 0, color_buf = 0, depth_buf = 0;
+    GLuint normal_buf = 0, mask_buf = 0;
+    // The depth of the read buffer is a texture if there are aux outputs.
+    bool is_depth_texture = false;
   };
 
   void InitializeFBO(FBO& fbo, int num_msaa_samples);
+  void InitializeDepthTexture(GLuint& tex);
+  void BlitAttachment(GLenum attachment);
+  size_t OutputSize(Output output);
   void InitializeRBO(GLenum target, GLenum format, int num_msaa_samples,
                      GLuint& buf);
+  void InitializeLayeredFBO(FBO& fbo, int num_msaa_samples);
+  void InitializeTextureArray(GLenum target, GLenum format,
+                              int num_msaa_samples, GLuint& tex);
+  void ResolveLayers();
   std::string GetStatusErrorString(GLenum status);
   void CheckStatus();
 
   int w_, h_;
+  // 0 for renderbuffers. Otherwise the attachments are texture arrays.
+  int num_layers_;
+  // Normals and the foreground mask are drawn to color attachments 1 and 2.
+  bool has_aux_outputs_;
   GLint prev_buffer_id_;
   FBO draw_fbo_, read_fbo_;
+  // Single-layer views into the texture arrays.
+  GLuint layer_fbo_ = 0, blit_src_fbo_ = 0, blit_dst_fbo_ = 0;
 
   GLenum color_format_ = GL_RGBA;
   size_t pixel_size_ = 4;  // 3 for GL_RGB
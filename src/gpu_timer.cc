@@ -0,0 +1,105 @@
+/**
+ * @file gpu_timer.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "gpu_timer.h"
+
+#include <algorithm>
+#include "profiler.h"
+
+namespace librender {
+
+GpuTimer* GpuTimer::current = nullptr;
+
+GpuTimer::GpuTimer() {}
+
+/**
+ * @brief Pending results are dropped. Call Flush() first to keep them.
+ */
+GpuTimer::~GpuTimer() {
+  if (is_active_) glEndQuery(GL_TIME_ELAPSED);
+  for (const Query& query : pending_) glDeleteQueries(1, &query.id);
+  if (!free_ids_.empty())
+    glDeleteQueries(free_ids_.size(), free_ids_.data());
+}
+
+/**
+ * @brief Start timing the commands issued until End().
+ * @param name Pass name, e.g. "gpu shape". Must outlive the profiler.
+ * @return false if another pass is being timed. End() must not be called.
+ */
+bool GpuTimer::Begin(const char* name) {
+  if (is_active_) return false;
+  // Results that are ready anyway, to keep the pool small.
+  Poll();
+
+  GLuint id;
+  if (free_ids_.empty()) {
+    glGenQueries(1, &id);
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  glBeginQuery(GL_TIME_ELAPSED, id);
+  pending_.push_back(
+      {id, name, profiler::ScopedTimer::Now(), profiler::CurrentJob()});
+  is_active_ = true;
+  return true;
+}
+
+void GpuTimer::End() {
+  glEndQuery(GL_TIME_ELAPSED);
+  is_active_ = false;
+}
+
+/**
+ * @brief Record finished passes, oldest first. Never blocks.
+ */
+void GpuTimer::Poll() {
+  // The last one may still be open.
+  size_t num_ended = pending_.size() - (is_active_ ? 1 : 0);
+  while (num_ended > 0) {
+    GLint is_available = 0;
+    glGetQueryObjectiv(pending_.front().id, GL_QUERY_RESULT_AVAILABLE,
+                       &is_available);
+    if (!is_available) break;
+    Complete(pending_.front());
+    pending_.pop_front();
+    num_ended--;
+  }
+}
+
+/**
+ * @brief Wait for every ended pass and record it.
+ */
+void GpuTimer::Flush() {
+  size_t num_ended = pending_.size() - (is_active_ ? 1 : 0);
+  for (; num_ended > 0; --num_ended) {
+    Complete(pending_.front());
+    pending_.pop_front();
+  }
+}
+
+/**
+ * @brief Record the result of \a query, waiting for it if needed, and return
+ *        the query object to the pool.
+ */
+void GpuTimer::Complete(const Query& query) {
+  GLuint64 elapsed_ns = 0;
+  glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed_ns);
+  free_ids_.push_back(query.id);
+  // Some drivers (e.g. llvmpipe) return a timestamp instead for the first
+  // query of a context. No pass takes longer than the time since it began.
+  if ((int64_t)elapsed_ns > profiler::ScopedTimer::Now() - query.start_ns)
+    return;
+
+  int64_t start_ns = std::max(query.start_ns, last_end_ns_);
+  last_end_ns_ = start_ns + (int64_t)elapsed_ns;
+  profiler::RecordOnTrack("gpu", query.name, start_ns, last_end_ns_,
+                          query.job);
+}
+}
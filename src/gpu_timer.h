@@ -0,0 +1,80 @@
+/**
+ * @file gpu_timer.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+
+namespace librender {
+
+/**
+ * @brief GPU time of draw passes, measured with GL_TIME_ELAPSED queries.
+ *        Results are collected without waiting for the GPU and recorded as
+ *        profiler events on a "gpu" track, tagged with the job that was
+ *        current when the pass was submitted.
+ *
+ * Queries cannot overlap, so a pass that begins while another one is being
+ * timed is counted as part of the outer one. All methods run on the thread
+ * that owns the GL context.
+ */
+class GpuTimer {
+ public:
+  GpuTimer();
+  ~GpuTimer();
+
+  bool Begin(const char* name);
+  void End();
+  void Poll();
+  void Flush();
+
+  // Used by ScopedGpuTimer. Set while a RenderSession with GPU profiling
+  // exists, nullptr otherwise.
+  static GpuTimer* current;
+
+ private:
+  struct Query {
+    GLuint id;
+    const char* name;
+    // When the pass was submitted.
+    int64_t start_ns;
+    int64_t job;
+  };
+
+  void Complete(const Query& query);
+
+  // Pending in submission order. Results become available in the same order.
+  std::deque<Query> pending_;
+  std::vector<GLuint> free_ids_;
+  bool is_active_ = false;
+  // Passes run one after another on the GPU. In the trace, each starts when
+  // it was submitted or when the previous one ended, whichever is later.
+  int64_t last_end_ns_ = 0;
+};
+
+/**
+ * @brief Times the enclosing scope with GpuTimer::current, if set.
+ */
+class ScopedGpuTimer {
+ public:
+  explicit ScopedGpuTimer(const char* name) : timer_(GpuTimer::current) {
+    if (timer_ != nullptr && !timer_->Begin(name)) timer_ = nullptr;
+  }
+  ~ScopedGpuTimer() {
+    if (timer_ != nullptr) timer_->End();
+  }
+
+ private:
+  ScopedGpuTimer(const ScopedGpuTimer&) = delete;
+  ScopedGpuTimer& operator=(const ScopedGpuTimer&) = delete;
+
+  GpuTimer* timer_;
+};
+}
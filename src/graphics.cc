@@ -22,6 +22,7 @@
 #include "shader_object.h"
 #include "config.h"
 #include "framebuffer.h"
+#include "render_session.h"
 #include "io.h"
 #include "gui.h"
 #include "shaders/trimesh_shape_shader.h"
@@ -39,6 +40,8 @@ RenderParams::RenderParams() {
 
   up_axis = Y;
   will_normalize = true;
+  normal_weighting = NormalWeighting::kArea;
+  crease_angle = 180;
   are_axes_visible = false;
   background = glm::vec4(1, 1, 1, 1);
 
@@ -65,37 +68,32 @@ RenderParams::RenderParams() {
   image_width = 800;
   image_height = 600;
   can_overwrite = false;
+  job_index = 0;
 
   num_msaa_samples = 4;
 
   color = arma::fvec({1, 0, 0, 1});
   is_color_forced = false;
+  is_layered = false;
+  has_aux_outputs = false;
 }
 
 /**
- * @brief
- * @param object
- * @param filename
+ * @brief Show \a shape in a window, or save it as an image if
+ *        \a params.out_filename is set.
+ * @param shape
+ * @param params
  */
 void Render(const Shape& shape, RenderParams& params) {
-  bool is_off_screen = true;
-  if (params.out_filename.empty()) {
-    is_off_screen = false;
+  // A one-off session. Use RenderSession directly to render many shapes.
+  if (!params.out_filename.empty()) {
+    RenderSession session(params);
+    session.Render(shape, params);
+    return;
   }
 
-  int window_width, window_height;
-  if (is_off_screen) {
-    // Invisible window
-    window_width = 0;
-    window_height = 0;
-
-  } else {
-    window_width = params.image_width;
-    window_height = params.image_height;
-  }
-
-  GLFWwindow* window = gui::CreateWindow(window_width, window_height,
-                                         config::window_title, params);
+  GLFWwindow* window = gui::CreateWindow(
+      params.image_width, params.image_height, config::window_title, params);
 
   // Support experimental drivers
   glewExperimental = true;
@@ -105,16 +103,6 @@ void Render(const Shape& shape, RenderParams& params) {
     throw std::runtime_error("Failed to open GLEW.");
   }
 
-  Framebuffer* framebuffer;
-  if (is_off_screen) {
-    framebuffer = new Framebuffer(params.image_width, params.image_height,
-                                  params.num_msaa_samples);
-    framebuffer->Bind();
-    // Required for the new framebuffer object.
-    glViewport(0, 0, params.image_width, params.image_height);
-    glEnable(GL_MULTISAMPLE);
-  }
-
   glm::vec4 bg = params.background;
   glClearColor(bg.r, bg.g, bg.b, bg.a);
 
@@ -146,21 +134,7 @@ void Render(const Shape& shape, RenderParams& params) {
 
     glfwSwapBuffers(window);
     glfwWaitEvents();
-  } while (!is_off_screen && !glfwWindowShouldClose(window));
-
-  if (is_off_screen) {
-    // Read pixel values from the framebuffer.
-    size_t buffer_size = framebuffer->Size();
-    uint8_t* pixels = (uint8_t*)malloc(buffer_size);
-    framebuffer->ReadPixels(pixels);
-
-    io::SaveAsPNG(params.out_filename, pixels, params.image_width,
-                  params.image_height, params.can_overwrite);
-    free(pixels);
-    framebuffer->Unbind();
-
-    delete framebuffer;
-  }
+  } while (!glfwWindowShouldClose(window));
 
   glDeleteProgram(shader_id);
   glfwTerminate();
@@ -14,6 +14,7 @@
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
+#include "png_encoder.h"
 #include "shape.h"
 #include "shader.h"
 
@@ -21,6 +22,10 @@ namespace librender {
 
 enum Axis { X, Y, Z };
 
+// How the faces around a vertex are weighted in its estimated normal: by
+// their area, or by their angle at the vertex.
+enum class NormalWeighting { kArea, kAngle };
+
 struct ShaderParams {
   glm::mat4 view_mat;
   glm::mat4 projection_mat;
@@ -42,6 +47,19 @@ struct ShaderParams {
   glm::vec4 grid_color = glm::vec4(0.8, 0.8, 0.8, 1);
   float grid_size = 2.5;
   int grid_num_cells = 25;
+
+  // Per-layer camera for layered rendering. Sized before the shader objects
+  // are created since they keep pointers to the elements.
+  std::vector<glm::mat4> layer_view_projection_mats;
+  std::vector<glm::vec3> layer_eye_directions;
+};
+
+// Camera location in the same spherical coordinates as RenderParams.
+struct CameraPose {
+  float r;
+  float el;
+  float az;
+  float up_angle;
 };
 
 class RenderParams {
@@ -49,6 +67,11 @@ class RenderParams {
   RenderParams();
 
   bool will_normalize;
+  // Of vertex normals that are not in the mesh file.
+  NormalWeighting normal_weighting;
+  // In degrees. Vertices are split where their faces meet at a larger angle,
+  // so that normals are not smoothed across the crease. 180 for never.
+  float crease_angle;
   glm::vec3 target;
   float fov;
   Axis up_axis;
@@ -57,6 +80,8 @@ class RenderParams {
   float el;
   float az;
   float r;
+  // If not empty, one image is rendered per pose instead of the pose above.
+  std::vector<CameraPose> views;
   float near;
   float far;
   int image_width;
@@ -65,10 +90,17 @@ class RenderParams {
   glm::vec4 background;
   arma::fvec color;
   bool is_color_forced;
+  // Draw all views into layers of one framebuffer in a single pass.
+  bool is_layered;
+  // Also save linear depth, view-space normals and a foreground mask.
+  bool has_aux_outputs;
 
   std::string in_filename;
   std::string out_filename;
+  // Position of this job on the command line.
+  size_t job_index;
   bool can_overwrite;
+  io::PngOptions png_options;
 
   ShaderParams shader_params;
 };
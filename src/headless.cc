@@ -0,0 +1,160 @@
+/**
+ * @file headless.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "headless.h"
+
+#include <stdexcept>
+
+#ifdef LIBRENDER_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+namespace librender {
+
+#ifdef LIBRENDER_EGL
+namespace {
+
+template <typename T>
+T GetProc(const char* name) {
+  return reinterpret_cast<T>(eglGetProcAddress(name));
+}
+
+bool HasExtension(EGLDisplay display, const std::string& name) {
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (extensions == nullptr) return false;
+  std::string list = std::string(" ") + extensions + " ";
+  return list.find(" " + name + " ") != std::string::npos;
+}
+}
+
+/**
+ * @brief Create the context and make it current on the calling thread.
+ */
+HeadlessContext::HeadlessContext() {
+  auto get_platform_display =
+      GetProc<PFNEGLGETPLATFORMDISPLAYEXTPROC>("eglGetPlatformDisplayEXT");
+  bool has_client_extensions =
+      HasExtension(EGL_NO_DISPLAY, "EGL_EXT_platform_base");
+
+  // A GPU, without going through X or Wayland.
+  auto query_devices = GetProc<PFNEGLQUERYDEVICESEXTPROC>("eglQueryDevicesEXT");
+  if (has_client_extensions && get_platform_display && query_devices &&
+      HasExtension(EGL_NO_DISPLAY, "EGL_EXT_platform_device")) {
+    const int kMaxDevices = 16;
+    EGLDeviceEXT devices[kMaxDevices];
+    EGLint num_devices = 0;
+    query_devices(kMaxDevices, devices, &num_devices);
+    platform_ = "EGL device";
+    for (EGLint i = 0; i < num_devices; ++i) {
+      if (Initialize(get_platform_display(EGL_PLATFORM_DEVICE_EXT, devices[i],
+                                          nullptr)))
+        return;
+    }
+  }
+
+  // Mesa, including software rasterizers, with no display at all.
+  if (has_client_extensions && get_platform_display &&
+      HasExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+    platform_ = "EGL surfaceless";
+    if (Initialize(get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, nullptr)))
+      return;
+  }
+
+  platform_ = "EGL default display";
+  if (Initialize(eglGetDisplay(EGL_DEFAULT_DISPLAY))) return;
+
+  throw std::runtime_error("Unable to create an OpenGL 3.3 context with EGL.");
+}
+
+HeadlessContext::~HeadlessContext() {
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (surface_ != nullptr) eglDestroySurface(display_, surface_);
+  eglDestroyContext(display_, context_);
+  eglTerminate(display_);
+}
+
+/**
+ * @brief Try to create a core profile context on \a display. A 1x1 pbuffer is
+ *        only created if the display does not support surfaceless contexts.
+ * @param display EGLDisplay. Terminated on failure.
+ * @return false if \a display cannot be used.
+ */
+bool HeadlessContext::Initialize(void* display) {
+  if (display == EGL_NO_DISPLAY) return false;
+  EGLint major, minor;
+  if (!eglInitialize(display, &major, &minor)) return false;
+
+  bool is_surfaceless = HasExtension(display, "EGL_KHR_surfaceless_context");
+  const EGLint config_attribs[] = {
+      EGL_SURFACE_TYPE, is_surfaceless ? 0 : EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_BLUE_SIZE, 8,
+      EGL_NONE};
+  const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+      EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+      EGL_NONE};
+  const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+
+  EGLConfig config;
+  EGLint num_configs = 0;
+  EGLContext context = EGL_NO_CONTEXT;
+  EGLSurface surface = EGL_NO_SURFACE;
+  if (eglChooseConfig(display, config_attribs, &config, 1, &num_configs) &&
+      num_configs > 0 && eglBindAPI(EGL_OPENGL_API)) {
+    context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+  }
+  if (context != EGL_NO_CONTEXT && !is_surfaceless) {
+    surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+  }
+  if (context == EGL_NO_CONTEXT ||
+      (!is_surfaceless && surface == EGL_NO_SURFACE) ||
+      !eglMakeCurrent(display, surface, surface, context)) {
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    eglTerminate(display);
+    return false;
+  }
+
+  display_ = display;
+  context_ = context;
+  surface_ = (surface == EGL_NO_SURFACE) ? nullptr : surface;
+  return true;
+}
+
+void HeadlessContext::MakeCurrent() {
+  EGLSurface surface = (surface_ == nullptr) ? EGL_NO_SURFACE : surface_;
+  if (!eglMakeCurrent(display_, surface, surface, context_))
+    throw std::runtime_error("Unable to make the EGL context current.");
+}
+
+#else
+
+HeadlessContext::HeadlessContext() {
+  throw std::runtime_error("librender was built without EGL.");
+}
+
+HeadlessContext::~HeadlessContext() {}
+
+bool HeadlessContext::Initialize(void* display) { return false; }
+
+void HeadlessContext::MakeCurrent() {}
+
+#endif
+}
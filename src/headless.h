@@ -0,0 +1,42 @@
+/**
+ * @file headless.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <string>
+
+namespace librender {
+
+/**
+ * @brief OpenGL 3.3 core context without a window or display server, created
+ *        through EGL. Tries a GPU device first, then Mesa's surfaceless
+ *        platform (e.g. llvmpipe), then the default display. Nothing can be
+ *        drawn to a default framebuffer; render into a Framebuffer instead.
+ *
+ * Only available if built with EGL (LIBRENDER_EGL). Otherwise, and if no
+ * display supports the context, the constructor throws.
+ */
+class HeadlessContext {
+ public:
+  HeadlessContext();
+  ~HeadlessContext();
+
+  void MakeCurrent();
+  // e.g. "EGL device", "EGL surfaceless"
+  const std::string& platform() const { return platform_; }
+
+ private:
+  bool Initialize(void* display);
+
+  // EGLDisplay, EGLContext and EGLSurface.
+  void* display_ = nullptr;
+  void* context_ = nullptr;
+  void* surface_ = nullptr;
+  std::string platform_;
+};
+}
@@ -8,11 +8,12 @@
  */
 #include "io.h"
 
+#include <fstream>
 #include <iomanip>
 #include <pwd.h>
 #include <random>
-#include "third_party/lodepng/lodepng.h"
 #include "config.h"
+#include "profiler.h"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
@@ -216,13 +217,32 @@ bool ResolveFilenameConflict(std::string& filename, int max_num,
  * @param data Raw pixel values from the OpenGL framebuffer.
  * @param w,h Size of the image.
  * @param allow_overwrite
+ * @param options Compression level and filter.
+ * @param num_threads Encoder threads. 0 for the number of cores.
+ * @return The filename written to, after resolving conflicts.
  */
-void SaveAsPNG(std::string filename, const uint8_t* data, int w, int h,
-               bool allow_overwrite) {
+std::string SaveAsPNG(std::string filename, const uint8_t* data, int w, int h,
+                      bool allow_overwrite, const PngOptions& options,
+                      int num_threads) {
   if (!allow_overwrite) ResolveFilenameConflict(filename);
   fs::create_directories(fs::path(filename).parent_path());
-  if (config::is_verbose) std::cout << "Saving as " << filename << std::endl;
-  lodepng::encode(filename, data, w, h);
+  // One write, since encoder threads may be saving at the same time.
+  if (config::is_verbose) std::cout << "Saving as " + filename + "\n";
+
+  std::vector<uint8_t> png;
+  EncodePNG(data, w, h, png, options, num_threads);
+  WriteFile(filename, png);
+  return filename;
+}
+
+/**
+ * @brief Write \a data to \a filename, replacing its contents.
+ */
+void WriteFile(const std::string& filename, const std::vector<uint8_t>& data) {
+  profiler::ScopedTimer timer("write");
+  std::ofstream file(filename, std::ios::binary);
+  file.write((const char*)data.data(), data.size());
+  if (!file) throw std::runtime_error("Unable to write " + filename);
 }
 
 /**
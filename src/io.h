@@ -9,8 +9,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include "png_encoder.h"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
@@ -26,8 +28,11 @@ void RemoveTrailingSep(std::string& path);
 void AppendSepToPath(std::string& path);
 bool ResolveFilenameConflict(std::string& filename, int max_num = 20,
                              bool use_random = true);
-void SaveAsPNG(std::string filename, const uint8_t* data, int w, int h,
-               bool allow_overwrite = true);
+std::string SaveAsPNG(std::string filename, const uint8_t* data, int w, int h,
+                      bool allow_overwrite = true,
+                      const PngOptions& options = PngOptions(),
+                      int num_threads = 0);
+void WriteFile(const std::string& filename, const std::vector<uint8_t>& data);
 std::string UpSearch(const fs::path& dir, const fs::path& filename);
 }
 }
@@ -15,11 +15,28 @@
 #include "io.h"
 #include "config.h"
 #include "debug.h"
+#include "profiler.h"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 namespace librender {
 namespace config {
+namespace {
+
+/**
+ * @brief The png-filter of the config file found from \a filename as
+ *        InitFromFile() finds it, if it has one.
+ */
+bool ConfigPngFilter(const std::string& filename, int& filter) {
+  std::string config_file = librender::io::UpSearch(
+      fs::path(filename).parent_path(), librender::kConfigFileName);
+  if (config_file.empty()) return false;
+  YAML::Node config = YAML::LoadFile(config_file);
+  if (!config["png-filter"].IsDefined()) return false;
+  filter = io::PngFilterFromName(config["png-filter"].as<std::string>());
+  return true;
+}
+}
 
 int InitFromMainArgs(int argc, char* argv[],
                      std::vector<RenderParams>& all_params) {
@@ -37,6 +54,15 @@ int InitFromMainArgs(int argc, char* argv[],
   auto resolution_opt = po::value<float>();
   auto mesh_files_opt = po::value<std::vector<std::string>>()->required();
   auto out_opt = po::value<std::string>();
+  auto num_views_opt = po::value<int>();
+  auto jobs_opt = po::value<int>();
+  auto png_compression_opt = po::value<std::string>();
+  auto png_filter_opt = po::value<std::string>();
+  auto npy_opt = po::value<std::string>();
+  auto backend_opt = po::value<std::string>();
+  auto trace_opt = po::value<std::string>();
+  auto mesh_cache_opt = po::value<std::string>();
+  auto mesh_cache_size_opt = po::value<int64_t>();
   desc.add_options()
 
       ("version,v", "print version string")
@@ -49,6 +75,54 @@ int InitFromMainArgs(int argc, char* argv[],
 
       ("out,o", out_opt, "path to output directory or filename. .png")
 
+      ("num-views", num_views_opt,
+       "render N views evenly spaced in azimuth around the camera position")
+
+      ("layered", "render multiple views into layers of one framebuffer")
+
+      ("aux-outputs", "also save depth (.npy), normal and mask images")
+
+      ("jobs,j", jobs_opt,
+       "number of image encoding threads. meshes are loaded two at a time "
+       "on all cores. default: number of cores")
+
+      ("png-compression", png_compression_opt,
+       "store, fast, default or best. overrides png-compression, but not "
+       "png-filter, of .renderrc")
+
+      ("png-filter", png_filter_opt,
+       "adaptive, none, sub, up, average or paeth. overrides .renderrc")
+
+      ("npy", npy_opt,
+       "write all images into one N x H x W x 4 uint8 .npy file instead of "
+       "PNG files. N is the number of jobs times the number of views")
+
+      ("backend", backend_opt,
+       "gl or cpu. cpu draws off-screen images without a GPU, but no grid, "
+       "normal arrows or aux outputs. default: gl")
+
+      ("profile", "print the time spent in each stage, per job and overall")
+
+      ("trace", trace_opt,
+       "write stage timings to a Chrome trace (.json) with one track per "
+       "thread. implies --profile")
+
+      ("gpu-profile",
+       "also time each draw pass and readback on the GPU with timer "
+       "queries. implies --profile")
+
+      ("mesh-cache", mesh_cache_opt,
+       "cache loaded meshes in this directory, so that unchanged files are "
+       "not parsed again")
+
+      ("mesh-cache-size", mesh_cache_size_opt,
+       "size limit of the mesh cache in MB. least recently used meshes are "
+       "removed first. default: 4096")
+
+      ("quantize-vertices",
+       "upload 16-bit positions and normals and 8-bit colors, at 20 instead "
+       "of 48 bytes per vertex")
+
       ("mesh-files", mesh_files_opt, "supported file types: .obj");
 
   po::positional_options_description positional_opts;
@@ -82,6 +156,7 @@ int InitFromMainArgs(int argc, char* argv[],
     for (const std::string& filename : in_files) {
       RenderParams params;
       params.in_filename = filename;
+      params.job_index = all_params.size();
       InitFromFile(config_file, params);
 
       // Default lighting
@@ -109,6 +184,72 @@ int InitFromMainArgs(int argc, char* argv[],
       }
     }
 
+    if (vm.count("num-views")) {
+      int num_views = vm["num-views"].as<int>();
+      for (RenderParams& params : all_params) {
+        params.views.clear();
+        for (int i = 0; i < num_views; ++i) {
+          float az = params.az + 2 * kPi * i / num_views;
+          params.views.push_back({params.r, params.el, az, params.up_angle});
+        }
+      }
+    }
+
+    if (vm.count("jobs")) {
+      config::num_jobs = vm["jobs"].as<int>();
+      if (config::num_jobs < 1)
+        throw std::runtime_error("--jobs must be at least 1");
+    }
+
+    if (vm.count("png-compression")) {
+      io::PngOptions preset =
+          io::PngPreset(vm["png-compression"].as<std::string>());
+      // A filter named in the config file still overrides the preset.
+      int filter;
+      if (ConfigPngFilter(config_file, filter)) preset.filter = filter;
+      for (RenderParams& params : all_params) params.png_options = preset;
+    }
+
+    if (vm.count("png-filter")) {
+      int filter = io::PngFilterFromName(vm["png-filter"].as<std::string>());
+      for (RenderParams& params : all_params)
+        params.png_options.filter = filter;
+    }
+
+    if (vm.count("layered")) {
+      for (RenderParams& params : all_params) params.is_layered = true;
+    }
+
+    if (vm.count("aux-outputs")) {
+      for (RenderParams& params : all_params) params.has_aux_outputs = true;
+    }
+
+    if (vm.count("backend")) {
+      config::backend = vm["backend"].as<std::string>();
+      if (config::backend != "gl" && config::backend != "cpu")
+        throw std::runtime_error("--backend must be gl or cpu");
+      for (const RenderParams& params : all_params) {
+        if (config::backend == "cpu" && params.has_aux_outputs)
+          throw std::runtime_error("The cpu backend has no aux outputs.");
+      }
+    }
+
+    if (vm.count("profile") || vm.count("trace") || vm.count("gpu-profile")) {
+      profiler::is_enabled = true;
+      profiler::is_gpu_enabled = vm.count("gpu-profile") > 0;
+      if (vm.count("trace"))
+        config::trace_filename = vm["trace"].as<std::string>();
+    }
+
+    if (vm.count("mesh-cache"))
+      config::mesh_cache_dir = vm["mesh-cache"].as<std::string>();
+    if (vm.count("mesh-cache-size")) {
+      config::mesh_cache_max_mb = vm["mesh-cache-size"].as<int64_t>();
+      if (config::mesh_cache_max_mb < 0)
+        throw std::runtime_error("--mesh-cache-size must be at least 0");
+    }
+    config::is_vertex_quantized = vm.count("quantize-vertices") > 0;
+
     if (vm.count("out")) {
       fs::path out_path = vm["out"].as<std::string>();
       for (RenderParams& params : all_params) {
@@ -139,6 +280,13 @@ int InitFromMainArgs(int argc, char* argv[],
       }
     }
 
+    // Off-screen, without per-job files.
+    if (vm.count("npy")) {
+      config::npy_filename = vm["npy"].as<std::string>();
+      for (RenderParams& params : all_params)
+        params.out_filename = config::npy_filename;
+    }
+
   } catch (std::exception& e) {
     std::cerr << "Error: " << e.what() << std::endl << std::endl << desc;
     return -1;
@@ -202,6 +350,23 @@ void InitFromFile(const std::string& filename, RenderParams& params) {
     }
   }
 
+  // area or angle. How faces are weighted in estimated vertex normals.
+  if (config["normal-weighting"].IsDefined()) {
+    auto weighting = config["normal-weighting"].as<std::string>();
+    if (weighting == "area") {
+      params.normal_weighting = librender::NormalWeighting::kArea;
+    } else if (weighting == "angle") {
+      params.normal_weighting = librender::NormalWeighting::kAngle;
+    } else {
+      throw std::runtime_error("normal-weighting must be area or angle");
+    }
+  }
+
+  // Estimated vertex normals are not smoothed across edges where faces meet
+  // at more than this many degrees. 180 for a smooth mesh.
+  if (config["crease-angle"].IsDefined())
+    params.crease_angle = config["crease-angle"].as<float>();
+
   // Up vector tilt angle. 0 points to up-axis.
   if (config["up-angle"].IsDefined()) {
     auto up_angle = config["up-angle"].as<float>();
@@ -310,6 +475,45 @@ void InitFromFile(const std::string& filename, RenderParams& params) {
       params.shader_params.ambient[i] = config["ambient-color"][i].as<float>();
   }
 
+  // List of camera poses [r, el, az] or [r, el, az, up-angle]. One image is
+  // rendered per pose.
+  if (config["views"].IsDefined()) {
+    for (size_t i = 0; i < config["views"].size(); ++i) {
+      auto pose = config["views"][i].as<std::vector<float>>();
+      if (pose.size() < 3)
+        throw std::runtime_error("views: expected [r, el, az, up-angle]");
+      params.views.push_back(
+          {pose[0], pose[1], pose[2], pose.size() > 3 ? pose[3] : 0});
+    }
+  }
+
+  // Every combination of the listed r, el, az and up-angle values. A missing
+  // key defaults to the current camera position.
+  if (config["view-grid"].IsDefined()) {
+    YAML::Node grid = config["view-grid"];
+    auto values = [&grid](const std::string& key, float default_value) {
+      if (!grid[key].IsDefined()) return std::vector<float>{default_value};
+      return grid[key].as<std::vector<float>>();
+    };
+    for (float r : values("r", params.r))
+      for (float el : values("el", params.el))
+        for (float az : values("az", params.az))
+          for (float up_angle : values("up-angle", params.up_angle))
+            params.views.push_back({r, el, az, up_angle});
+  }
+
+  // If true, the views are drawn into layers of one framebuffer, several at a
+  // time, instead of one draw per view.
+  if (config["layered-views"].IsDefined()) {
+    params.is_layered = config["layered-views"].as<bool>();
+  }
+
+  // If true, linear depth, view-space normals and a foreground mask are saved
+  // next to each image as _depth.npy, _normal.png and _mask.png.
+  if (config["aux-outputs"].IsDefined()) {
+    params.has_aux_outputs = config["aux-outputs"].as<bool>();
+  }
+
   // Path to the output directory
   if (config["out-dir"].IsDefined()) {
     // Set output filename. If empty, the GUI viewer will be used.
@@ -322,6 +526,19 @@ void InitFromFile(const std::string& filename, RenderParams& params) {
     params.out_filename = "";
   }
 
+  // Speed and size trade-off of the PNG encoder: store, fast, default or best.
+  if (config["png-compression"].IsDefined()) {
+    params.png_options =
+        io::PngPreset(config["png-compression"].as<std::string>());
+  }
+
+  // Fixed filter for every row, overriding the preset: adaptive, none, sub,
+  // up, average or paeth.
+  if (config["png-filter"].IsDefined()) {
+    params.png_options.filter =
+        io::PngFilterFromName(config["png-filter"].as<std::string>());
+  }
+
   // If false, it will try to resolve filename conflicts with existing files by
   // appending numbers or random string.
   if (config["can-overwrite"].IsDefined()) {
@@ -22,6 +22,7 @@ LineShaderObject::LineShaderObject(const Shape* shape, const GLuint shader_id,
 
   this->shader_id = shader_id;
   this->shape = shape;
+  this->timer_name = "gpu lines";
 
   SetAttributes(render_params, this->attribs);
   FillUniformLocations(shader_id, this->attribs);
@@ -7,23 +7,72 @@
  * license.
  */
 #include "main.h"
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #include <vector>
 #include "config.h"
 #include "mesh_loader.h"
 #include "graphics.h"
 #include "librender.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "render_session.h"
+
+// Stage timings of --profile and --trace, once all jobs are done.
+void ReportProfile() {
+  if (!librender::profiler::is_enabled) return;
+  librender::profiler::PrintStats(std::cout);
+  if (!librender::config::trace_filename.empty())
+    librender::profiler::WriteChromeTrace(librender::config::trace_filename);
+}
 
 int main(int argc, char* argv[]) {
   std::vector<librender::RenderParams> all_params;
   librender::config::InitFromMainArgs(argc, argv, all_params);
 
+  // Without a viewer window, loading, drawing and encoding run concurrently.
+  bool is_offscreen = std::none_of(
+      all_params.begin(), all_params.end(),
+      [](const librender::RenderParams& params) {
+        return params.out_filename.empty();
+      });
+  if (is_offscreen) {
+    int num_jobs = librender::config::num_jobs;
+    if (num_jobs == 0)
+      num_jobs = std::max<int>(std::thread::hardware_concurrency(), 1);
+    librender::PipelineOptions options =
+        librender::DefaultPipelineOptions(num_jobs);
+    options.npy_filename = librender::config::npy_filename;
+    librender::RunPipeline(all_params, options);
+    ReportProfile();
+    return 0;
+  }
+
+  // Off-screen jobs share one context, set of shader programs and
+  // framebuffers.
+  librender::RenderSession* session = nullptr;
+
   for (librender::RenderParams& params : all_params) {
     if (librender::config::is_verbose) {
       std::cout << params.in_filename << std::endl;
     }
+    librender::profiler::SetJob(params.job_index);
     librender::Shape mesh;
     librender::LoadObj(params, mesh);
-    librender::Render(mesh, params);
+
+    if (params.out_filename.empty()) {
+      // The viewer terminates GLFW when its window is closed.
+      delete session;
+      session = nullptr;
+      librender::Render(mesh, params);
+      continue;
+    }
+
+    if (session == nullptr) session = new librender::RenderSession(params);
+    session->Render(mesh, params);
   }
+
+  delete session;
+  ReportProfile();
 }
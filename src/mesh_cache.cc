@@ -0,0 +1,290 @@
+/**
+ * @file mesh_cache.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+namespace librender {
+namespace {
+
+// Changed whenever the layout changes. Older entries are then misses.
+const char kMagic[8] = {'L', 'R', 'M', 'E', 'S', 'H', '0', '2'};
+const char* kExtension = ".mesh";
+// Of each array in the file. Enough for any SIMD load.
+const uint64_t kAlignment = 64;
+const int kNumArrays = 5;
+
+struct ArrayInfo {
+  uint64_t n_rows;
+  uint64_t n_cols;
+  // From the start of the file.
+  uint64_t offset;
+};
+
+// Followed by the key, then by v, vn, vc, uv and ind.
+struct FileHeader {
+  char magic[8];
+  uint32_t index_size;
+  uint32_t type;
+  uint64_t key_size;
+  ArrayInfo arrays[kNumArrays];
+};
+
+uint64_t AlignUp(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// FNV-1a.
+uint64_t HashString(const std::string& str) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : str) {
+    hash ^= (uint8_t)c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/**
+ * @brief Point \a mat at \a n_rows by \a n_cols elements at \a data, which
+ *        must outlive it. Armadillo versions that cannot take over foreign
+ *        memory on a move copy it instead.
+ */
+template <typename T>
+void Attach(const ArrayInfo& info, char* base, arma::Mat<T>& mat) {
+  if (info.n_rows * info.n_cols == 0) {
+    mat.reset();
+    return;
+  }
+  arma::Mat<T> view((T*)(base + info.offset), info.n_rows, info.n_cols,
+                    false, false);
+  mat = std::move(view);
+}
+
+template <typename T>
+ArrayInfo Describe(const arma::Mat<T>& mat, uint64_t& offset) {
+  ArrayInfo info = {mat.n_rows, mat.n_cols, AlignUp(offset)};
+  offset = info.offset + mat.n_elem * sizeof(T);
+  return info;
+}
+
+template <typename T>
+void WriteArray(const ArrayInfo& info, const arma::Mat<T>& mat,
+                std::ofstream& out) {
+  static const char kZeros[kAlignment] = {};
+  out.write(kZeros, info.offset - (uint64_t)out.tellp());
+  out.write((const char*)mat.memptr(), mat.n_elem * sizeof(T));
+}
+}
+
+/**
+ * @param dir Created on the first Save() if it does not exist.
+ * @param max_bytes Total size of the entries that Evict() keeps.
+ */
+MeshCache::MeshCache(const std::string& dir, uint64_t max_bytes)
+    : dir_(dir), max_bytes_(max_bytes) {}
+
+/**
+ * @brief Everything that decides the loaded shape of \a params.
+ * @return Empty if the mesh file cannot be read.
+ */
+std::string MeshCache::Key(const RenderParams& params) {
+  boost::system::error_code error;
+  fs::path path = fs::canonical(params.in_filename, error);
+  struct stat st;
+  if (error || stat(path.string().c_str(), &st) != 0) return "";
+
+  std::ostringstream key;
+  key << std::setprecision(9) << "path=" << path.string()
+      << "\nsize=" << st.st_size << "\nmtime=" << st.st_mtim.tv_sec << "."
+      << std::setw(9) << std::setfill('0') << st.st_mtim.tv_nsec
+      << std::setfill(' ') << "\nwill_normalize=" << params.will_normalize
+      << "\nup_axis=" << params.up_axis
+      << "\nnormal_weighting=" << (int)params.normal_weighting
+      << "\ncrease_angle=" << params.crease_angle << "\ncolor=";
+  for (float c : params.color) key << c << " ";
+  key << "\n";
+  return key.str();
+}
+
+std::string MeshCache::EntryFilename(const std::string& key) const {
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << HashString(key)
+       << kExtension;
+  return (fs::path(dir_) / name.str()).string();
+}
+
+/**
+ * @brief Point \a shape into the cached entry of \a params, if any. Nothing is
+ *        read until used, and the pages are shared with the page cache until
+ *        written to.
+ * @return false on a miss. \a shape is then unchanged.
+ */
+bool MeshCache::Load(const RenderParams& params, Shape& shape) {
+  std::string key = Key(params);
+  if (key.empty()) return false;
+  std::string filename = EntryFilename(key);
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(FileHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void* addr =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return false;
+  std::shared_ptr<void> storage(addr,
+                                [size](void* addr) { munmap(addr, size); });
+
+  char* base = (char*)addr;
+  const FileHeader& header = *(const FileHeader*)base;
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.index_size != sizeof(uint32_t) ||
+      header.key_size != key.size() ||
+      sizeof(FileHeader) + key.size() > size ||
+      key.compare(0, key.size(), base + sizeof(FileHeader), key.size()) != 0)
+    return false;
+  const size_t kElementSizes[kNumArrays] = {
+      sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+      sizeof(uint32_t)};
+  for (int i = 0; i < kNumArrays; ++i) {
+    const ArrayInfo& info = header.arrays[i];
+    if (info.offset % kAlignment != 0 ||
+        info.offset + info.n_rows * info.n_cols * kElementSizes[i] > size)
+      return false;
+  }
+
+  Attach(header.arrays[0], base, shape.v);
+  Attach(header.arrays[1], base, shape.vn);
+  Attach(header.arrays[2], base, shape.vc);
+  Attach(header.arrays[3], base, shape.uv);
+  Attach(header.arrays[4], base, shape.ind);
+  shape.type = (ShapeType)header.type;
+  shape.storage = storage;
+
+  // Most recently used. The access time is often not kept.
+  utimensat(AT_FDCWD, filename.c_str(), nullptr, 0);
+  return true;
+}
+
+/**
+ * @brief Store \a shape as the entry of \a params, then evict. The entry
+ *        appears atomically. Failures are reported on stderr but do not
+ *        throw, since the shape itself is fine.
+ */
+void MeshCache::Save(const RenderParams& params, const Shape& shape) {
+  std::string key = Key(params);
+  if (key.empty()) return;
+  std::string filename = EntryFilename(key);
+
+  static std::atomic<uint64_t> num_saved(0);
+  std::ostringstream temp_filename;
+  temp_filename << filename << ".tmp" << getpid() << "-"
+                << std::hash<std::thread::id>()(std::this_thread::get_id())
+                << "-" << num_saved++;
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.index_size = sizeof(uint32_t);
+  header.type = (uint32_t)shape.type;
+  header.key_size = key.size();
+  uint64_t offset = sizeof(header) + key.size();
+  header.arrays[0] = Describe(shape.v, offset);
+  header.arrays[1] = Describe(shape.vn, offset);
+  header.arrays[2] = Describe(shape.vc, offset);
+  header.arrays[3] = Describe(shape.uv, offset);
+  header.arrays[4] = Describe(shape.ind, offset);
+
+  boost::system::error_code error;
+  fs::create_directories(dir_, error);
+  {
+    std::ofstream out(temp_filename.str(), std::ios::binary);
+    out.write((const char*)&header, sizeof(header));
+    out.write(key.data(), key.size());
+    WriteArray(header.arrays[0], shape.v, out);
+    WriteArray(header.arrays[1], shape.vn, out);
+    WriteArray(header.arrays[2], shape.vc, out);
+    WriteArray(header.arrays[3], shape.uv, out);
+    WriteArray(header.arrays[4], shape.ind, out);
+    out.close();
+    if (!out) {
+      std::cerr << "Unable to write " << temp_filename.str() << std::endl;
+      unlink(temp_filename.str().c_str());
+      return;
+    }
+  }
+  if (rename(temp_filename.str().c_str(), filename.c_str()) != 0) {
+    std::cerr << "Unable to write " << filename << std::endl;
+    unlink(temp_filename.str().c_str());
+    return;
+  }
+
+  Evict();
+}
+
+/**
+ * @brief Remove the least recently used entries until the rest fit in the
+ *        size limit.
+ */
+void MeshCache::Evict() {
+  struct Entry {
+    int64_t mtime_ns;
+    uint64_t size;
+    std::string filename;
+  };
+  std::vector<Entry> entries;
+  uint64_t total_size = 0;
+
+  boost::system::error_code error;
+  for (fs::directory_iterator it(dir_, error), end; !error && it != end;
+       it.increment(error)) {
+    std::string filename = it->path().string();
+    struct stat st;
+    if (it->path().extension() != kExtension ||
+        stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+    entries.push_back({st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec,
+                       (uint64_t)st.st_size, filename});
+    total_size += st.st_size;
+  }
+  if (total_size <= max_bytes_) return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+    return a.mtime_ns < b.mtime_ns;
+  });
+  // Another process may remove them first.
+  for (const Entry& entry : entries) {
+    if (total_size <= max_bytes_) break;
+    unlink(entry.filename.c_str());
+    total_size -= entry.size;
+  }
+}
+}
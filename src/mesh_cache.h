@@ -0,0 +1,45 @@
+/**
+ * @file mesh_cache.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "graphics.h"
+#include "shape.h"
+
+namespace librender {
+
+/**
+ * @brief On-disk cache of loaded shapes, so that a mesh file is only parsed
+ *        again when it or the parameters that affect loading change.
+ *
+ * Each entry is one file holding the arrays of a Shape, aligned so that they
+ * can be used in place: a hit maps the file copy-on-write and points the
+ * shape into it. Entries are keyed by the canonical path, size and
+ * modification time of the mesh file, will_normalize, up_axis and color.
+ * The least recently used entries are removed once the directory grows past
+ * its size limit. Several threads and processes may share a directory.
+ */
+class MeshCache {
+ public:
+  MeshCache(const std::string& dir, uint64_t max_bytes);
+
+  bool Load(const RenderParams& params, Shape& shape);
+  void Save(const RenderParams& params, const Shape& shape);
+  void Evict();
+
+  static std::string Key(const RenderParams& params);
+
+ private:
+  std::string EntryFilename(const std::string& key) const;
+
+  std::string dir_;
+  uint64_t max_bytes_;
+};
+}
@@ -8,121 +8,416 @@
  */
 #include "mesh_loader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <stdint.h>
+#include <utility>
+#include <vector>
 #include <armadillo>
 #include <boost/format.hpp>
 #include "config.h"
 #include "graphics.h"
+#include "mesh_cache.h"
+#include "obj_parser.h"
+#include "parallel.h"
+#include "profiler.h"
 #include "shape.h"
 
 namespace librender {
+namespace {
 
 /**
- * @brief Import shape from a Wavefront .obj file. Vertex normals are estimated
- *        if not provided.
- * @param[in] render_params
- * @param[out] mesh
+ * @brief List the corners 3 * i + k of the faces around each vertex, where
+ *        f(k, i) is the vertex. Those of vertex j are corners[offsets[j]] to
+ *        corners[offsets[j + 1] - 1], in increasing order.
  */
-void LoadObj(const RenderParams& render_params, Shape& mesh) {
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
+void ListVertexCorners(const IndexMat& f, size_t num_vertices, int num_threads,
+                       std::vector<uint32_t>& offsets,
+                       std::vector<uint32_t>& corners) {
+  size_t num_corners = f.n_elem;
+  const uint32_t* ind = f.memptr();
+  if (num_corners > 0 && f.max() >= num_vertices)
+    throw std::runtime_error("Face refers to a missing vertex.");
 
-  std::string err =
-      tinyobj::LoadObj(shapes, materials, render_params.in_filename.c_str());
+  std::unique_ptr<std::atomic<uint32_t>[]> counts(
+      new std::atomic<uint32_t>[num_vertices]);
+  for (size_t i = 0; i < num_vertices; ++i) counts[i].store(0);
+  ParallelFor(num_corners, num_threads, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      counts[ind[c]].fetch_add(1, std::memory_order_relaxed);
+  });
 
-  if (!err.empty()) throw std::runtime_error(err);
-  if (shapes.empty())
-    throw std::runtime_error(std::string("Shape not found in ") +
-                             render_params.in_filename);
+  offsets.resize(num_vertices + 1);
+  offsets[0] = 0;
+  for (size_t i = 0; i < num_vertices; ++i) {
+    offsets[i + 1] = offsets[i] + counts[i].load();
+    counts[i].store(offsets[i]);
+  }
 
-  const int kVertexDims = 3;
-  const int kTextureDims = 2;
+  corners.resize(num_corners);
+  ParallelFor(num_corners, num_threads, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      uint32_t pos = counts[ind[c]].fetch_add(1, std::memory_order_relaxed);
+      corners[pos] = c;
+    }
+  });
+  counts.reset();
+  // In a fixed order, so that the sums are the same from run to run.
+  ParallelFor(num_vertices, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      std::sort(corners.begin() + offsets[i], corners.begin() + offsets[i + 1]);
+  });
+}
+
+/**
+ * @brief Normal of the face of \a corner, weighted for the vertex at the
+ *        corner: by twice the area of the face, or by its angle there.
+ */
+inline glm::vec3 CornerNormal(const fmat& v, const IndexMat& f,
+                              uint32_t corner, NormalWeighting weighting) {
+  const uint32_t* face = f.colptr(corner / 3);
+  int k = corner % 3;
+  const float* p0 = v.colptr(face[k]);
+  const float* p1 = v.colptr(face[(k + 1) % 3]);
+  const float* p2 = v.colptr(face[(k + 2) % 3]);
+  glm::vec3 a(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+  glm::vec3 b(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+  glm::vec3 normal = glm::cross(a, b);
+  if (weighting == NormalWeighting::kAngle) {
+    float length = glm::length(normal);
+    if (length > 0) normal *= std::atan2(length, glm::dot(a, b)) / length;
+  }
+  return normal;
+}
+
+// Unit vector in the direction of \a v, or 0.
+inline glm::vec3 Normalize(const glm::vec3& v) {
+  float length = glm::length(v);
+  return (length > 0) ? v / length : glm::vec3(0);
+}
+
+/**
+ * @brief Point \a mat at \a data, as \a n_rows by data.size() / n_rows. The
+ *        data must outlive it. Armadillo versions that cannot take over
+ *        foreign memory on a move copy it instead.
+ */
+template <typename T>
+void Adopt(std::vector<T>& data, size_t n_rows, arma::Mat<T>& mat) {
+  if (data.empty()) {
+    mat.reset();
+    return;
+  }
+  arma::Mat<T> view(data.data(), n_rows, data.size() / n_rows, false, false);
+  mat = std::move(view);
+}
 
-  for (tinyobj::shape_t shape : shapes) {
-    if (shape.mesh.positions.empty())
-      throw std::runtime_error(std::string("Vertex not found in ") +
-                               render_params.in_filename);
-    if (shape.mesh.indices.empty())
-      throw std::runtime_error(std::string("Face not found in ") +
-                               render_params.in_filename);
-
-    int kNumVertex = shape.mesh.positions.size() / kVertexDims;
-    int kNumFace = shape.mesh.indices.size() / kVertexDims;
-    arma::fmat shape_v(&shape.mesh.positions[0], kVertexDims, kNumVertex);
-    arma::umat shape_f(&shape.mesh.indices[0], kVertexDims, kNumFace);
-    arma::fmat shape_n;
-    arma::fmat shape_uv;
-
-    if (shape.mesh.normals.empty()) {
-      ComputeNormals(shape_v, shape_f, shape_n);
-    } else {
-      shape_n = arma::fmat(&shape.mesh.normals[0], kVertexDims, kNumVertex);
+/**
+ * @brief Center and largest side of the bounding box of the columns of \a v.
+ */
+void BoundingBox(const fmat& v, int num_threads, float center[3],
+                 float& size) {
+  float lo[3], hi[3];
+  std::fill(lo, lo + 3, std::numeric_limits<float>::infinity());
+  std::fill(hi, hi + 3, -std::numeric_limits<float>::infinity());
+  std::mutex mutex;
+  ParallelFor(v.n_cols, num_threads, [&](size_t begin, size_t end) {
+    float part_lo[3], part_hi[3];
+    std::copy(lo, lo + 3, part_lo);
+    std::copy(hi, hi + 3, part_hi);
+    for (size_t i = begin; i < end; ++i) {
+      const float* p = v.colptr(i);
+      for (int k = 0; k < 3; ++k) {
+        part_lo[k] = std::min(part_lo[k], p[k]);
+        part_hi[k] = std::max(part_hi[k], p[k]);
+      }
     }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = std::min(lo[k], part_lo[k]);
+      hi[k] = std::max(hi[k], part_hi[k]);
+    }
+  });
+  size = 0;
+  for (int k = 0; k < 3; ++k) {
+    float range = hi[k] - lo[k];
+    center[k] = lo[k] + range / 2;
+    size = std::max(size, range);
+  }
+}
+
+/**
+ * @brief In one pass over the columns of \a v and \a vn, and in place: center
+ *        and scale v as NormalizeCoords() does if \a will_normalize, scale vn
+ *        to unit length if \a will_normalize_vn, and make \a up_axis their
+ *        z axis.
+ * @param vn[in,out] Empty, or as many columns as \a v.
+ */
+void TransformCoords(bool will_normalize, bool will_normalize_vn,
+                     Axis up_axis, int num_threads, fmat& v, fmat& vn) {
+  if (!will_normalize && !will_normalize_vn && up_axis == Z) return;
+  float center[3] = {0, 0, 0}, size = 1;
+  if (will_normalize) BoundingBox(v, num_threads, center, size);
+  // Rows that become x, y and z.
+  const int kRows[3][3] = {{1, 2, 0}, {2, 0, 1}, {0, 1, 2}};
+  const int* rows = kRows[up_axis];
 
-    if (!shape.mesh.texcoords.empty()) {
-      shape_uv = arma::fmat(&shape.mesh.texcoords[0], kTextureDims, kNumVertex);
-      shape_uv.swap_rows(0, 1);
+  bool has_vn = vn.n_cols == v.n_cols;
+  ParallelFor(v.n_cols, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      float* p = v.colptr(i);
+      float q[3];
+      for (int k = 0; k < 3; ++k) q[k] = (p[rows[k]] - center[rows[k]]) / size;
+      std::copy(q, q + 3, p);
+      if (!has_vn) continue;
+
+      p = vn.colptr(i);
+      float length = 1;
+      if (will_normalize_vn)
+        length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+      // Zero stays zero, as with arma::normalise.
+      if (length == 0) length = 1;
+      for (int k = 0; k < 3; ++k) q[k] = p[rows[k]] / length;
+      std::copy(q, q + 3, p);
     }
+  });
+}
 
-    mesh.v = join_cols(mesh.v, shape_v);
-    mesh.ind = join_cols(mesh.ind, shape_f);
-    mesh.vn = join_cols(mesh.vn, shape_n);
-    mesh.uv = join_cols(mesh.uv, shape_uv);
+/**
+ * @brief Parse and prepare the mesh, without the cache.
+ */
+void ImportObj(const RenderParams& render_params, int num_threads,
+               Shape& mesh) {
+  // Its arrays become those of the shape, which keeps it.
+  std::shared_ptr<ObjMesh> obj = std::make_shared<ObjMesh>();
+  {
+    profiler::ScopedTimer timer("parse");
+    ParseObjFile(render_params.in_filename, num_threads, *obj);
   }
 
-  mesh.vn = arma::normalise(mesh.vn);
+  if (obj->indices.empty())
+    throw std::runtime_error(std::string("Shape not found in ") +
+                             render_params.in_filename);
+
+  const int kVertexDims = 3;
+  const int kTextureDims = 2;
+
+  // Nothing may point into the storage of an earlier shape, e.g. the mapped
+  // cache, once it is replaced.
+  mesh = Shape();
+  size_t num_vertices = obj->positions.size() / kVertexDims;
+  Adopt(obj->positions, kVertexDims, mesh.v);
+  Adopt(obj->indices, kVertexDims, mesh.ind);
 
-  if (render_params.will_normalize) {
-    NormalizeCoords(mesh.v);
+  if (obj->texcoords.size() == kTextureDims * num_vertices) {
+    Adopt(obj->texcoords, kTextureDims, mesh.uv);
+    mesh.uv.swap_rows(0, 1);
+  } else {
+    std::vector<float>().swap(obj->texcoords);
   }
 
-  switch (render_params.up_axis) {
-    case X:
-      mesh.v = arma::join_vert(mesh.v.rows(1, 2), mesh.v.row(0));
-      mesh.vn = arma::join_vert(mesh.vn.rows(1, 2), mesh.vn.row(0));
-      break;
-    case Y:
-      mesh.v = arma::join_vert(mesh.v.row(2), mesh.v.rows(0, 1));
-      mesh.vn = arma::join_vert(mesh.vn.row(2), mesh.vn.rows(0, 1));
-      break;
-    case Z:
-      // Nothing to do
-      break;
+  // Only if every vertex has one.
+  bool has_normals = obj->normals.size() == obj->positions.size();
+  if (has_normals) {
+    Adopt(obj->normals, kVertexDims, mesh.vn);
+  } else {
+    std::vector<float>().swap(obj->normals);
   }
+  mesh.storage = obj;
+
+  if (!has_normals && render_params.crease_angle < 180) {
+    profiler::ScopedTimer timer("normals");
+    ComputeCreasedNormals(render_params.crease_angle * kPi / 180,
+                          render_params.normal_weighting, mesh, num_threads);
+    // The split arrays replace those of the file, unless nothing was split
+    // and they were copied back in place.
+    if (mesh.v.memptr() != obj->positions.data())
+      std::vector<float>().swap(obj->positions);
+    if (mesh.ind.memptr() != obj->indices.data())
+      std::vector<uint32_t>().swap(obj->indices);
+    if (mesh.uv.memptr() != obj->texcoords.data())
+      std::vector<float>().swap(obj->texcoords);
+  } else if (!has_normals) {
+    profiler::ScopedTimer timer("normals");
+    ComputeNormals(mesh.v, mesh.ind, mesh.vn, render_params.normal_weighting,
+                   num_threads);
+  }
+
+  TransformCoords(render_params.will_normalize, has_normals,
+                  render_params.up_axis, num_threads, mesh.v, mesh.vn);
 
   // RGBA color per vertex
-  mesh.vc.reshape(4, mesh.v.n_cols);
+  mesh.vc.set_size(4, mesh.v.n_cols);
   mesh.vc.each_col() = render_params.color;
 
   mesh.type = ShapeType::kTriangles;
 }
+}
+
+/**
+ * @brief Import shape from a Wavefront .obj file. Vertex normals are estimated
+ *        if not provided. The groups of the file are concatenated. Shapes are
+ *        taken from, and added to, config::mesh_cache_dir if set. The parsed
+ *        arrays are kept in the storage of the shape rather than copied.
+ * @param[in] render_params
+ * @param[out] mesh
+ * @param num_threads For parsing and normals. 0 for the number of cores.
+ */
+void LoadObj(const RenderParams& render_params, Shape& mesh,
+             int num_threads) {
+  if (config::mesh_cache_dir.empty()) {
+    ImportObj(render_params, num_threads, mesh);
+    return;
+  }
+
+  MeshCache cache(config::mesh_cache_dir, config::mesh_cache_max_mb << 20);
+  {
+    profiler::ScopedTimer timer("cache");
+    if (cache.Load(render_params, mesh)) return;
+  }
+  ImportObj(render_params, num_threads, mesh);
+  profiler::ScopedTimer timer("cache");
+  cache.Save(render_params, mesh);
+}
 
 /**
- * @brief Compute the face and vertex normals from a triangle mesh of indexed
- *        vertices.
+ * @brief Estimate vertex normals of a triangle mesh of indexed vertices: the
+ *        sum of the normals of the faces around each vertex, weighted by
+ *        \a weighting, normalized. Runs in parallel over vertices, and each
+ *        face normal is computed as it is gathered.
  * @param v[in] 3 by n vertices
  * @param f[in] 3 by m faces
- * @param vn[out] 3 by n vertex normals
+ * @param vn[out] 3 by n unit vertex normals. 0 for vertices without faces.
+ * @param num_threads 0 for the number of cores.
  */
-void ComputeNormals(const arma::fmat& v, const arma::umat& f, arma::fmat& vn) {
-  arma::fmat a = v.cols(f.row(1)) - v.cols(f.row(0));
-  arma::fmat b = v.cols(f.row(2)) - v.cols(f.row(0));
+void ComputeNormals(const arma::fmat& v, const IndexMat& f, arma::fmat& vn,
+                    NormalWeighting weighting, int num_threads) {
+  std::vector<uint32_t> offsets, corners;
+  ListVertexCorners(f, v.n_cols, num_threads, offsets, corners);
+  vn.set_size(3, v.n_cols);
+  ParallelFor(v.n_cols, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      glm::vec3 sum(0);
+      for (uint32_t j = offsets[i]; j < offsets[i + 1]; ++j)
+        sum += CornerNormal(v, f, corners[j], weighting);
+      glm::vec3 normal = Normalize(sum);
+      std::copy(&normal[0], &normal[0] + 3, vn.colptr(i));
+    }
+  });
+}
 
-  // Cross product of each pair of columns
-  arma::fmat fn;
-  CrossCol(a, b, fn);
+/**
+ * @brief Like ComputeNormals(), but the faces around a vertex are split into
+ *        groups at the edges where they meet at more than \a crease_angle,
+ *        and each group gets its own normal. Vertices are split so that each
+ *        of their normals has its own, copying their columns of v, vc and uv.
+ * @param crease_angle In radians.
+ * @param num_threads 0 for the number of cores.
+ */
+void ComputeCreasedNormals(float crease_angle, NormalWeighting weighting,
+                           Shape& mesh, int num_threads) {
+  const fmat& v = mesh.v;
+  const IndexMat& f = mesh.ind;
+  size_t num_vertices = v.n_cols;
+  std::vector<uint32_t> offsets, corners;
+  ListVertexCorners(f, num_vertices, num_threads, offsets, corners);
+  const float min_cos = std::cos(crease_angle);
 
-  // Accumulate vertex normal
-  vn.zeros(v.n_rows, v.n_cols);
-  arma::umat indices = reshape(f.t(), 1, f.n_cols * 3);
-  vn.cols(indices) += arma::repmat(fn, 1, 3);
+  // Group of each corner among those of its vertex, numbered in order of
+  // first corner. Corners of faces that share an edge through the vertex are
+  // joined, unless the faces meet at a crease. Degenerate faces join all
+  // their neighbors.
+  std::vector<uint32_t> groups(corners.size());
+  // First new vertex of each vertex.
+  std::vector<uint32_t> bases(num_vertices + 1);
+  ParallelFor(num_vertices, num_threads, [&](size_t begin, size_t end) {
+    std::vector<glm::vec3> directions;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<uint32_t> parents;
+    auto find = [&](uint32_t j) {
+      while (parents[j] != j) j = parents[j] = parents[parents[j]];
+      return j;
+    };
+    for (size_t i = begin; i < end; ++i) {
+      uint32_t first = offsets[i], count = offsets[i + 1] - first;
+      directions.resize(count);
+      edges.resize(2 * count);
+      parents.resize(count);
+      for (uint32_t j = 0; j < count; ++j) {
+        uint32_t corner = corners[first + j];
+        const uint32_t* face = f.colptr(corner / 3);
+        directions[j] = Normalize(CornerNormal(v, f, corner, weighting));
+        // The other ends of the two edges of the face through the vertex.
+        edges[2 * j] = {face[(corner + 1) % 3], j};
+        edges[2 * j + 1] = {face[(corner + 2) % 3], j};
+        parents[j] = j;
+      }
+      std::sort(edges.begin(), edges.end());
+      for (uint32_t e = 1; e < edges.size(); ++e) {
+        if (edges[e].first != edges[e - 1].first) continue;
+        const glm::vec3& a = directions[edges[e - 1].second];
+        const glm::vec3& b = directions[edges[e].second];
+        if (glm::dot(a, b) < min_cos && a != glm::vec3(0) &&
+            b != glm::vec3(0))
+          continue;
+        uint32_t root_a = find(edges[e - 1].second);
+        uint32_t root_b = find(edges[e].second);
+        // The first corner of a group is its root.
+        parents[std::max(root_a, root_b)] = std::min(root_a, root_b);
+      }
+      uint32_t num_groups = 0;
+      for (uint32_t j = 0; j < count; ++j) {
+        uint32_t root = find(j);
+        groups[first + j] = (root == j) ? num_groups++ : groups[first + root];
+      }
+      // Vertices without faces are kept.
+      bases[i + 1] = std::max<uint32_t>(num_groups, 1);
+    }
+  });
+  bases[0] = 0;
+  for (size_t i = 0; i < num_vertices; ++i) bases[i + 1] += bases[i];
 
-  arma::fmat num_adj_f;
-  num_adj_f.zeros(1, v.n_cols);
-  num_adj_f(indices) += 1;
+  size_t num_new_vertices = bases[num_vertices];
+  fmat* attributes[] = {&mesh.v, &mesh.vc, &mesh.uv};
+  fmat new_attributes[3];
+  for (int a = 0; a < 3; ++a) {
+    if (attributes[a]->n_cols == num_vertices)
+      new_attributes[a].set_size(attributes[a]->n_rows, num_new_vertices);
+  }
+  IndexMat new_ind(f.n_rows, f.n_cols);
+  fmat vn(3, num_new_vertices);
+  ParallelFor(num_vertices, num_threads, [&](size_t begin, size_t end) {
+    std::vector<glm::vec3> sums;
+    for (size_t i = begin; i < end; ++i) {
+      uint32_t base = bases[i];
+      sums.assign(bases[i + 1] - base, glm::vec3(0));
+      for (uint32_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+        sums[groups[j]] += CornerNormal(v, f, corners[j], weighting);
+        new_ind[corners[j]] = base + groups[j];
+      }
+      for (uint32_t j = base; j < bases[i + 1]; ++j) {
+        for (int a = 0; a < 3; ++a) {
+          const fmat& attribute = *attributes[a];
+          if (new_attributes[a].n_cols == 0) continue;
+          std::copy(attribute.colptr(i), attribute.colptr(i) + attribute.n_rows,
+                    new_attributes[a].colptr(j));
+        }
+        glm::vec3 normal = Normalize(sums[j - base]);
+        std::copy(&normal[0], &normal[0] + 3, vn.colptr(j));
+      }
+    }
+  });
 
-  // Divide by the number of adjacent faces
-  vn /= arma::repmat(num_adj_f, 3, 1);
+  for (int a = 0; a < 3; ++a) {
+    if (new_attributes[a].n_cols > 0)
+      *attributes[a] = std::move(new_attributes[a]);
+  }
+  mesh.ind = std::move(new_ind);
+  mesh.vn = std::move(vn);
 }
 
 /**
@@ -142,12 +437,7 @@ void CrossCol(const arma::fmat& a, const arma::fmat& b, arma::fmat& out) {
  * @param v 3 by n matrix of vertices.
  */
 void NormalizeCoords(arma::fmat& v) {
-  arma::fvec vmax = arma::max(v, 1);
-  arma::fvec vmin = arma::min(v, 1);
-
-  arma::fvec range = vmax - vmin;
-
-  v.each_col() -= vmin + range / 2;
-  v /= arma::max(range);
+  fmat vn;
+  TransformCoords(true, false, Z, 0, v, vn);
 }
 }
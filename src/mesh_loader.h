@@ -15,8 +15,13 @@
 
 namespace librender {
 
-void LoadObj(const RenderParams& render_params, Shape& mesh);
-void ComputeNormals(const arma::fmat& v, const arma::umat& f, arma::fmat& vn);
+void LoadObj(const RenderParams& render_params, Shape& mesh,
+             int num_threads = 0);
+void ComputeNormals(const arma::fmat& v, const IndexMat& f, arma::fmat& vn,
+                    NormalWeighting weighting = NormalWeighting::kArea,
+                    int num_threads = 0);
+void ComputeCreasedNormals(float crease_angle, NormalWeighting weighting,
+                           Shape& mesh, int num_threads = 0);
 void NormalizeCoords(arma::fmat& v);
 void CrossCol(const arma::fmat& a, const arma::fmat& b, arma::fmat& c);
 }
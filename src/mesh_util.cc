@@ -0,0 +1,534 @@
+/**
+ * @file mesh_util.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2015-01-10
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "mesh_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <igl/slice.h>
+#include "bvh.h"
+#include "debug.h"
+#include "parallel.h"
+
+namespace librender {
+namespace util {
+
+namespace {
+
+/**
+ * @brief 1 if the half-edges \a h and \a twin of \a face run in the same
+ *        direction, so that one of their faces must be flipped.
+ */
+int IsFlippedTwin(const Ref<const MatrixX3i>& face, int h, int twin) {
+  return face(h / 3, h % 3) == face(twin / 3, twin % 3);
+}
+
+/**
+ * @brief Union-find over faces in which each face also knows whether its
+ *        orientation is opposite to that of its parent.
+ */
+class ParityUnionFind {
+ public:
+  explicit ParityUnionFind(size_t n) : parent_(n), parity_(n, 0), size_(n, 1) {
+    std::iota(parent_.begin(), parent_.end(), 0);
+  }
+
+  /**
+   * @return Root of \a x, and in \a parity whether \a x is opposite to it.
+   *         Does not modify the tree, so that it can run in parallel.
+   */
+  int Find(int x, int& parity) const {
+    parity = 0;
+    for (; parent_[x] != x; x = parent_[x]) parity ^= parity_[x];
+    return x;
+  }
+
+  /**
+   * @brief Record that \a a and \a b are opposite if \a parity is 1.
+   * @return false if that contradicts the relations so far, as it does
+   *         around a Moebius strip. The relation is then ignored.
+   */
+  bool Union(int a, int b, int parity) {
+    int parity_a, parity_b;
+    int root_a = Compress(a, parity_a), root_b = Compress(b, parity_b);
+    if (root_a == root_b) return (parity_a ^ parity_b) == parity;
+    if (size_[root_a] < size_[root_b]) std::swap(root_a, root_b);
+    parent_[root_b] = root_a;
+    parity_[root_b] = parity_a ^ parity_b ^ parity;
+    size_[root_a] += size_[root_b];
+    return true;
+  }
+
+ private:
+  int Compress(int x, int& parity) {
+    int root = Find(x, parity);
+    // Point the path straight at the root.
+    for (int path_parity = parity; x != root;) {
+      int next = parent_[x], next_parity = path_parity ^ parity_[x];
+      parent_[x] = root;
+      parity_[x] = path_parity;
+      x = next;
+      path_parity = next_parity;
+    }
+    return root;
+  }
+
+  vector<int> parent_;
+  vector<uint8_t> parity_;
+  vector<int> size_;
+};
+}
+
+void ComputeNormals(const MatrixX3i& face, const MatrixX3d& vertex,
+                    Ref<MatrixX3d> normal) {
+  const Vector3i xyz_ind(0, 1, 2);
+  MatrixX3d v0;
+  igl::slice(vertex, face.col(0), xyz_ind, v0);
+
+  MatrixX3d v1;
+  igl::slice(vertex, face.col(1), xyz_ind, v1);
+
+  MatrixX3d v2;
+  igl::slice(vertex, face.col(2), xyz_ind, v2);
+
+  const MatrixX3d u = v1 - v0;
+  const MatrixX3d v = v2 - v0;
+
+  Matrix<double, Dynamic, 3> n(u.rows(), 3);
+  RowwiseCross(u, v, n);
+}
+
+/**
+ * @brief Orient the faces of each connected component consistently, facing
+ *        the side that FindOneFaceNormal() finds to be outside.
+ *
+ * Whether each face must be flipped relative to the others of its component
+ * is resolved by a union-find with parity over the manifold edges, first
+ * within parts of the face array in parallel, then across parts. The
+ * components are then oriented in parallel.
+ *
+ * @param num_threads 0 for the number of cores.
+ */
+void ReorientMeshNormals(const Ref<const MatrixX3i>& face,
+                         const Ref<const MatrixX3d>& vertex,
+                         Ref<MatrixX3i> face_out, int num_threads) {
+  face_out = face;
+  size_t numf = face.rows();
+  Connectivity conn;
+  ComputeConnectivity(face, vertex.rows(), conn, num_threads);
+
+  ParityUnionFind orientation(numf);
+  auto unite = [&](size_t begin, size_t end, bool is_within) {
+    for (size_t i = begin; i < end; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        int h = 3 * i + k, twin = conn.twins[h];
+        if (twin < 0) continue;
+        size_t g = twin / 3;
+        if (g <= i || (g < end) != is_within) continue;
+        orientation.Union(i, g, IsFlippedTwin(face, h, twin));
+      }
+    }
+  };
+  ParallelFor(numf, num_threads, [&](size_t begin, size_t end) {
+    unite(begin, end, true);
+  });
+  vector<size_t> bounds = SplitRange(numf, num_threads);
+  for (size_t i = 0; i + 1 < bounds.size(); ++i)
+    unite(bounds[i], bounds[i + 1], false);
+
+  vector<int> roots(numf);
+  vector<uint8_t> parities(numf);
+  ParallelFor(numf, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      int parity;
+      roots[i] = orientation.Find(i, parity);
+      parities[i] = parity;
+    }
+  });
+
+  // Numbered in order of their first face.
+  vector<int> component_of_root(numf, -1);
+  vector<vector<int>> components;
+  for (size_t i = 0; i < numf; ++i) {
+    int& component = component_of_root[roots[i]];
+    if (component < 0) {
+      component = components.size();
+      components.emplace_back();
+    }
+    components[component].push_back(i);
+  }
+
+  // Largest first, so that no thread is left with one at the end.
+  vector<int> order(components.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return components[a].size() > components[b].size();
+  });
+  // Whether faces of parity 0 are flipped. -1 to leave the component as is.
+  vector<int8_t> component_flips(components.size(), -1);
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t num_workers =
+      std::max<size_t>(1, std::min<size_t>(num_threads, components.size()));
+  // The budget is split among the workers, so that one large component still
+  // builds its tree in parallel, but many never run cores^2 threads.
+  int threads_per_worker = std::max<int>(1, num_threads / num_workers);
+  // Copied once rather than for each call.
+  const MatrixX3d vertices = vertex;
+  std::atomic<size_t> next_component(0);
+  auto orient_components = [&]() {
+    size_t c;
+    while ((c = next_component++) < order.size()) {
+      const vector<int>& flist = components[order[c]];
+      MatrixX3i comp_inds(flist.size(), 3);
+      for (size_t i = 0; i < flist.size(); ++i)
+        comp_inds.row(i) = face.row(flist[i]);
+
+      int comp_f_ind;
+      RowVector3d normal;
+      Matrix<double, 1, 6> line;
+      FindOneFaceNormal(vertices, comp_inds, comp_f_ind, normal, line, 0,
+                        threads_per_worker);
+      if (comp_f_ind < 0) continue;
+
+      int f_ind = flist[comp_f_ind];
+      auto f = face.row(f_ind);
+      RowVector3d u = vertex.row(f(1)) - vertex.row(f(0));
+      RowVector3d v = vertex.row(f(2)) - vertex.row(f(0));
+      int is_seed_flipped = u.cross(v).dot(normal) < 0;
+      component_flips[order[c]] = is_seed_flipped ^ parities[f_ind];
+    }
+  };
+  vector<std::thread> threads;
+  for (size_t i = 1; i < num_workers; ++i)
+    threads.emplace_back(orient_components);
+  orient_components();
+  for (std::thread& thread : threads) thread.join();
+
+  ParallelFor(numf, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      int flip = component_flips[component_of_root[roots[i]]];
+      if (flip >= 0 && (flip ^ parities[i]))
+        FlipTriangleOrientation(face_out, i);
+    }
+  });
+}
+
+/**
+ * @brief Orient the faces reachable from face \a f_ind like it, breadth
+ *        first.
+ * @param[in,out] visited Faces that are already oriented. They are neither
+ *                        changed nor crossed.
+ */
+void UnifyNeighborNormals(const Connectivity& conn, Ref<MatrixX3i> f,
+                          int f_ind, vector<bool>& visited) {
+  std::queue<int> frontier;
+  visited[f_ind] = true;
+  frontier.push(f_ind);
+  while (!frontier.empty()) {
+    int curr = frontier.front();
+    frontier.pop();
+    RowVector3i curr_f = f.row(curr);
+    int neighbors[3];
+    int num_neighbors = conn.Neighbors(curr, neighbors);
+    for (int i = 0; i < num_neighbors; ++i) {
+      int neigh_ind = neighbors[i];
+      if (visited[neigh_ind]) continue;
+      visited[neigh_ind] = true;
+      FixNeighborNormal(curr_f, f, neigh_ind);
+      frontier.push(neigh_ind);
+    }
+  }
+}
+
+/**
+ * @brief Flip face \a neigh_ind if it runs along its shared edge with
+ *        \a curr_f in the same direction.
+ */
+void FixNeighborNormal(const Ref<const RowVector3i>& curr_f, Ref<MatrixX3i> f,
+                       int neigh_ind) {
+  RowVector3i neigh_f = f.row(neigh_ind);
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      if (curr_f(i) == neigh_f(j) &&
+          curr_f((i + 1) % 3) == neigh_f((j + 1) % 3)) {
+        FlipTriangleOrientation(f, neigh_ind);
+        return;
+      }
+    }
+  }
+}
+
+void FlipTriangleOrientation(Ref<MatrixX3i> f, int f_ind) {
+  std::swap(f(f_ind, 0), f(f_ind, 1));
+}
+
+/**
+ * @brief Build the connectivity of \a face in parallel. Vertex to face lists
+ *        are filled by counting sort, and twins are found by scanning the
+ *        faces around the start of each half-edge.
+ * @param numv Number of vertices.
+ * @param num_threads 0 for the number of cores.
+ */
+void ComputeConnectivity(const MatrixX3i& face, size_t numv,
+                         Connectivity& conn, int num_threads) {
+  size_t numf = face.rows();
+  if (numf > 0 && (face.minCoeff() < 0 || (size_t)face.maxCoeff() >= numv))
+    throw std::runtime_error("Face refers to a missing vertex.");
+
+  std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[numv]);
+  for (size_t v = 0; v < numv; ++v) counts[v].store(0);
+  ParallelFor(numf, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      for (int k = 0; k < 3; ++k)
+        counts[face(i, k)].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  conn.vertex_offsets.resize(numv + 1);
+  conn.vertex_offsets[0] = 0;
+  for (size_t v = 0; v < numv; ++v) {
+    conn.vertex_offsets[v + 1] = conn.vertex_offsets[v] + counts[v].load();
+    counts[v].store(conn.vertex_offsets[v]);
+  }
+
+  conn.vertex_faces.resize(3 * numf);
+  ParallelFor(numf, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        int pos = counts[face(i, k)].fetch_add(1, std::memory_order_relaxed);
+        conn.vertex_faces[pos] = i;
+      }
+    }
+  });
+  counts.reset();
+  ParallelFor(numv, num_threads, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      std::sort(conn.vertex_faces.begin() + conn.vertex_offsets[v],
+                conn.vertex_faces.begin() + conn.vertex_offsets[v + 1]);
+    }
+  });
+
+  conn.twins.assign(3 * numf, -1);
+  conn.is_non_manifold.assign(3 * numf, 0);
+  ParallelFor(numf, num_threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        int a = face(i, k), b = face(i, (k + 1) % 3);
+        if (a == b) continue;
+        int twin = -1, num_others = 0;
+        for (int j = conn.vertex_offsets[a]; j < conn.vertex_offsets[a + 1];
+             ++j) {
+          int g = conn.vertex_faces[j];
+          // Listed twice if the face is degenerate.
+          if (g == (int)i ||
+              (j > conn.vertex_offsets[a] && g == conn.vertex_faces[j - 1]))
+            continue;
+          for (int l = 0; l < 3; ++l) {
+            int c = face(g, l), d = face(g, (l + 1) % 3);
+            if ((c == a && d == b) || (c == b && d == a)) {
+              twin = 3 * g + l;
+              ++num_others;
+              break;
+            }
+          }
+        }
+        if (num_others == 1) {
+          conn.twins[3 * i + k] = twin;
+        } else if (num_others > 1) {
+          conn.is_non_manifold[3 * i + k] = 1;
+        }
+      }
+    }
+  });
+}
+
+/**
+ * @brief Faces that share an edge with face \a f, in increasing order.
+ * @param[out] neighbors At least 3 elements.
+ * @return Number of neighbors.
+ */
+int Connectivity::Neighbors(int f, int* neighbors) const {
+  int count = 0;
+  for (int k = 0; k < 3; ++k) {
+    int twin = twins[3 * f + k];
+    if (twin < 0) continue;
+    int g = twin / 3;
+    if (std::find(neighbors, neighbors + count, g) == neighbors + count)
+      neighbors[count++] = g;
+  }
+  std::sort(neighbors, neighbors + count);
+  return count;
+}
+
+/**
+ * @brief Group the faces that are connected through manifold edges.
+ * @param[out] result Faces of each component, in breadth-first order.
+ */
+void FindConnectedComponents(const Connectivity& conn,
+                             vector<vector<int>>& result) {
+  size_t numf = conn.NumFaces();
+
+  std::queue<int> q;
+  vector<int> mark(numf, -1);
+
+  int comp_count = 0;
+  for (size_t i = 0; i < numf; ++i) {
+    if (mark[i] >= 0) continue;
+    result.push_back(vector<int>());
+    mark[i] = comp_count;
+    q.push(i);
+    while (!q.empty()) {
+      const int fi = q.front();
+      q.pop();
+      result[comp_count].push_back(fi);
+
+      int neighbors[3];
+      int num_neighbors = conn.Neighbors(fi, neighbors);
+      for (int j = 0; j < num_neighbors; ++j) {
+        if (mark[neighbors[j]] >= 0) continue;
+        mark[neighbors[j]] = comp_count;
+        q.push(neighbors[j]);
+      }
+    }
+    comp_count++;
+  }
+}
+
+//#include "../matlab/mexutil.h"
+// using namespace mexutil;
+
+void RowwiseCross(const MatrixX3d& u, const MatrixX3d& v, MatrixX3d& uxv) {
+  uxv << (u.col(1).array() * v.col(2).array() -
+          u.col(2).array() * v.col(1).array()),
+      (u.col(2).array() * v.col(0).array() -
+       u.col(0).array() * v.col(2).array()),
+      (u.col(0).array() * v.col(1).array() -
+       u.col(1).array() * v.col(0).array());
+}
+
+/**
+ * @brief Find a face on the outside of the closed mesh \a face, and its
+ *        outward normal. Lines are cast until one crosses the mesh an even,
+ *        nonzero number of times. Its last crossing is then on the outside,
+ *        facing along the line.
+ * @param[out] face_index -1 if there is none, as when the mesh has fewer than
+ *             two faces.
+ * @param[out] line Two points on the line that found it.
+ * @param seed Of the random lines, which are the same for the same seed.
+ * @param num_threads For building the tree. 0 for the number of cores.
+ */
+void FindOneFaceNormal(const MatrixX3d& vertex, const MatrixX3i& face,
+                       int& face_index, RowVector3d& normal,
+                       Matrix<double, 1, 6>& line, uint32_t seed,
+                       int num_threads) {
+  face_index = -1;
+  normal << 0, 0, 0;
+  if (face.rows() < 2) return;
+
+  size_t numf = face.rows();
+  vector<float> triangles(9 * numf);
+  RowVector3d center = RowVector3d::Zero();
+  RowVector3d mincoord = vertex.row(face(0, 0)), maxcoord = mincoord;
+  for (size_t i = 0; i < numf; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      auto corner = vertex.row(face(i, j));
+      for (int k = 0; k < 3; ++k) triangles[9 * i + 3 * j + k] = corner(k);
+      center += corner;
+      mincoord = mincoord.cwiseMin(corner);
+      maxcoord = maxcoord.cwiseMax(corner);
+    }
+  }
+  center /= 3 * numf;
+  const RowVector3d range = maxcoord - mincoord;
+
+  // Building the tree costs about as much as a few dozen casts through every
+  // face, and the first lines usually succeed.
+  const int kNumCastsWithoutTree = 3;
+  int num_casts = 0;
+  Bvh bvh;
+  vector<Bvh::Hit> hits;
+  // Whether the line through p0 and p1 finds the face.
+  auto cast = [&](const RowVector3d& p0, const RowVector3d& p1) {
+    float origin[3], direction[3];
+    for (int k = 0; k < 3; ++k) {
+      origin[k] = p0(k);
+      direction[k] = p1(k) - p0(k);
+    }
+    const float kInfinity = std::numeric_limits<float>::infinity();
+    if (num_casts++ < kNumCastsWithoutTree) {
+      Bvh::IntersectEach(triangles.data(), numf, origin, direction,
+                         -kInfinity, kInfinity, hits);
+    } else {
+      if (bvh.NumTriangles() == 0)
+        bvh.Build(triangles.data(), numf, num_threads);
+      bvh.Intersect(origin, direction, -kInfinity, kInfinity, hits);
+    }
+    if (hits.empty() || hits.size() % 2 != 0) return false;
+
+    face_index = std::max_element(hits.begin(), hits.end(),
+                                  [](const Bvh::Hit& a, const Bvh::Hit& b) {
+                                    return a.t < b.t;
+                                  })->triangle;
+    auto f = face.row(face_index);
+    RowVector3d u = vertex.row(f(1)) - vertex.row(f(0));
+    RowVector3d v = vertex.row(f(2)) - vertex.row(f(0));
+    normal = u.cross(v).normalized();
+    if (normal.dot(p1 - p0) < 0) normal *= -1;
+    line << p0, p1;
+    return true;
+  };
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(-1, 1);
+  auto random_vector = [&](double scale) {
+    RowVector3d r;
+    for (int k = 0; k < 3; ++k) r(k) = uniform(rng) * scale;
+    return r;
+  };
+  const RowVector3d units[] = {RowVector3d::UnitX(), RowVector3d::UnitY(),
+                               RowVector3d::UnitZ()};
+
+  // Along the axes through the center, then through random points in the
+  // middle of the bounding box.
+  if (cast(center, center + units[0])) return;
+  for (int k = 1; k < 3; ++k) {
+    if (cast(center, center + units[k] + random_vector(1 / 15.0))) return;
+  }
+  for (int i = 0; i < 7; ++i) {
+    RowVector3d p0 =
+        mincoord + (random_vector(0.25).array() + 0.5).matrix().cwiseProduct(
+                       range);
+    for (int k = 0; k < 3; ++k) {
+      if (cast(p0, p0 + units[k] + random_vector(1 / (15.0 - i)))) return;
+    }
+  }
+
+  // Through the centers of random pairs of faces.
+  vector<int> order(numf);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), rng);
+  auto face_center = [&](int i) {
+    return RowVector3d((vertex.row(face(i, 0)) + vertex.row(face(i, 1)) +
+                        vertex.row(face(i, 2))) /
+                       3);
+  };
+  for (size_t i = 0; i + 1 < numf; i += 2) {
+    if (cast(face_center(order[i]), face_center(order[i + 1]))) return;
+  }
+}
+}
+}
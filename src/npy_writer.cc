@@ -0,0 +1,170 @@
+/**
+ * @file npy_writer.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "npy_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "profiler.h"
+
+namespace librender {
+namespace io {
+
+/**
+ * @brief Create (or truncate) \a filename and map it for writing. Slots that
+ *        are never written stay zero.
+ * @param filename Usually ends with .npy.
+ * @param num_frames,height,width,channels Shape of the array.
+ * @param type Element type.
+ */
+NpyWriter::NpyWriter(const std::string& filename, size_t num_frames,
+                     int height, int width, int channels, NpyType type)
+    : num_frames_(num_frames),
+      height_(height),
+      width_(width),
+      channels_(channels),
+      type_(type) {
+  if (num_frames == 0 || height <= 0 || width <= 0 || channels <= 0)
+    throw std::runtime_error("Invalid .npy array shape.");
+
+  std::string header = NpyHeader(
+      {num_frames, (size_t)height, (size_t)width, (size_t)channels}, type);
+  header_size_ = header.size();
+  file_size_ = header_size_ + num_frames_ * FrameSize();
+
+  fd_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0)
+    throw std::runtime_error("Unable to open " + filename + ": " +
+                             strerror(errno));
+
+  if (ftruncate(fd_, file_size_) != 0 ||
+      pwrite(fd_, header.data(), header.size(), 0) != (ssize_t)header.size()) {
+    std::string error = strerror(errno);
+    close(fd_);
+    throw std::runtime_error("Unable to write " + filename + ": " + error);
+  }
+
+  void* data =
+      mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    std::string error = strerror(errno);
+    close(fd_);
+    throw std::runtime_error("Unable to map " + filename + ": " + error);
+  }
+  data_ = (uint8_t*)data;
+}
+
+/**
+ * @brief Unmap and close the file. The kernel writes back dirty pages.
+ */
+NpyWriter::~NpyWriter() {
+  if (data_ != nullptr) munmap(data_, file_size_);
+  if (fd_ >= 0) close(fd_);
+}
+
+/**
+ * @brief Copy one frame into its slot.
+ * @param slot Index into the first dimension of the array.
+ * @param pixels FrameSize() bytes, row by row from the top left corner.
+ */
+void NpyWriter::Write(size_t slot, const void* pixels) {
+  memcpy(Slot(slot), pixels, FrameSize());
+}
+
+/**
+ * @brief Mapped memory of one frame, for writing into it in place.
+ * @param slot Index into the first dimension of the array.
+ * @return FrameSize() bytes.
+ */
+void* NpyWriter::Slot(size_t slot) {
+  if (slot >= num_frames_)
+    throw std::runtime_error(".npy slot " + std::to_string(slot) +
+                             " out of range.");
+  return data_ + header_size_ + slot * FrameSize();
+}
+
+/**
+ * @brief Bytes per frame.
+ */
+size_t NpyWriter::FrameSize() const {
+  return (size_t)height_ * width_ * channels_ * NpyTypeSize(type_);
+}
+
+/**
+ * @brief Version 1.0 .npy header for a C-ordered array, padded so that the
+ *        data starts at a multiple of 64 bytes.
+ * @param shape
+ * @param type Stored little-endian.
+ * @return Magic string, version, header length and the header itself.
+ */
+std::string NpyHeader(const std::vector<size_t>& shape, NpyType type) {
+  static const char* kDescrs[] = {"|u1", "<u2", "<f4"};
+  std::stringstream dict;
+  dict << "{'descr': '" << kDescrs[(int)type]
+       << "', 'fortran_order': False, 'shape': (";
+  for (size_t i = 0; i < shape.size(); ++i)
+    dict << (i > 0 ? ", " : "") << shape[i];
+  // (n,) is a tuple, (n) is not.
+  dict << (shape.size() == 1 ? ",), }" : "), }");
+
+  const size_t kPreambleSize = 10;
+  std::string header = dict.str();
+  size_t padded_size = kPreambleSize + header.size() + 1;
+  padded_size = (padded_size + 63) / 64 * 64;
+  header.append(padded_size - kPreambleSize - header.size() - 1, ' ');
+  header += '\n';
+
+  std::string preamble = "\x93NUMPY";
+  preamble += (char)1;
+  preamble += (char)0;
+  preamble += (char)(header.size() & 0xff);
+  preamble += (char)(header.size() >> 8);
+  return preamble + header;
+}
+
+/**
+ * @brief Bytes per element.
+ */
+size_t NpyTypeSize(NpyType type) {
+  switch (type) {
+    case NpyType::kUint8:
+      return 1;
+    case NpyType::kUint16:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+/**
+ * @brief Write a single array to a .npy file.
+ * @param filename
+ * @param data Elements in C order, in native (little-endian) byte order.
+ * @param shape
+ * @param type
+ */
+void SaveAsNpy(const std::string& filename, const void* data,
+               const std::vector<size_t>& shape, NpyType type) {
+  size_t size = NpyTypeSize(type);
+  for (size_t dim : shape) size *= dim;
+
+  profiler::ScopedTimer timer("write");
+  std::string header = NpyHeader(shape, type);
+  std::ofstream file(filename, std::ios::binary);
+  file.write(header.data(), header.size());
+  file.write((const char*)data, size);
+  if (!file) throw std::runtime_error("Unable to write " + filename);
+}
+}
+}
@@ -0,0 +1,53 @@
+/**
+ * @file npy_writer.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace librender {
+namespace io {
+
+enum class NpyType { kUint8, kUint16, kFloat32 };
+
+/**
+ * @brief Writes a batch of images into one array of shape
+ *        (num_frames, height, width, channels), saved as a NumPy .npy file.
+ *        The file is preallocated and memory-mapped, so frames can be written
+ *        in any order and from any thread as long as their slots differ.
+ */
+class NpyWriter {
+ public:
+  NpyWriter(const std::string& filename, size_t num_frames, int height,
+            int width, int channels = 4, NpyType type = NpyType::kUint8);
+  ~NpyWriter();
+
+  void Write(size_t slot, const void* pixels);
+  void* Slot(size_t slot);
+  size_t FrameSize() const;
+  size_t num_frames() const { return num_frames_; }
+
+ private:
+  size_t num_frames_;
+  int height_, width_, channels_;
+  NpyType type_;
+  size_t header_size_;
+  int fd_ = -1;
+  uint8_t* data_ = nullptr;
+  size_t file_size_ = 0;
+};
+
+std::string NpyHeader(const std::vector<size_t>& shape,
+                      NpyType type = NpyType::kUint8);
+size_t NpyTypeSize(NpyType type);
+void SaveAsNpy(const std::string& filename, const void* data,
+               const std::vector<size_t>& shape, NpyType type);
+}
+}
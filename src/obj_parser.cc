@@ -0,0 +1,560 @@
+/**
+ * @file obj_parser.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "obj_parser.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdint.h>
+#include <fcntl.h>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace librender {
+namespace {
+
+// Below this, another thread costs more than it saves.
+const size_t kMinBytesPerThread = 1 << 20;
+
+// Powers of ten that are exact in a double.
+const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+enum class LineType { kOther, kVertex, kNormal, kTexcoord, kFace, kGroup };
+
+// One corner of a face. Zero-based indices, or negative if absent.
+struct Corner {
+  int v, vt, vn;
+};
+
+/**
+ * @brief A range of whole lines, parsed by one thread.
+ */
+struct Chunk {
+  const char* begin;
+  const char* end;
+
+  // Number of "v", "vn", "vt" lines before this chunk, and then up to the
+  // end of it.
+  size_t num_v = 0;
+  size_t num_vn = 0;
+  size_t num_vt = 0;
+  size_t num_faces = 0;
+  size_t num_triangles = 0;
+
+  std::vector<Corner> corners;
+  // Number of corners of each face, in order. 0 marks the start of a group.
+  std::vector<uint32_t> face_sizes;
+};
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+// Characters that end a number, as in tinyobj.
+inline bool IsDelimiter(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * @brief Call f(type, p, end) for each line in [begin, end), where [p, end)
+ *        is the line without leading whitespace and line break.
+ */
+template <typename F>
+void ForEachLine(const char* begin, const char* end, F f) {
+  while (begin < end) {
+    const char* eol = (const char*)memchr(begin, '\n', end - begin);
+    if (eol == nullptr) eol = end;
+    const char* line_end = eol;
+    if (line_end > begin && line_end[-1] == '\r') --line_end;
+
+    const char* p = begin;
+    while (p < line_end && IsSpace(*p)) ++p;
+    size_t length = line_end - p;
+    LineType type = LineType::kOther;
+    if (length >= 2 && IsSpace(p[1])) {
+      if (p[0] == 'v') type = LineType::kVertex;
+      if (p[0] == 'f') type = LineType::kFace;
+      if (p[0] == 'g' || p[0] == 'o') type = LineType::kGroup;
+    } else if (length >= 3 && p[0] == 'v' && IsSpace(p[2])) {
+      if (p[1] == 'n') type = LineType::kNormal;
+      if (p[1] == 't') type = LineType::kTexcoord;
+    }
+    f(type, p, line_end);
+    begin = eol + 1;
+  }
+}
+
+/**
+ * @brief atoi() of the rest of a face index, saturated far beyond the range of
+ *        int so that too many digits make an index that is out of range. Skip
+ *        to the next '/' or delimiter.
+ */
+inline int64_t ParseIndex(const char*& p, const char* end) {
+  const int64_t kMax = std::numeric_limits<int64_t>::max() / 10;
+  bool is_negative = false;
+  if (p < end && (*p == '-' || *p == '+')) is_negative = (*p++ == '-');
+  int64_t value = 0;
+  for (; p < end && IsDigit(*p); ++p)
+    value = std::min(value * 10 + (*p - '0'), kMax);
+  while (p < end && *p != '/' && !IsDelimiter(*p)) ++p;
+  return is_negative ? -value : value;
+}
+
+/**
+ * @brief Make an index zero-based. Negative ones are relative to \a n, the
+ *        number of elements defined so far. Indices that are before the
+ *        first element, or beyond the range of int, are an error. Those past
+ *        the last one are checked once all are known.
+ */
+inline int FixIndex(int64_t index, size_t n) {
+  int64_t fixed = index;
+  if (index > 0) fixed = index - 1;
+  if (index < 0) fixed = (int64_t)n + index;
+  if (fixed < 0 || fixed > std::numeric_limits<int>::max())
+    throw std::runtime_error("Face refers to a missing vertex.");
+  return fixed;
+}
+
+/**
+ * @brief Parse "v", "v/vt", "v//vn" or "v/vt/vn".
+ */
+inline Corner ParseCorner(const char*& p, const char* end, size_t num_v,
+                          size_t num_vt, size_t num_vn) {
+  Corner corner = {-1, -1, -1};
+  corner.v = FixIndex(ParseIndex(p, end), num_v);
+  if (p == end || *p != '/') return corner;
+  ++p;
+  if (p < end && *p == '/') {
+    ++p;
+    corner.vn = FixIndex(ParseIndex(p, end), num_vn);
+    return corner;
+  }
+  corner.vt = FixIndex(ParseIndex(p, end), num_vt);
+  if (p == end || *p != '/') return corner;
+  ++p;
+  corner.vn = FixIndex(ParseIndex(p, end), num_vn);
+  return corner;
+}
+
+/**
+ * @brief Count the lines of each type, to size the output and to resolve
+ *        relative indices.
+ */
+void CountLines(Chunk& chunk) {
+  ForEachLine(chunk.begin, chunk.end,
+              [&](LineType type, const char*, const char*) {
+    switch (type) {
+      case LineType::kVertex:
+        chunk.num_v++;
+        break;
+      case LineType::kNormal:
+        chunk.num_vn++;
+        break;
+      case LineType::kTexcoord:
+        chunk.num_vt++;
+        break;
+      case LineType::kFace:
+        chunk.num_faces++;
+        break;
+      default:
+        break;
+    }
+  });
+}
+
+/**
+ * @brief Parse the lines of \a chunk. Vertex attributes are written to their
+ *        final place in \a v, \a vn and \a vt. Faces are kept in the chunk.
+ */
+void ParseLines(Chunk& chunk, std::vector<float>& v, std::vector<float>& vn,
+                std::vector<float>& vt) {
+  chunk.corners.reserve(chunk.num_faces * 3);
+  chunk.face_sizes.reserve(chunk.num_faces);
+  size_t num_v = chunk.num_v, num_vn = chunk.num_vn, num_vt = chunk.num_vt;
+  ForEachLine(chunk.begin, chunk.end,
+              [&](LineType type, const char* p, const char* end) {
+    switch (type) {
+      case LineType::kVertex: {
+        p += 2;
+        float* out = &v[3 * num_v++];
+        for (int i = 0; i < 3; ++i) out[i] = ParseFloat(p, end);
+        break;
+      }
+      case LineType::kNormal: {
+        p += 3;
+        float* out = &vn[3 * num_vn++];
+        for (int i = 0; i < 3; ++i) out[i] = ParseFloat(p, end);
+        break;
+      }
+      case LineType::kTexcoord: {
+        p += 3;
+        float* out = &vt[2 * num_vt++];
+        for (int i = 0; i < 2; ++i) out[i] = ParseFloat(p, end);
+        break;
+      }
+      case LineType::kFace: {
+        p += 2;
+        while (p < end && IsSpace(*p)) ++p;
+        size_t first = chunk.corners.size();
+        while (p < end) {
+          chunk.corners.push_back(ParseCorner(p, end, num_v, num_vt, num_vn));
+          while (p < end && IsDelimiter(*p)) ++p;
+        }
+        size_t size = chunk.corners.size() - first;
+        if (size < 3) {
+          // Not a polygon.
+          chunk.corners.resize(first);
+        } else {
+          chunk.face_sizes.push_back(size);
+          chunk.num_triangles += size - 2;
+        }
+        break;
+      }
+      case LineType::kGroup:
+        chunk.face_sizes.push_back(0);
+        break;
+      default:
+        break;
+    }
+  });
+}
+
+/**
+ * @brief Maps the corners of the current group to the vertices made for them.
+ *        Indexed by position, which faces mostly use with a single vt/vn, so
+ *        the lookups stay close to each other in memory. Starting a group is
+ *        O(1): entries of earlier groups count as absent.
+ */
+class VertexCache {
+ public:
+  explicit VertexCache(size_t num_positions)
+      : first_(num_positions), first_group_(num_positions, 0) {}
+
+  void StartGroup() { group_++; }
+
+  /**
+   * @param corner Its position must exist.
+   * @return The vertex of \a corner. If there is none yet, \a new_vertex is
+   *         stored and returned.
+   */
+  uint32_t Find(const Corner& corner, uint32_t new_vertex) {
+    uint32_t* link = &first_[corner.v];
+    if (first_group_[corner.v] == group_) {
+      for (; *link != kNone; link = &entries_[*link].next) {
+        const Entry& entry = entries_[*link];
+        if (entry.vt == corner.vt && entry.vn == corner.vn) return entry.vertex;
+      }
+    } else {
+      first_group_[corner.v] = group_;
+    }
+    *link = entries_.size();
+    entries_.push_back({corner.vt, corner.vn, new_vertex, kNone});
+    return new_vertex;
+  }
+
+ private:
+  static const uint32_t kNone = UINT32_MAX;
+
+  // A vertex made for a position. Others for the same position follow next.
+  struct Entry {
+    int vt, vn;
+    uint32_t vertex;
+    uint32_t next;
+  };
+
+  std::vector<uint32_t> first_;
+  std::vector<uint32_t> first_group_;
+  std::vector<Entry> entries_;
+  // 0 is never current, so all positions start out without vertices.
+  uint32_t group_ = 1;
+};
+
+/**
+ * @brief Call f(corner, false) on the corners of the triangles of the faces
+ *        of \a chunks, in order, and f(Corner(), true) where a group starts.
+ */
+template <typename F>
+void ForEachTriangleCorner(const std::vector<Chunk>& chunks, F f) {
+  for (const Chunk& chunk : chunks) {
+    const Corner* face = chunk.corners.data();
+    for (uint32_t face_size : chunk.face_sizes) {
+      if (face_size == 0) {
+        f(Corner(), true);
+        continue;
+      }
+      for (uint32_t k = 2; k < face_size; ++k) {
+        f(face[0], false);
+        f(face[k - 1], false);
+        f(face[k], false);
+      }
+      face += face_size;
+    }
+  }
+}
+
+/**
+ * @brief Threads for parsing \a size bytes: up to \a max_threads, or the
+ *        number of cores if 0, each with at least kMinBytesPerThread.
+ */
+int NumThreadsFor(size_t size, int max_threads) {
+  if (max_threads <= 0)
+    max_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  return std::min<size_t>(max_threads, size / kMinBytesPerThread + 1);
+}
+
+/**
+ * @brief Run f(i) for i in [0, n), one thread each. The first exception is
+ *        rethrown once all have finished.
+ */
+template <typename F>
+void RunInParallel(size_t n, F f) {
+  std::exception_ptr error;
+  std::mutex mutex;
+  auto run = [&](size_t i) {
+    try {
+      f(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = std::current_exception();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < n; ++i) threads.emplace_back(run, i);
+  run(0);
+  for (std::thread& thread : threads) thread.join();
+  if (error) std::rethrow_exception(error);
+}
+
+/**
+ * @brief Read-only mapping of a whole file.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0) close(fd);
+      throw std::runtime_error("Cannot open file " + filename);
+    }
+    size = st.st_size;
+    if (size > 0) {
+      void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Cannot map file " + filename);
+      }
+      madvise(addr, size, MADV_SEQUENTIAL);
+      data = (const char*)addr;
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data != nullptr) munmap((void*)data, size);
+  }
+
+  const char* data = nullptr;
+  size_t size = 0;
+
+ private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+};
+}
+
+/**
+ * @brief Same as (float)atof() of the next number, but it only reads up to
+ *        \a end. Numbers of at most 19 significant digits and a small exponent
+ *        take a fast path that rounds the same way (Clinger's). Then skip to
+ *        the next delimiter, as tinyobj does.
+ * @param p[in,out] Position in a line, e.g. after "v ".
+ * @param end End of the line.
+ */
+float ParseFloat(const char*& p, const char* end) {
+  while (p < end && IsSpace(*p)) ++p;
+  const char* token = p;
+  while (p < end && !IsDelimiter(*p)) ++p;
+
+  const char* q = token;
+  bool is_negative = false;
+  if (q < p && (*q == '-' || *q == '+')) is_negative = (*q++ == '-');
+  uint64_t mantissa = 0;
+  int num_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  for (; q < p && IsDigit(*q); ++q) {
+    has_digits = true;
+    if (mantissa == 0 && *q == '0') continue;
+    mantissa = mantissa * 10 + (*q - '0');
+    num_digits++;
+  }
+  if (q < p && *q == '.') {
+    for (++q; q < p && IsDigit(*q); ++q) {
+      has_digits = true;
+      exponent--;
+      if (mantissa == 0 && *q == '0') continue;
+      mantissa = mantissa * 10 + (*q - '0');
+      num_digits++;
+    }
+  }
+  if (has_digits && q < p && (*q == 'e' || *q == 'E')) {
+    ++q;
+    bool is_exponent_negative = false;
+    if (q < p && (*q == '-' || *q == '+'))
+      is_exponent_negative = (*q++ == '-');
+    int value = 0;
+    const char* digits = q;
+    for (; q < p && IsDigit(*q); ++q) {
+      if (value < 10000) value = value * 10 + (*q - '0');
+    }
+    if (q == digits) has_digits = false;
+    exponent += is_exponent_negative ? -value : value;
+  }
+
+  double result;
+  if (has_digits && q == p && num_digits <= 19 &&
+      mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+    result = (double)mantissa;
+    result = (exponent < 0) ? result / kPow10[-exponent]
+                            : result * kPow10[exponent];
+    if (is_negative) result = -result;
+  } else {
+    // Long, huge, tiny, malformed, hexadecimal, inf or nan.
+    result = strtod(std::string(token, p).c_str(), nullptr);
+  }
+  return (float)result;
+}
+
+/**
+ * @brief Parse the triangles of a Wavefront .obj file held in memory. Only
+ *        "v", "vn", "vt", "f", "g" and "o" lines are read.
+ *
+ * The data is split into chunks of whole lines, one per thread. A first pass
+ * counts the lines of each type, which sizes the arrays and gives each chunk
+ * the offsets of its elements. A second pass parses the chunks in parallel.
+ * Vertices are then made for the faces in file order, and once they are all
+ * known their attributes are copied out, into arrays of the exact size.
+ *
+ * @param data Need not be null-terminated.
+ * @param num_threads 0 to choose from the size of the data and the number of
+ *        cores.
+ * @param[out] mesh
+ */
+void ParseObj(const char* data, size_t size, int num_threads, ObjMesh& mesh) {
+  if (num_threads <= 0) num_threads = NumThreadsFor(size, 0);
+
+  std::vector<Chunk> chunks(num_threads);
+  const char* end = data + size;
+  const char* begin = data;
+  for (int i = 0; i < num_threads; ++i) {
+    chunks[i].begin = begin;
+    if (i + 1 < num_threads) {
+      // Just past the first line break after the even split.
+      const char* split = std::max(begin, data + size * (i + 1) / num_threads);
+      const char* eol =
+          (split < end) ? (const char*)memchr(split, '\n', end - split)
+                        : nullptr;
+      begin = (eol == nullptr) ? end : eol + 1;
+    } else {
+      begin = end;
+    }
+    chunks[i].end = begin;
+  }
+
+  RunInParallel(num_threads, [&](size_t i) { CountLines(chunks[i]); });
+
+  // Counts to offsets.
+  size_t num_v = 0, num_vn = 0, num_vt = 0;
+  for (Chunk& chunk : chunks) {
+    std::swap(num_v, chunk.num_v);
+    std::swap(num_vn, chunk.num_vn);
+    std::swap(num_vt, chunk.num_vt);
+    num_v += chunk.num_v;
+    num_vn += chunk.num_vn;
+    num_vt += chunk.num_vt;
+  }
+  std::vector<float> v(3 * num_v), vn(3 * num_vn), vt(2 * num_vt);
+
+  RunInParallel(num_threads,
+                [&](size_t i) { ParseLines(chunks[i], v, vn, vt); });
+
+  size_t num_triangles = 0;
+  for (const Chunk& chunk : chunks) num_triangles += chunk.num_triangles;
+  mesh.indices = std::vector<uint32_t>(3 * num_triangles);
+
+  // Number the vertices first, to size the output exactly: it is what
+  // LoadObj() keeps. They are numbered in order of first use, so the second
+  // pass over the faces copies out a corner when its vertex is the next one.
+  size_t num_vertices = 0, num_vertices_vn = 0, num_vertices_vt = 0;
+  {
+    VertexCache cache(num_v);
+    uint32_t* out = mesh.indices.data();
+    auto add_vertex = [&](const Corner& corner) {
+      if (corner.v < 0 || (size_t)corner.v >= num_v)
+        throw std::runtime_error("Face refers to a missing vertex.");
+      uint32_t vertex = cache.Find(corner, num_vertices);
+      if (vertex == num_vertices) {
+        if ((corner.vn >= 0 && (size_t)corner.vn >= num_vn) ||
+            (corner.vt >= 0 && (size_t)corner.vt >= num_vt))
+          throw std::runtime_error("Face refers to a missing vertex.");
+        num_vertices++;
+        num_vertices_vn += corner.vn >= 0;
+        num_vertices_vt += corner.vt >= 0;
+      }
+      *out++ = vertex;
+    };
+    ForEachTriangleCorner(chunks, [&](const Corner& corner, bool is_group) {
+      if (is_group) {
+        cache.StartGroup();
+      } else {
+        add_vertex(corner);
+      }
+    });
+  }
+
+  // Assigned rather than resized, which would keep the capacity of a reused
+  // mesh.
+  mesh.positions = std::vector<float>(3 * num_vertices);
+  mesh.normals = std::vector<float>(3 * num_vertices_vn);
+  mesh.texcoords = std::vector<float>(2 * num_vertices_vt);
+  float* positions = mesh.positions.data();
+  float* normals = mesh.normals.data();
+  float* texcoords = mesh.texcoords.data();
+  const uint32_t* index = mesh.indices.data();
+  uint32_t next_vertex = 0;
+  ForEachTriangleCorner(chunks, [&](const Corner& corner, bool is_group) {
+    if (is_group || *index++ != next_vertex) return;
+    next_vertex++;
+    positions = std::copy_n(&v[3 * corner.v], 3, positions);
+    if (corner.vn >= 0) normals = std::copy_n(&vn[3 * corner.vn], 3, normals);
+    if (corner.vt >= 0)
+      texcoords = std::copy_n(&vt[2 * corner.vt], 2, texcoords);
+  });
+}
+
+/**
+ * @brief Parse a Wavefront .obj file. It is memory-mapped, not read.
+ * @param max_threads Fewer are used for small files. 0 for the number of
+ *        cores.
+ * @see ParseObj
+ */
+void ParseObjFile(const std::string& filename, int max_threads,
+                  ObjMesh& mesh) {
+  MappedFile file(filename);
+  ParseObj(file.data, file.size, NumThreadsFor(file.size, max_threads), mesh);
+}
+}
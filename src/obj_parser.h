@@ -0,0 +1,34 @@
+/**
+ * @file obj_parser.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace librender {
+
+/**
+ * @brief Triangles of a Wavefront .obj file, laid out as by tinyobj: vertices
+ *        are deduplicated by their v/vt/vn triple within each group ("g" or
+ *        "o"), in order of first use, and polygons are split into fans.
+ *        Groups are concatenated.
+ */
+struct ObjMesh {
+  std::vector<float> positions;   // 3 per vertex
+  std::vector<float> normals;     // 3 per vertex that refers to a normal
+  std::vector<float> texcoords;   // 2 per vertex that refers to a texcoord
+  std::vector<uint32_t> indices;  // 3 per triangle
+};
+
+void ParseObj(const char* data, size_t size, int num_threads, ObjMesh& mesh);
+void ParseObjFile(const std::string& filename, int max_threads,
+                  ObjMesh& mesh);
+float ParseFloat(const char*& p, const char* end);
+}
@@ -0,0 +1,57 @@
+/**
+ * @file parallel.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace librender {
+
+// Below this, threads cost more than they save.
+const size_t kMinItemsPerThread = 1 << 14;
+
+/**
+ * @brief Bounds of the consecutive parts of [0, \a n) that ParallelFor()
+ *        gives to each thread.
+ * @param max_threads 0 for the number of cores.
+ */
+inline std::vector<size_t> SplitRange(size_t n, int max_threads = 0) {
+  if (n < 2 * kMinItemsPerThread) return {0, n};
+  size_t num_threads = (max_threads > 0)
+                           ? max_threads
+                           : std::max(1u, std::thread::hardware_concurrency());
+  num_threads =
+      std::max<size_t>(1, std::min(num_threads, n / kMinItemsPerThread));
+  std::vector<size_t> bounds(num_threads + 1);
+  for (size_t i = 0; i <= num_threads; ++i) bounds[i] = n * i / num_threads;
+  return bounds;
+}
+
+/**
+ * @brief Call \a fn(begin, end) on consecutive parts of [0, \a n) on up to
+ *        \a max_threads threads, including the calling thread.
+ * @param max_threads 0 for the number of cores.
+ */
+template <typename Fn>
+void ParallelFor(size_t n, int max_threads, Fn fn) {
+  std::vector<size_t> bounds = SplitRange(n, max_threads);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i + 1 < bounds.size(); ++i)
+    threads.emplace_back(fn, bounds[i], bounds[i + 1]);
+  fn(bounds[0], bounds[1]);
+  for (std::thread& thread : threads) thread.join();
+}
+
+template <typename Fn>
+void ParallelFor(size_t n, Fn fn) {
+  ParallelFor(n, 0, fn);
+}
+}
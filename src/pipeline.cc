@@ -0,0 +1,309 @@
+/**
+ * @file pipeline.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "pipeline.h"
+
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <stdint.h>
+#include <thread>
+#include "config.h"
+#include "io.h"
+#include "mesh_loader.h"
+#include "npy_writer.h"
+#include "profiler.h"
+#include "render_session.h"
+#include "shape.h"
+
+namespace librender {
+namespace {
+
+struct LoadedMesh {
+  size_t job_index;
+  Shape* shape;
+};
+
+struct EncodeTask {
+  FrameInfo frame;
+  std::vector<uint8_t> pixels;
+  // Copies of the aux outputs, which frame points to.
+  std::vector<float> depth;
+  std::vector<uint16_t> normals;
+  std::vector<uint8_t> mask;
+};
+
+// One array per output of the framebuffer.
+struct NpyWriters {
+  io::NpyWriter* color = nullptr;
+  io::NpyWriter* depth = nullptr;
+  io::NpyWriter* normals = nullptr;
+  io::NpyWriter* mask = nullptr;
+
+  ~NpyWriters() {
+    delete color;
+    delete depth;
+    delete normals;
+    delete mask;
+  }
+};
+
+/**
+ * @brief Keeps the first exception thrown by any stage, to be rethrown on the
+ *        calling thread once all threads have been joined.
+ */
+class ErrorSlot {
+ public:
+  void Set(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) error_ = error;
+  }
+  void RethrowIfSet() {
+    if (error_) std::rethrow_exception(error_);
+  }
+
+ private:
+  std::exception_ptr error_;
+  std::mutex mutex_;
+};
+}
+
+/**
+ * @brief Create a .npy array with one slot per view of every job. All jobs
+ *        must have the same image size and number of views.
+ * @param filename Replaced if it exists.
+ * @param all_params
+ * @param[out] frames_per_job Number of views per job.
+ * @param channels,type Of each pixel.
+ */
+io::NpyWriter* CreateNpyWriter(const std::string& filename,
+                               const std::vector<RenderParams>& all_params,
+                               size_t& frames_per_job, int channels,
+                               io::NpyType type) {
+  const RenderParams& first = all_params[0];
+  frames_per_job = std::max<size_t>(first.views.size(), 1);
+  for (const RenderParams& params : all_params) {
+    if (params.image_width != first.image_width ||
+        params.image_height != first.image_height ||
+        std::max<size_t>(params.views.size(), 1) != frames_per_job)
+      throw std::runtime_error(
+          "All jobs written to one .npy file need the same image size and "
+          "number of views.");
+  }
+
+  fs::path out_dir = fs::path(filename).parent_path();
+  if (!out_dir.empty()) fs::create_directories(out_dir);
+  size_t num_frames = all_params.size() * frames_per_job;
+  if (config::is_verbose) {
+    std::cout << "Writing " << num_frames << " images to " << filename
+              << std::endl;
+  }
+  return new io::NpyWriter(filename, num_frames, first.image_height,
+                           first.image_width, channels, type);
+}
+
+/**
+ * @brief One encoder per job; the GL thread is the caller. A loaded mesh can
+ *        be as large as the machine allows, so at most kMaxLoaders meshes are
+ *        loaded at once, and at most kMeshQueueCapacity wait to be drawn,
+ *        whatever the number of jobs. Each loader gets its share of the
+ *        cores for parsing, and each encoder its share for PNG files, so a
+ *        large image only gets more threads when there are fewer jobs.
+ * @param num_jobs Typically the number of cores.
+ */
+PipelineOptions DefaultPipelineOptions(int num_jobs) {
+  const int kMaxLoaders = 2;
+  const size_t kMeshQueueCapacity = 2;
+  PipelineOptions options;
+  options.num_loaders = std::min(std::max(num_jobs, 1), kMaxLoaders);
+  options.num_encoders = std::max(num_jobs, 1);
+  options.mesh_queue_capacity = kMeshQueueCapacity;
+  options.image_queue_capacity = 4 * options.num_encoders;
+  int num_cores = std::max<int>(std::thread::hardware_concurrency(), 1);
+  options.num_loader_threads = std::max(1, num_cores / options.num_loaders);
+  options.num_png_threads = std::max(1, num_cores / options.num_encoders);
+  return options;
+}
+
+/**
+ * @brief Render every job off-screen in three stages. A pool of loader
+ *        threads parses meshes ahead of the calling thread, which owns the GL
+ *        context and only draws, and a pool of encoder threads compresses and
+ *        writes the images. Both queues are bounded, so a slow stage stalls
+ *        the ones before it instead of buffering without limit.
+ *
+ * Jobs are rendered in the order their meshes finish loading.
+ *
+ * @param all_params Every job must have an output filename.
+ * @param options
+ */
+void RunPipeline(std::vector<RenderParams>& all_params,
+                 const PipelineOptions& options) {
+  if (all_params.empty()) return;
+  for (const RenderParams& params : all_params) {
+    if (params.out_filename.empty())
+      throw std::runtime_error("The pipeline only renders to files.");
+  }
+
+  BoundedQueue<LoadedMesh> mesh_queue(options.mesh_queue_capacity);
+  BoundedQueue<EncodeTask*> image_queue(options.image_queue_capacity);
+  ErrorSlot error;
+
+  NpyWriters npy_writers;
+  size_t frames_per_job = 0;
+  if (!options.npy_filename.empty()) {
+    std::string filename = options.npy_filename;
+    if (!all_params[0].can_overwrite) io::ResolveFilenameConflict(filename);
+    npy_writers.color = CreateNpyWriter(filename, all_params, frames_per_job);
+    if (all_params[0].has_aux_outputs) {
+      npy_writers.depth =
+          CreateNpyWriter(io::AppendToFilename(filename, "_depth"), all_params,
+                          frames_per_job, 1, io::NpyType::kFloat32);
+      npy_writers.normals =
+          CreateNpyWriter(io::AppendToFilename(filename, "_normal"),
+                          all_params, frames_per_job, 3, io::NpyType::kUint16);
+      npy_writers.mask =
+          CreateNpyWriter(io::AppendToFilename(filename, "_mask"), all_params,
+                          frames_per_job, 1, io::NpyType::kUint8);
+    }
+  }
+
+  // Each stage runs beside the others, so none may default to all cores.
+  const int num_loader_threads = std::max(options.num_loader_threads, 1);
+  const int num_png_threads = std::max(options.num_png_threads, 1);
+
+  // Stage 1: parse meshes and compute normals.
+  std::atomic<size_t> next_job(0);
+  std::atomic<int> num_active_loaders(options.num_loaders);
+  std::vector<std::thread> loaders;
+  for (int i = 0; i < options.num_loaders; ++i) {
+    loaders.emplace_back([&, i] {
+      profiler::SetThreadName("loader " + std::to_string(i));
+      try {
+        size_t job_index;
+        while ((job_index = next_job++) < all_params.size()) {
+          profiler::SetJob(job_index);
+          Shape* shape = new Shape();
+          LoadObj(all_params[job_index], *shape, num_loader_threads);
+          if (!mesh_queue.Push({job_index, shape})) {
+            delete shape;
+            break;
+          }
+        }
+      } catch (...) {
+        error.Set(std::current_exception());
+        mesh_queue.Close();
+        image_queue.Close();
+      }
+      // The last loader to finish ends the stream.
+      if (--num_active_loaders == 0) mesh_queue.Close();
+    });
+  }
+
+  // Stage 3: encode and write images.
+  std::vector<std::thread> encoders;
+  for (int i = 0; i < options.num_encoders; ++i) {
+    encoders.emplace_back([&, i] {
+      profiler::SetThreadName("encoder " + std::to_string(i));
+      EncodeTask* task;
+      while (image_queue.Pop(task)) {
+        profiler::SetJob(task->frame.job_index);
+        try {
+          SaveFrame(task->frame, task->pixels.data(), num_png_threads);
+        } catch (...) {
+          error.Set(std::current_exception());
+          mesh_queue.Close();
+          image_queue.Close();
+        }
+        delete task;
+      }
+    });
+  }
+
+  // Stage 2: draw on this thread.
+  profiler::SetThreadName("render");
+  try {
+    RenderSession session(all_params[0]);
+    session.frame_handler = [&](const FrameInfo& frame,
+                                const uint8_t* pixels) {
+      size_t num_pixels = (size_t)frame.width * frame.height;
+      // Straight from the mapped pixel buffer into the arrays. Slots are
+      // disjoint, so there is nothing to synchronize.
+      if (npy_writers.color != nullptr) {
+        size_t slot = frame.job_index * frames_per_job + frame.view_index;
+        npy_writers.color->Write(slot, pixels);
+        if (frame.depth != nullptr && npy_writers.depth != nullptr) {
+          LinearizeDepth(frame.depth, num_pixels, frame.near, frame.far,
+                         (float*)npy_writers.depth->Slot(slot));
+          npy_writers.normals->Write(slot, frame.normals);
+          npy_writers.mask->Write(slot, frame.mask);
+        }
+        return;
+      }
+      EncodeTask* task = new EncodeTask();
+      task->frame = frame;
+      task->pixels.assign(pixels, pixels + 4 * num_pixels);
+      if (frame.depth != nullptr) {
+        task->depth.assign(frame.depth, frame.depth + num_pixels);
+        task->normals.assign(frame.normals, frame.normals + 3 * num_pixels);
+        task->mask.assign(frame.mask, frame.mask + num_pixels);
+        task->frame.depth = task->depth.data();
+        task->frame.normals = task->normals.data();
+        task->frame.mask = task->mask.data();
+      }
+      if (!image_queue.Push(task)) delete task;
+    };
+
+    LoadedMesh mesh;
+    while (mesh_queue.Pop(mesh)) {
+      RenderParams& params = all_params[mesh.job_index];
+      if (config::is_verbose) std::cout << params.in_filename << std::endl;
+      profiler::SetJob(mesh.job_index);
+      try {
+        session.Render(*mesh.shape, params);
+      } catch (...) {
+        delete mesh.shape;
+        throw;
+      }
+      delete mesh.shape;
+    }
+  } catch (...) {
+    error.Set(std::current_exception());
+    mesh_queue.Close();
+  }
+  image_queue.Close();
+
+  for (std::thread& thread : loaders) thread.join();
+  for (std::thread& thread : encoders) thread.join();
+
+  // Meshes loaded after the GL thread gave up.
+  LoadedMesh mesh;
+  while (mesh_queue.Pop(mesh)) delete mesh.shape;
+
+  if (config::is_verbose) {
+    PrintQueueStats("mesh queue", mesh_queue.stats());
+    PrintQueueStats("image queue", image_queue.stats());
+  }
+
+  error.RethrowIfSet();
+}
+
+/**
+ * @brief e.g. "image queue: 12 items, depth mean 3.2 max 8 of 8, producer
+ *        waited 40.1 ms, consumers waited 1.5 ms"
+ * @param name
+ * @param stats
+ */
+void PrintQueueStats(const std::string& name, const QueueStats& stats) {
+  std::cout << name << ": " << stats.num_items << " items, depth mean "
+            << stats.mean_depth << " max " << stats.max_depth << " of "
+            << stats.capacity << ", producers waited " << stats.push_wait_ms
+            << " ms, consumers waited " << stats.pop_wait_ms << " ms"
+            << std::endl;
+}
+}
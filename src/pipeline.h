@@ -0,0 +1,146 @@
+/**
+ * @file pipeline.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "graphics.h"
+#include "npy_writer.h"
+
+namespace librender {
+
+/**
+ * @brief Occupancy of a BoundedQueue over its lifetime. A queue that is
+ *        mostly full points to a slow consumer, one that is mostly empty to a
+ *        slow producer.
+ */
+struct QueueStats {
+  size_t capacity = 0;
+  size_t num_items = 0;
+  size_t max_depth = 0;
+  double mean_depth = 0;  // sampled on every push
+  double push_wait_ms = 0;
+  double pop_wait_ms = 0;
+};
+
+/**
+ * @brief Blocking FIFO queue with a fixed capacity, shared by producer and
+ *        consumer threads.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity)
+      : capacity_(std::max<size_t>(capacity, 1)) {}
+
+  /**
+   * @brief Block while the queue is full.
+   * @return False if the queue was closed. \a item is not added.
+   */
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto start = std::chrono::steady_clock::now();
+    not_full_.wait(lock,
+                   [this] { return is_closed_ || items_.size() < capacity_; });
+    stats_.push_wait_ms += ElapsedMs(start);
+    if (is_closed_) return false;
+
+    items_.push_back(std::move(item));
+    depth_sum_ += items_.size();
+    stats_.num_items++;
+    stats_.max_depth = std::max(stats_.max_depth, items_.size());
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Block while the queue is empty.
+   * @return False if the queue is closed and there is nothing left to pop.
+   */
+  bool Pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto start = std::chrono::steady_clock::now();
+    not_empty_.wait(lock, [this] { return is_closed_ || !items_.empty(); });
+    stats_.pop_wait_ms += ElapsedMs(start);
+    if (items_.empty()) return false;
+
+    item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Wake up all waiting threads. Items already in the queue can still
+   *        be popped; further pushes fail.
+   */
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  QueueStats stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    QueueStats stats = stats_;
+    stats.capacity = capacity_;
+    if (stats.num_items > 0) stats.mean_depth = depth_sum_ / stats.num_items;
+    return stats;
+  }
+
+ private:
+  static double ElapsedMs(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start).count();
+  }
+
+  const size_t capacity_;
+  std::deque<T> items_;
+  bool is_closed_ = false;
+  double depth_sum_ = 0;
+  QueueStats stats_;
+  std::mutex mutex_;
+  std::condition_variable not_full_, not_empty_;
+};
+
+/**
+ * @brief Thread counts and queue sizes of RunPipeline().
+ */
+struct PipelineOptions {
+  int num_loaders = 1;
+  int num_encoders = 1;
+  // Maximum number of loaded meshes waiting for the GL thread.
+  size_t mesh_queue_capacity = 4;
+  // Maximum number of images waiting to be encoded.
+  size_t image_queue_capacity = 16;
+  // Threads per mesh, for parsing it and computing its normals.
+  int num_loader_threads = 1;
+  // Threads per PNG file. Only large images are split, so small ones still
+  // take one encoder thread each.
+  int num_png_threads = 1;
+  // If set, frames are copied into one .npy array instead of being encoded.
+  // Aux outputs go into arrays of their own, e.g. _depth.npy.
+  std::string npy_filename;
+};
+
+PipelineOptions DefaultPipelineOptions(int num_jobs);
+void RunPipeline(std::vector<RenderParams>& all_params,
+                 const PipelineOptions& options);
+io::NpyWriter* CreateNpyWriter(const std::string& filename,
+                               const std::vector<RenderParams>& all_params,
+                               size_t& frames_per_job, int channels = 4,
+                               io::NpyType type = io::NpyType::kUint8);
+void PrintQueueStats(const std::string& name, const QueueStats& stats);
+}
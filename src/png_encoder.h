@@ -0,0 +1,43 @@
+/**
+ * @file png_encoder.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace librender {
+namespace io {
+
+// Try every filter type per row and keep the one that looks most compressible.
+const int kAdaptiveFilter = -1;
+
+/**
+ * @brief Speed and size trade-off of the PNG encoder.
+ */
+struct PngOptions {
+  // zlib level. 0 stores the data uncompressed, 9 is the slowest.
+  int level = 4;
+  // Run-length matches only. Much faster than a full LZ77 search and still
+  // effective on filtered renders, which are mostly flat.
+  bool is_rle = false;
+  // kAdaptiveFilter, or a fixed filter type for every row: 0 None, 1 Sub,
+  // 2 Up, 3 Average, 4 Paeth.
+  int filter = kAdaptiveFilter;
+};
+
+PngOptions PngPreset(const std::string& name);
+int PngFilterFromName(const std::string& name);
+void EncodePNG(const uint8_t* rgba, int w, int h, std::vector<uint8_t>& out,
+               const PngOptions& options = PngOptions(), int num_threads = 0);
+void EncodePNG(const void* pixels, int w, int h, int channels, int bit_depth,
+               std::vector<uint8_t>& out,
+               const PngOptions& options = PngOptions(), int num_threads = 0);
+}
+}
@@ -0,0 +1,287 @@
+/**
+ * @file profiler.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace librender {
+namespace profiler {
+
+bool is_enabled = false;
+bool is_gpu_enabled = false;
+
+namespace {
+
+struct Event {
+  const char* name;
+  int64_t start_ns, end_ns;
+  int64_t job;
+};
+
+// Written only by its own thread, or under buffers_mutex if it is a track.
+// Read once the threads are done.
+struct ThreadBuffer {
+  int tid;
+  std::string name;
+  std::vector<Event> events;
+  // Not owned by a thread. See RecordOnTrack().
+  bool is_track = false;
+};
+
+std::mutex buffers_mutex;
+std::vector<ThreadBuffer*> buffers;
+// Incremented by Reset(), which invalidates every thread's cached buffer.
+// Read without the lock by every timer.
+std::atomic<size_t> generation(0);
+
+thread_local ThreadBuffer* thread_buffer = nullptr;
+thread_local size_t thread_generation = 0;
+thread_local int64_t thread_job = -1;
+
+ThreadBuffer* GetThreadBuffer() {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  if (thread_buffer == nullptr ||
+      thread_generation != generation.load(std::memory_order_relaxed)) {
+    thread_buffer = new ThreadBuffer();
+    thread_buffer->tid = buffers.size();
+    thread_buffer->name = "thread " + std::to_string(buffers.size());
+    thread_buffer->events.reserve(1024);
+    buffers.push_back(thread_buffer);
+    thread_generation = generation.load(std::memory_order_relaxed);
+  }
+  return thread_buffer;
+}
+
+inline ThreadBuffer* CurrentThreadBuffer() {
+  if (thread_buffer != nullptr &&
+      thread_generation == generation.load(std::memory_order_acquire))
+    return thread_buffer;
+  return GetThreadBuffer();
+}
+
+// Trace timestamps start at the first event.
+int64_t TraceOrigin() {
+  int64_t origin = INT64_MAX;
+  for (const ThreadBuffer* buffer : buffers) {
+    for (const Event& event : buffer->events)
+      origin = std::min(origin, event.start_ns);
+  }
+  return origin;
+}
+
+std::string EscapeJson(const std::string& s) {
+  std::string escaped;
+  for (char c : s) {
+    if (c == '"' || c == '\\') escaped += '\\';
+    if ((unsigned char)c < 0x20) continue;
+    escaped += c;
+  }
+  return escaped;
+}
+}
+
+int64_t ScopedTimer::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Append an event to the calling thread's buffer. Only the first event
+ *        of each thread takes a lock.
+ */
+void ScopedTimer::Record(const char* name, int64_t start_ns, int64_t end_ns) {
+  CurrentThreadBuffer()->events.push_back({name, start_ns, end_ns, thread_job});
+}
+
+/**
+ * @brief Name the calling thread's track in the trace, e.g. "loader 0".
+ */
+void SetThreadName(const std::string& name) {
+  if (!is_enabled) return;
+  CurrentThreadBuffer()->name = name;
+}
+
+/**
+ * @brief Tag the calling thread's following events with \a job_index. -1 for
+ *        none.
+ */
+void SetJob(int64_t job_index) { thread_job = job_index; }
+
+int64_t CurrentJob() { return thread_job; }
+
+/**
+ * @brief Record an event on a track that is not a thread, e.g. "gpu". The
+ *        track is created on first use.
+ */
+void RecordOnTrack(const std::string& track, const char* name,
+                   int64_t start_ns, int64_t end_ns, int64_t job) {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  ThreadBuffer* buffer = nullptr;
+  for (ThreadBuffer* candidate : buffers) {
+    if (candidate->is_track && candidate->name == track) buffer = candidate;
+  }
+  if (buffer == nullptr) {
+    buffer = new ThreadBuffer();
+    buffer->tid = buffers.size();
+    buffer->name = track;
+    buffer->is_track = true;
+    buffers.push_back(buffer);
+  }
+  buffer->events.push_back({name, start_ns, end_ns, job});
+}
+
+/**
+ * @brief Per-stage statistics over all threads, slowest stage first. Call
+ *        once the timed threads are done.
+ */
+std::vector<StageStats> AggregateStats() {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  std::map<std::string, std::vector<double>> durations;
+  for (const ThreadBuffer* buffer : buffers) {
+    for (const Event& event : buffer->events)
+      durations[event.name].push_back((event.end_ns - event.start_ns) * 1e-6);
+  }
+
+  std::vector<StageStats> all_stats;
+  for (auto& kv : durations) {
+    std::vector<double>& ms = kv.second;
+    std::sort(ms.begin(), ms.end());
+    StageStats stats;
+    stats.name = kv.first;
+    stats.count = ms.size();
+    for (double value : ms) stats.total_ms += value;
+    stats.p50_ms = Percentile(ms, 0.5);
+    stats.p95_ms = Percentile(ms, 0.95);
+    stats.max_ms = ms.back();
+    all_stats.push_back(stats);
+  }
+  std::stable_sort(all_stats.begin(), all_stats.end(),
+                   [](const StageStats& a, const StageStats& b) {
+                     return a.total_ms > b.total_ms;
+                   });
+  return all_stats;
+}
+
+/**
+ * @brief Print the total time of each stage per job, followed by the
+ *        distribution of each stage over all jobs.
+ *
+ *   job 0: parse 12.10 ms, normals 3.21 ms, ...
+ *   stage              count    total ms    p50 ms    p95 ms    max ms
+ *   parse                  8       98.10     12.01     13.12     13.50
+ */
+void PrintStats(std::ostream& out) {
+  std::vector<StageStats> all_stats = AggregateStats();
+
+  std::map<int64_t, std::map<std::string, double>> job_ms;
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (const ThreadBuffer* buffer : buffers) {
+      for (const Event& event : buffer->events) {
+        if (event.job >= 0)
+          job_ms[event.job][event.name] +=
+              (event.end_ns - event.start_ns) * 1e-6;
+      }
+    }
+  }
+
+  out << std::fixed << std::setprecision(2);
+  for (const auto& job : job_ms) {
+    out << "job " << job.first << ":";
+    const char* separator = " ";
+    // In the order of the aggregate table.
+    for (const StageStats& stats : all_stats) {
+      auto it = job.second.find(stats.name);
+      if (it == job.second.end()) continue;
+      out << separator << stats.name << " " << it->second << " ms";
+      separator = ", ";
+    }
+    out << "\n";
+  }
+
+  out << std::left << std::setw(16) << "stage" << std::right << std::setw(8)
+      << "count" << std::setw(12) << "total ms" << std::setw(10) << "p50 ms"
+      << std::setw(10) << "p95 ms" << std::setw(10) << "max ms" << "\n";
+  for (const StageStats& stats : all_stats) {
+    out << std::left << std::setw(16) << stats.name << std::right
+        << std::setw(8) << stats.count << std::setw(12) << stats.total_ms
+        << std::setw(10) << stats.p50_ms << std::setw(10) << stats.p95_ms
+        << std::setw(10) << stats.max_ms << "\n";
+  }
+  out << std::defaultfloat << std::flush;
+}
+
+/**
+ * @brief Write all events in the Chrome trace event format, which
+ *        chrome://tracing and Perfetto open. Each thread is one track, and
+ *        the job of an event is in its args. Call once the timed threads are
+ *        done.
+ * @param filename e.g. out.json
+ */
+void WriteChromeTrace(const std::string& filename) {
+  std::ofstream file(filename);
+  if (!file) throw std::runtime_error("Unable to write " + filename);
+
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  int64_t origin = TraceOrigin();
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  const char* separator = "\n";
+  for (const ThreadBuffer* buffer : buffers) {
+    file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+         << "\"tid\":" << buffer->tid << ",\"args\":{\"name\":\""
+         << EscapeJson(buffer->name) << "\"}}";
+    separator = ",\n";
+    for (const Event& event : buffer->events) {
+      // Microseconds.
+      file << separator << "{\"name\":\"" << EscapeJson(event.name)
+           << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+           << ",\"ts\":" << (event.start_ns - origin) / 1000.0
+           << ",\"dur\":" << (event.end_ns - event.start_ns) / 1000.0;
+      if (event.job >= 0) file << ",\"args\":{\"job\":" << event.job << "}";
+      file << "}";
+    }
+  }
+  file << "\n]}\n";
+  if (!file) throw std::runtime_error("Unable to write " + filename);
+}
+
+/**
+ * @brief Discard all events. Threads that outlive the call start new buffers
+ *        on their next event, but no timer may be running on any thread
+ *        during it, since its buffer is deleted.
+ */
+void Reset() {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  for (ThreadBuffer* buffer : buffers) delete buffer;
+  buffers.clear();
+  generation.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @brief Nearest-rank percentile.
+ * @param sorted Ascending values.
+ * @param q In [0, 1].
+ * @return 0 if \a sorted is empty.
+ */
+double Percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  size_t rank = (size_t)std::ceil(q * sorted.size());
+  return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+}
+}
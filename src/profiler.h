@@ -0,0 +1,77 @@
+/**
+ * @file profiler.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace librender {
+namespace profiler {
+
+// Set before any timer runs, e.g. from the command line. While false, a
+// ScopedTimer only reads this flag.
+extern bool is_enabled;
+// GPU time of draw passes and readbacks. See GpuTimer.
+extern bool is_gpu_enabled;
+
+/**
+ * @brief Records the wall-clock time from construction to destruction as one
+ *        event of the calling thread, tagged with its current job.
+ *
+ *   {
+ *     profiler::ScopedTimer timer("parse");
+ *     ...
+ *   }
+ */
+class ScopedTimer {
+ public:
+  // \a name must outlive the profiler, e.g. a string literal.
+  explicit ScopedTimer(const char* name)
+      : name_(is_enabled ? name : nullptr), start_ns_(name_ ? Now() : 0) {}
+  ~ScopedTimer() {
+    if (name_ != nullptr) Record(name_, start_ns_, Now());
+  }
+
+  static int64_t Now();
+  static void Record(const char* name, int64_t start_ns, int64_t end_ns);
+
+ private:
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  const char* name_;
+  int64_t start_ns_;
+};
+
+/**
+ * @brief Distribution of the durations of one stage, in milliseconds.
+ */
+struct StageStats {
+  std::string name;
+  size_t count = 0;
+  double total_ms = 0;
+  double p50_ms = 0;
+  double p95_ms = 0;
+  double max_ms = 0;
+};
+
+void SetThreadName(const std::string& name);
+void SetJob(int64_t job_index);
+int64_t CurrentJob();
+void RecordOnTrack(const std::string& track, const char* name,
+                   int64_t start_ns, int64_t end_ns, int64_t job);
+std::vector<StageStats> AggregateStats();
+void PrintStats(std::ostream& out);
+void WriteChromeTrace(const std::string& filename);
+void Reset();
+double Percentile(const std::vector<double>& sorted, double q);
+}
+}
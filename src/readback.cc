@@ -0,0 +1,130 @@
+/**
+ * @file readback.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "readback.h"
+
+#include <stdexcept>
+#include "profiler.h"
+
+namespace librender {
+
+/**
+ * @param num_buffers Number of frames that can be in flight. Two is enough to
+ *        overlap one frame's transfer with the next frame's draw calls.
+ */
+AsyncReadback::AsyncReadback(int num_buffers) {
+  if (num_buffers < 1)
+    throw std::runtime_error("AsyncReadback needs at least one buffer.");
+  slots_.resize(num_buffers);
+  for (Slot& slot : slots_) glGenBuffers(1, &slot.pbo);
+}
+
+/**
+ * @brief Pending frames are dropped without calling their callbacks. Call
+ *        Flush() first to keep them.
+ */
+AsyncReadback::~AsyncReadback() {
+  for (Slot& slot : slots_) {
+    if (slot.fence != nullptr) glDeleteSync(slot.fence);
+    glDeleteBuffers(1, &slot.pbo);
+  }
+}
+
+/**
+ * @brief Queue a copy of the framebuffer's pixels into the next pixel buffer.
+ *        If that buffer still holds an earlier frame, that frame is completed
+ *        first.
+ * @param framebuffer Resolved and read without waiting for the GPU.
+ * @param callback Receives the pixels in Framebuffer::ReadPixels() layout.
+ */
+void AsyncReadback::Read(Framebuffer* framebuffer, Callback callback) {
+  Slot& slot = slots_[next_];
+  if (slot.fence != nullptr) Complete(slot);
+
+  slot.size = framebuffer->Size();
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  if (slot.capacity < slot.size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, slot.size, nullptr, GL_STREAM_READ);
+    slot.capacity = slot.size;
+  }
+  // Offset 0 into the bound pack buffer.
+  framebuffer->ReadPixels(nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.callback = callback;
+  // Make sure the transfer starts while the CPU moves on to the next frame.
+  glFlush();
+
+  next_ = (next_ + 1) % slots_.size();
+}
+
+/**
+ * @brief Complete pending frames, oldest first, whose transfers have already
+ *        finished. Never blocks.
+ */
+void AsyncReadback::Poll() {
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot& slot = slots_[(next_ + i) % slots_.size()];
+    if (slot.fence == nullptr) continue;
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    Complete(slot);
+  }
+}
+
+/**
+ * @brief Block until every pending frame has been handed to its callback.
+ */
+void AsyncReadback::Flush() {
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot& slot = slots_[(next_ + i) % slots_.size()];
+    if (slot.fence != nullptr) Complete(slot);
+  }
+}
+
+/**
+ * @brief Wait for the slot's transfer, map its buffer and run the callback.
+ * @param slot
+ */
+void AsyncReadback::Complete(Slot& slot) {
+  GLenum status;
+  {
+    profiler::ScopedTimer timer("readback");
+    do {
+      status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                1000000000);  // 1 s
+    } while (status == GL_TIMEOUT_EXPIRED);
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+  if (status == GL_WAIT_FAILED)
+    throw std::runtime_error("Failed to wait for pixel transfer.");
+
+  Callback callback = slot.callback;
+  slot.callback = nullptr;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  const uint8_t* pixels = (const uint8_t*)glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+  if (pixels == nullptr) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    throw std::runtime_error("Failed to map pixel buffer.");
+  }
+  try {
+    callback(pixels);
+  } catch (...) {
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    throw;
+  }
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+}
@@ -0,0 +1,56 @@
+/**
+ * @file readback.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+#include "framebuffer.h"
+
+namespace librender {
+
+/**
+ * @brief Asynchronous framebuffer readback through a ring of pixel buffer
+ *        objects. Read() only queues the transfer; the pixels of a frame are
+ *        handed to its callback once the ring wraps around to its buffer, or
+ *        on Flush(). This lets the CPU consume frame N while the GPU is still
+ *        drawing frame N+1.
+ *
+ * All methods, including the callbacks, run on the thread that owns the GL
+ * context.
+ */
+class AsyncReadback {
+ public:
+  // \a pixels is only valid until the callback returns.
+  typedef std::function<void(const uint8_t* pixels)> Callback;
+
+  AsyncReadback(int num_buffers = 2);
+  ~AsyncReadback();
+
+  void Read(Framebuffer* framebuffer, Callback callback);
+  void Poll();
+  void Flush();
+
+ private:
+  struct Slot {
+    GLuint pbo = 0;
+    size_t capacity = 0;
+    size_t size = 0;
+    GLsync fence = nullptr;
+    Callback callback;
+  };
+
+  void Complete(Slot& slot);
+
+  std::vector<Slot> slots_;
+  // Next slot to be written. Pending slots complete in the same order.
+  size_t next_ = 0;
+};
+}
@@ -0,0 +1,502 @@
+/**
+ * @file render_session.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "render_session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <vector>
+#include "annotation.h"
+#include "config.h"
+#include "gui.h"
+#include "headless.h"
+#include "io.h"
+#include "npy_writer.h"
+#include "profiler.h"
+#include "readback.h"
+#include "shader.h"
+#include "shaders/line_shader.h"
+#include "shaders/trimesh_shape_shader.h"
+#include "shaders/trimesh_normal_shader.h"
+#include "trimesh_shape_shader_object.h"
+#include "trimesh_normal_shader_object.h"
+
+namespace librender {
+
+// Used in std::min, which takes references.
+const int RenderSession::kLayerVertexComponents;
+const int RenderSession::kMaxLayers;
+const int RenderSession::kNumReadbackBuffers;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ElapsedMs(const Clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+}
+
+/**
+ * @brief Create a headless GL context, or an invisible window if that fails,
+ *        and compile all shader programs. Nothing is drawn until Render() is
+ *        called. The cpu backend needs neither.
+ * @param params Used for window hints only.
+ */
+RenderSession::RenderSession(const RenderParams& params) {
+  if (config::backend == "cpu") {
+    cpu_ = new CpuRasterizer(config::num_jobs);
+    return;
+  }
+
+  try {
+    headless_ = new HeadlessContext();
+  } catch (const std::runtime_error& e) {
+    if (config::is_verbose)
+      std::cerr << e.what() << " Falling back to GLFW." << std::endl;
+    window_ = gui::CreateWindow(0, 0, config::window_title, params);
+  }
+
+  // Support experimental drivers
+  glewExperimental = true;
+  // glewInit() also loads GLX extensions, which fails without an X display.
+  GLenum glew_error = (headless_ != nullptr) ? glewContextInit() : glewInit();
+  if (glew_error != GLEW_OK) {
+    std::cerr << glewGetErrorString(glew_error) << std::endl;
+    DestroyContext();
+    throw std::runtime_error("Failed to open GLEW.");
+  }
+
+  shape_shader_ = shader::Shader(shader::kTrimeshShapeShader);
+  normal_shader_ = shader::Shader(shader::kTrimeshNormalShader);
+  line_shader_ = shader::Shader(shader::kLineShader);
+
+  // Enable depth test.
+  glEnable(GL_DEPTH_TEST);
+
+  // Accept fragment if it closer to the camera than the former one.
+  glDepthFunc(GL_LESS);
+  glEnable(GL_MULTISAMPLE);
+
+  readback_ = new AsyncReadback(kNumReadbackBuffers);
+
+  if (profiler::is_gpu_enabled) {
+    gpu_timer_ = new GpuTimer();
+    GpuTimer::current = gpu_timer_;
+  }
+}
+
+RenderSession::~RenderSession() {
+  if (cpu_ != nullptr) {
+    delete cpu_;
+    return;
+  }
+  if (gpu_timer_ != nullptr) {
+    gpu_timer_->Flush();
+    GpuTimer::current = nullptr;
+    delete gpu_timer_;
+  }
+  delete readback_;
+  for (auto& kv : framebuffers_) delete kv.second;
+  glDeleteProgram(shape_shader_);
+  glDeleteProgram(normal_shader_);
+  glDeleteProgram(line_shader_);
+  if (layered_shader_ != 0) glDeleteProgram(layered_shader_);
+  DestroyContext();
+}
+
+void RenderSession::DestroyContext() {
+  if (headless_ != nullptr) {
+    delete headless_;
+    headless_ = nullptr;
+  } else {
+    glfwTerminate();
+  }
+}
+
+/**
+ * @brief Return a framebuffer of the given size, creating it on first use.
+ */
+Framebuffer* RenderSession::GetFramebuffer(int width, int height,
+                                           int num_msaa_samples,
+                                           int num_layers,
+                                           bool has_aux_outputs) {
+  auto key = std::make_tuple(width, height, num_msaa_samples, num_layers,
+                             has_aux_outputs);
+  auto it = framebuffers_.find(key);
+  if (it != framebuffers_.end()) return it->second;
+
+  Framebuffer* framebuffer = new Framebuffer(width, height, num_msaa_samples,
+                                             num_layers, has_aux_outputs);
+  framebuffers_[key] = framebuffer;
+  return framebuffer;
+}
+
+/**
+ * @brief Number of layers one layered draw can fill. Each layer costs the
+ *        geometry shader three output vertices of kLayerVertexComponents.
+ */
+int RenderSession::MaxLayers() {
+  GLint max_components, max_vertices, max_array_layers;
+  glGetIntegerv(GL_MAX_GEOMETRY_TOTAL_OUTPUT_COMPONENTS, &max_components);
+  glGetIntegerv(GL_MAX_GEOMETRY_OUTPUT_VERTICES, &max_vertices);
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_array_layers);
+
+  int num_layers =
+      std::min(max_components / kLayerVertexComponents, max_vertices) / 3;
+  num_layers = std::min(std::min(num_layers, max_array_layers), kMaxLayers);
+  return std::max(num_layers, 1);
+}
+
+/**
+ * @brief Draw \a shape off-screen and save it to \a params.out_filename. Only
+ *        the vertex data of \a shape is uploaded; the context, programs and
+ *        framebuffers are reused from previous jobs. If \a params.views is not
+ *        empty, the shape is uploaded once and one image is saved per view,
+ *        with the view index appended to the filename. Layered rendering is
+ *        not used for jobs with aux outputs.
+ * @param shape
+ * @param[in,out] params Matrices are recomputed.
+ */
+void RenderSession::Render(const Shape& shape, RenderParams& params) {
+  if (params.out_filename.empty())
+    throw std::runtime_error("RenderSession requires an output filename.");
+
+  last_stats = RenderStats();
+
+  const CameraPose original_pose = {params.r, params.el, params.az,
+                                    params.up_angle};
+  std::vector<CameraPose> views = params.views;
+  if (views.empty()) views.push_back(original_pose);
+
+  if (cpu_ != nullptr) {
+    if (params.has_aux_outputs)
+      throw std::runtime_error("The cpu backend has no aux outputs.");
+    RenderCpu(shape, params, views);
+  } else {
+    gui::render_params = &params;
+    glm::vec4 bg = params.background;
+    glClearColor(bg.r, bg.g, bg.b, bg.a);
+    // Required for the new framebuffer object.
+    glViewport(0, 0, params.image_width, params.image_height);
+
+    if (params.is_layered && views.size() > 1 && !params.has_aux_outputs) {
+      RenderLayered(shape, params, views);
+    } else {
+      RenderViews(shape, params, views);
+    }
+
+    // Frames still in flight hold pointers to params.
+    auto start = Clock::now();
+    double save_ms = last_stats.save_ms;
+    readback_->Flush();
+    last_stats.readback_ms +=
+        ElapsedMs(start) - (last_stats.save_ms - save_ms);
+    // GPU timings of this job that are ready. The rest are collected later.
+    if (gpu_timer_ != nullptr) gpu_timer_->Poll();
+  }
+
+  SetPose(original_pose, params);
+  last_stats.num_views = views.size();
+
+  if (config::is_verbose) {
+    std::cout << "setup: " << last_stats.setup_ms
+              << " ms, draw: " << last_stats.draw_ms
+              << " ms, readback: " << last_stats.readback_ms
+              << " ms, save: " << last_stats.save_ms << " ms";
+    if (last_stats.num_views > 1)
+      std::cout << " (" << last_stats.num_views << " views)";
+    std::cout << std::endl;
+  }
+}
+
+/**
+ * @brief One draw and readback per view.
+ */
+void RenderSession::RenderViews(const Shape& shape, RenderParams& params,
+                                const std::vector<CameraPose>& views) {
+  auto start = Clock::now();
+  Framebuffer* framebuffer =
+      GetFramebuffer(params.image_width, params.image_height,
+                     params.num_msaa_samples, 0, params.has_aux_outputs);
+
+  float min_z = arma::min(shape.v.row(2));
+  Annotation annotation(min_z, params, line_shader_);
+  shader::TrimeshShapeShaderObject drawable_object(&shape, shape_shader_,
+                                                   params);
+  shader::TrimeshNormalShaderObject drawable_object2(&shape, normal_shader_,
+                                                     params);
+  last_stats.setup_ms += ElapsedMs(start);
+
+  for (size_t i = 0; i < views.size(); ++i) {
+    start = Clock::now();
+    {
+      profiler::ScopedTimer timer("draw");
+      SetPose(views[i], params);
+      framebuffer->Bind();
+      framebuffer->Clear(&params.background[0]);
+      ComputeMatrices(params);
+
+      if (params.has_aux_outputs) {
+        // Only the mesh goes into depth, normals and mask. The grid and
+        // normal arrows are drawn over it in color without writing depth.
+        drawable_object.Draw(params, false);
+        framebuffer->SetAuxOutputsEnabled(false);
+        glDepthMask(GL_FALSE);
+        annotation.Draw(params);
+        drawable_object2.Draw(params, false);
+        glDepthMask(GL_TRUE);
+      } else {
+        annotation.Draw(params);
+        drawable_object.Draw(params, false);
+        drawable_object2.Draw(params, false);
+      }
+    }
+    last_stats.draw_ms += ElapsedMs(start);
+
+    // Saved once the GPU is done, while later views are being drawn.
+    Read(framebuffer, [this, &params, i, framebuffer](const uint8_t* pixels) {
+      SaveView(params, i, pixels, framebuffer);
+    });
+  }
+}
+
+/**
+ * @brief Draw up to MaxLayers() views at once. The geometry shader emits each
+ *        triangle once per layer of a layered framebuffer, and all layers are
+ *        read back with one transfer. Grid lines and face normal arrows are
+ *        still drawn once per layer.
+ */
+void RenderSession::RenderLayered(const Shape& shape, RenderParams& params,
+                                  const std::vector<CameraPose>& views) {
+  auto start = Clock::now();
+  if (layered_shader_ == 0) {
+    max_layers_ = MaxLayers();
+    std::stringstream defines;
+    defines << "#define NUM_LAYERS " << max_layers_ << "\n"
+            << "#define NUM_LAYER_VERTICES " << 3 * max_layers_;
+    layered_shader_ =
+        shader::Shader(shader::kTrimeshShapeShader, defines.str());
+  }
+
+  int num_layers = std::min<int>(max_layers_, views.size());
+  Framebuffer* framebuffer =
+      GetFramebuffer(params.image_width, params.image_height,
+                     params.num_msaa_samples, num_layers);
+  size_t image_size = framebuffer->Size() / num_layers;
+
+  ShaderParams& shader_params = params.shader_params;
+  shader_params.layer_view_projection_mats.assign(num_layers, glm::mat4(1));
+  shader_params.layer_eye_directions.assign(num_layers, glm::vec3(0));
+
+  {
+    float min_z = arma::min(shape.v.row(2));
+    Annotation annotation(min_z, params, line_shader_);
+    shader::TrimeshShapeShaderObject drawable_object(&shape, layered_shader_,
+                                                     params);
+    shader::TrimeshNormalShaderObject drawable_object2(&shape, normal_shader_,
+                                                       params);
+    last_stats.setup_ms += ElapsedMs(start);
+
+    for (size_t first = 0; first < views.size(); first += num_layers) {
+      size_t count = std::min<size_t>(num_layers, views.size() - first);
+
+      start = Clock::now();
+      {
+        profiler::ScopedTimer timer("draw");
+        for (size_t i = 0; i < count; ++i) {
+          SetPose(views[first + i], params);
+          ComputeMatrices(params);
+          shader_params.layer_view_projection_mats[i] =
+              shader_params.projection_mat * shader_params.view_mat *
+              shader_params.model_mat;
+          shader_params.layer_eye_directions[i] = shader_params.eye_direction;
+        }
+        drawable_object.attribs["iNumLayers"].data_int = count;
+
+        // Clears every layer.
+        framebuffer->Bind();
+        framebuffer->Clear(&params.background[0]);
+        drawable_object.Draw(params, false);
+
+        // The line and normal programs do not set gl_Layer.
+        for (size_t i = 0; i < count; ++i) {
+          SetPose(views[first + i], params);
+          ComputeMatrices(params);
+          framebuffer->BindLayer(i);
+          annotation.Draw(params);
+          drawable_object2.Draw(params, false);
+        }
+      }
+      last_stats.draw_ms += ElapsedMs(start);
+
+      Read(framebuffer, [this, &params, first, count,
+                         image_size](const uint8_t* pixels) {
+        for (size_t i = 0; i < count; ++i) {
+          SaveView(params, first + i, pixels + i * image_size);
+        }
+      });
+    }
+  }
+
+  shader_params.layer_view_projection_mats.clear();
+  shader_params.layer_eye_directions.clear();
+}
+
+/**
+ * @brief Draw each view into cpu_pixels_ and save it right away. Grid lines
+ *        and face normal arrows are not drawn.
+ */
+void RenderSession::RenderCpu(const Shape& shape, RenderParams& params,
+                              const std::vector<CameraPose>& views) {
+  cpu_pixels_.resize((size_t)params.image_width * params.image_height * 4);
+  for (size_t i = 0; i < views.size(); ++i) {
+    auto start = Clock::now();
+    {
+      profiler::ScopedTimer timer("draw");
+      SetPose(views[i], params);
+      ComputeMatrices(params);
+      cpu_->Draw(shape, params, cpu_pixels_.data());
+    }
+    last_stats.draw_ms += ElapsedMs(start);
+
+    SaveView(params, i, cpu_pixels_.data());
+  }
+}
+
+/**
+ * @brief Queue an asynchronous readback of \a framebuffer. Time spent saving
+ *        earlier frames from within this call is not counted as readback.
+ */
+void RenderSession::Read(Framebuffer* framebuffer,
+                         AsyncReadback::Callback callback) {
+  auto start = Clock::now();
+  double save_ms = last_stats.save_ms;
+  readback_->Read(framebuffer, callback);
+  last_stats.readback_ms += ElapsedMs(start) - (last_stats.save_ms - save_ms);
+}
+
+/**
+ * @brief Save the image of view \a view_index, or pass it to frame_handler if
+ *        set. The view index is only appended to the filename if
+ *        \a params.views is set.
+ * @param framebuffer The source of \a pixels if it may have aux outputs.
+ */
+void RenderSession::SaveView(const RenderParams& params, size_t view_index,
+                             const uint8_t* pixels, Framebuffer* framebuffer) {
+  auto start = Clock::now();
+  FrameInfo frame;
+  frame.filename = params.out_filename;
+  if (!params.views.empty())
+    frame.filename = ViewFilename(frame.filename, view_index);
+  frame.width = params.image_width;
+  frame.height = params.image_height;
+  frame.can_overwrite = params.can_overwrite;
+  frame.png_options = params.png_options;
+  frame.job_index = params.job_index;
+  frame.view_index = view_index;
+  if (framebuffer != nullptr && framebuffer->has_aux_outputs()) {
+    frame.depth =
+        (const float*)(pixels + framebuffer->Offset(Framebuffer::kDepth));
+    frame.normals =
+        (const uint16_t*)(pixels + framebuffer->Offset(Framebuffer::kNormal));
+    frame.mask = pixels + framebuffer->Offset(Framebuffer::kMask);
+    frame.near = params.near;
+    frame.far = params.far;
+  }
+
+  if (frame_handler) {
+    frame_handler(frame, pixels);
+  } else {
+    SaveFrame(frame, pixels);
+  }
+  last_stats.save_ms += ElapsedMs(start);
+}
+
+/**
+ * @brief e.g. /path/to/file.png to /path/to/file_003.png
+ * @param filename
+ * @param view_index
+ * @return
+ */
+std::string ViewFilename(const std::string& filename, size_t view_index) {
+  std::stringstream ss;
+  ss << "_" << std::setw(3) << std::setfill('0') << view_index;
+  return io::AppendToFilename(filename, ss.str());
+}
+
+/**
+ * @brief Save the color image of \a frame as a PNG file, and its aux outputs
+ *        if set: linear depth as a float32 (height, width) _depth.npy file,
+ *        normals as a 16-bit RGB _normal.png file and the mask as an 8-bit
+ *        grayscale _mask.png file. The aux files are named after the color
+ *        image, after conflicts with existing files are resolved.
+ * @param frame
+ * @param pixels RGBA color.
+ * @param num_png_threads 0 for the number of cores.
+ */
+void SaveFrame(const FrameInfo& frame, const uint8_t* pixels,
+               int num_png_threads) {
+  std::string filename =
+      io::SaveAsPNG(frame.filename, pixels, frame.width, frame.height,
+                    frame.can_overwrite, frame.png_options, num_png_threads);
+  size_t num_pixels = (size_t)frame.width * frame.height;
+  std::vector<uint8_t> png;
+
+  if (frame.depth != nullptr) {
+    std::vector<float> depth(num_pixels);
+    LinearizeDepth(frame.depth, num_pixels, frame.near, frame.far,
+                   depth.data());
+    fs::path depth_filename = io::AppendToFilename(filename, "_depth");
+    io::SaveAsNpy(depth_filename.replace_extension(".npy").string(),
+                  depth.data(), {(size_t)frame.height, (size_t)frame.width},
+                  io::NpyType::kFloat32);
+  }
+  if (frame.normals != nullptr) {
+    io::EncodePNG(frame.normals, frame.width, frame.height, 3, 16, png,
+                  frame.png_options, num_png_threads);
+    io::WriteFile(io::AppendToFilename(filename, "_normal"), png);
+  }
+  if (frame.mask != nullptr) {
+    io::EncodePNG(frame.mask, frame.width, frame.height, 1, 8, png,
+                  frame.png_options, num_png_threads);
+    io::WriteFile(io::AppendToFilename(filename, "_mask"), png);
+  }
+}
+
+/**
+ * @brief Convert window-space depth in [0, 1] to the distance from the camera
+ *        plane. Pixels at the far plane, where nothing was drawn, become 0.
+ * @param depth
+ * @param n Number of values.
+ * @param near,far Clipping planes of the perspective projection.
+ * @param out May be the same as \a depth.
+ */
+void LinearizeDepth(const float* depth, size_t n, float near, float far,
+                    float* out) {
+  float a = 2 * near * far;
+  float b = far + near;
+  float c = far - near;
+  for (size_t i = 0; i < n; ++i) {
+    float d = depth[i];
+    out[i] = (d < 1) ? a / (b - (2 * d - 1) * c) : 0;
+  }
+}
+
+void SetPose(const CameraPose& pose, RenderParams& params) {
+  params.r = pose.r;
+  params.el = pose.el;
+  params.az = pose.az;
+  params.up_angle = pose.up_angle;
+}
+}
@@ -0,0 +1,131 @@
+/**
+ * @file render_session.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <stdint.h>
+#include <tuple>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "shape.h"
+#include "cpu_rasterizer.h"
+#include "graphics.h"
+#include "framebuffer.h"
+#include "gpu_timer.h"
+#include "headless.h"
+#include "readback.h"
+
+namespace librender {
+
+/**
+ * @brief Wall-clock time spent in each step of the most recent job, in
+ *        milliseconds.
+ */
+struct RenderStats {
+  double setup_ms = 0;     // VAO uploads, annotation, framebuffer binding
+  double draw_ms = 0;      // draw call submission
+  double readback_ms = 0;  // MSAA resolve and waiting for pixel transfers
+  double save_ms = 0;      // PNG encoding and writing, or frame_handler
+  size_t num_views = 0;
+};
+
+/**
+ * @brief Where and how a rendered image is to be saved.
+ */
+struct FrameInfo {
+  std::string filename;
+  int width, height;
+  bool can_overwrite;
+  io::PngOptions png_options;
+  size_t job_index;
+  size_t view_index;
+
+  // Set if the job has aux outputs, and only valid as long as the pixels are.
+  // Window-space depth in [0, 1], 16-bit view-space normals mapped from
+  // [-1, 1] to [0, 65535], and 255 where the mesh covers the pixel.
+  const float* depth = nullptr;
+  const uint16_t* normals = nullptr;
+  const uint8_t* mask = nullptr;
+  // Clipping planes for linearizing depth.
+  float near = 0, far = 0;
+};
+
+// Receives the RGBA pixels of one view, from the bottom left corner. The
+// pointer is only valid until the handler returns.
+typedef std::function<void(const FrameInfo&, const uint8_t* pixels)>
+    FrameHandler;
+
+/**
+ * @brief Off-screen renderer that keeps one GL context, the compiled shader
+ *        programs and a framebuffer per image size alive across jobs. The
+ *        context is headless if EGL is available, so no display server is
+ *        needed. With config::backend set to "cpu", no GL context is created
+ *        and images are drawn by a CpuRasterizer instead.
+ */
+class RenderSession {
+ public:
+  RenderSession(const RenderParams& params);
+  ~RenderSession();
+
+  void Render(const Shape& shape, RenderParams& params);
+
+  RenderStats last_stats;
+
+  // If set, called with every image instead of saving it as a PNG file.
+  FrameHandler frame_handler;
+
+ private:
+  Framebuffer* GetFramebuffer(int width, int height, int num_msaa_samples,
+                              int num_layers, bool has_aux_outputs = false);
+  int MaxLayers();
+  void DestroyContext();
+  void RenderViews(const Shape& shape, RenderParams& params,
+                   const std::vector<CameraPose>& views);
+  void RenderLayered(const Shape& shape, RenderParams& params,
+                     const std::vector<CameraPose>& views);
+  void RenderCpu(const Shape& shape, RenderParams& params,
+                 const std::vector<CameraPose>& views);
+  void Read(Framebuffer* framebuffer, AsyncReadback::Callback callback);
+  void SaveView(const RenderParams& params, size_t view_index,
+                const uint8_t* pixels, Framebuffer* framebuffer = nullptr);
+
+  // Geometry shader output components per vertex of the layered program.
+  static const int kLayerVertexComponents = 20;
+  static const int kMaxLayers = 32;
+  static const int kNumReadbackBuffers = 2;
+
+  // Exactly one of these owns the context.
+  HeadlessContext* headless_ = nullptr;
+  GLFWwindow* window_ = nullptr;
+  GLuint shape_shader_ = 0, normal_shader_ = 0, line_shader_ = 0;
+  // Compiled on first use, for max_layers_ layers.
+  GLuint layered_shader_ = 0;
+  int max_layers_ = 0;
+  AsyncReadback* readback_ = nullptr;
+  // Set if profiler::is_gpu_enabled.
+  GpuTimer* gpu_timer_ = nullptr;
+
+  // Keyed by (width, height, num_msaa_samples, num_layers, has_aux_outputs).
+  std::map<std::tuple<int, int, int, int, bool>, Framebuffer*> framebuffers_;
+
+  // Set instead of all of the above if the cpu backend is used.
+  CpuRasterizer* cpu_ = nullptr;
+  std::vector<uint8_t> cpu_pixels_;
+};
+
+std::string ViewFilename(const std::string& filename, size_t view_index);
+void SaveFrame(const FrameInfo& frame, const uint8_t* pixels,
+               int num_png_threads = 0);
+void LinearizeDepth(const float* depth, size_t n, float near, float far,
+                    float* out);
+void SetPose(const CameraPose& pose, RenderParams& params);
+}
@@ -11,32 +11,43 @@
 #include <fstream>
 #include <regex>
 #include "debug.h"
+#include "profiler.h"
 
 namespace librender {
 namespace shader {
 
-GLuint Shader(const std::string& shader_source) {
-  return ShaderFromSource(shader_source);
+/**
+ * @brief Compile and link a program from a combined GLSL source.
+ * @param shader_source Source containing VERTEX_SHADER, GEOMETRY_SHADER and
+ *        FRAGMENT_SHADER sections.
+ * @param defines Extra preprocessor lines inserted after the shader name
+ *        define, e.g. "#define NUM_LAYERS 8".
+ * @return Program ID.
+ */
+GLuint Shader(const std::string& shader_source, const std::string& defines) {
+  return ShaderFromSource(shader_source, defines);
 }
 
-GLuint ShaderFromSource(const std::string& shader_source) {
+GLuint ShaderFromSource(const std::string& shader_source,
+                        const std::string& defines) {
+  profiler::ScopedTimer timer("compile");
   GLuint program_id = glCreateProgram();
 
   GLuint vertex_shader_id = 0, geometry_shader_id = 0, fragment_shader_id = 0;
 
   if (shader_source.find("#ifdef VERTEX_SHADER") != std::string::npos) {
     vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
-    Compile(vertex_shader_id, shader_source, "VERTEX_SHADER");
+    Compile(vertex_shader_id, shader_source, "VERTEX_SHADER", defines);
     glAttachShader(program_id, vertex_shader_id);
   }
   if (shader_source.find("#ifdef GEOMETRY_SHADER") != std::string::npos) {
     geometry_shader_id = glCreateShader(GL_GEOMETRY_SHADER);
-    Compile(geometry_shader_id, shader_source, "GEOMETRY_SHADER");
+    Compile(geometry_shader_id, shader_source, "GEOMETRY_SHADER", defines);
     glAttachShader(program_id, geometry_shader_id);
   }
   if (shader_source.find("#ifdef FRAGMENT_SHADER") != std::string::npos) {
     fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-    Compile(fragment_shader_id, shader_source, "FRAGMENT_SHADER");
+    Compile(fragment_shader_id, shader_source, "FRAGMENT_SHADER", defines);
     glAttachShader(program_id, fragment_shader_id);
   }
 
@@ -64,10 +75,12 @@ GLuint ShaderFromSource(const std::string& shader_source) {
 }
 
 void Compile(GLuint id, const std::string& source_code,
-             const std::string& shader_name) {
+             const std::string& shader_name, const std::string& defines) {
   // Pre-process
+  std::string replacement = shader_name;
+  if (!defines.empty()) replacement += "\n" + defines;
   auto source = std::regex_replace(source_code, std::regex("__SHADER_NAME__"),
-                                   shader_name);
+                                   replacement);
 
   // Compile
   const char* source_ptr = source.c_str();
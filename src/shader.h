@@ -50,12 +50,14 @@ class ShaderProperties {
 
 namespace shader {
 
-GLuint Shader(const std::string& shader_source);
+GLuint Shader(const std::string& shader_source,
+              const std::string& defines = "");
 
 void ReadFromFile(const std::string& filename, std::string& content);
 void Compile(GLuint id, const std::string& source_code,
-             const std::string& shader_name);
-GLuint ShaderFromSource(const std::string& shader_source);
+             const std::string& shader_name, const std::string& defines = "");
+GLuint ShaderFromSource(const std::string& shader_source,
+                        const std::string& defines = "");
 
 static std::vector<GLuint> shader_ids;
 }
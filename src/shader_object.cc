@@ -9,6 +9,7 @@
 #include "shader_object.h"
 
 #include <exception>
+#include <stdint.h>
 #include <armadillo>
 #include <vector>
 #include <boost/algorithm/string.hpp>
@@ -16,6 +17,8 @@
 #include "graphics.h"
 #include "databuffer.h"
 #include "matrix_util.h"
+#include "gpu_timer.h"
+#include "profiler.h"
 #include "debug.h"
 
 namespace librender {
@@ -23,9 +26,25 @@ namespace shader {
 
 /**
  * @brief Copy data to data buffers and attach them to the vertex array object.
+ * @param format kSeparate if UpdateVAO() will be used.
  */
-void ShaderObject::SetupVAO(const Shape* shape) {
+void ShaderObject::SetupVAO(const Shape* shape, VertexFormat format) {
+  profiler::ScopedTimer timer("upload");
   glBindVertexArray(vertex_array_id);
+  vertex_format = format;
+
+  if (format != VertexFormat::kSeparate) {
+    PackedVertices packed;
+    PackVertices(*shape, format == VertexFormat::kQuantized, packed);
+    position_buffer = new VertexAttribBuffer(
+        GL_ARRAY_BUFFER, packed.attribs, packed.stride, packed.data.data(),
+        packed.data.size());
+    position_scale = packed.position_scale;
+    position_offset = packed.position_offset;
+    has_octahedral_normals = packed.has_octahedral_normals;
+    SetupIndexBuffer(shape);
+    return;
+  }
 
   position_buffer = new VertexAttribBuffer(
       GL_ARRAY_BUFFER, DataBufferLocation::kVertex, shape->v.n_rows, GL_FLOAT,
@@ -49,6 +68,13 @@ void ShaderObject::SetupVAO(const Shape* shape) {
         GL_FLOAT, &shape->uv[0], shape->uv.n_elem * sizeof(float));
   }
 
+  SetupIndexBuffer(shape);
+}
+
+/**
+ * @brief Copy the indices of \a shape to the index buffer.
+ */
+void ShaderObject::SetupIndexBuffer(const Shape* shape) {
   GLenum draw_mode;
   switch (shape->type) {
     case ShapeType::kTriangles:
@@ -62,15 +88,28 @@ void ShaderObject::SetupVAO(const Shape* shape) {
       break;
   }
 
-  index_buffer = new IndexBuffer(
-      GL_ELEMENT_ARRAY_BUFFER, draw_mode, shape->ind.n_elem, GL_UNSIGNED_INT,
-      &shape->ind[0], shape->ind.n_elem * sizeof(arma::uword));
+  // Half the size when every vertex can be addressed with 16 bits.
+  const size_t kMaxShortIndexedVertices = 1 << 16;
+  if (shape->v.n_cols <= kMaxShortIndexedVertices) {
+    std::vector<uint16_t> ind(shape->ind.begin(), shape->ind.end());
+    index_buffer = new IndexBuffer(GL_ELEMENT_ARRAY_BUFFER, draw_mode,
+                                   ind.size(), GL_UNSIGNED_SHORT, ind.data(),
+                                   ind.size() * sizeof(uint16_t));
+  } else {
+    index_buffer = new IndexBuffer(
+        GL_ELEMENT_ARRAY_BUFFER, draw_mode, shape->ind.n_elem,
+        GL_UNSIGNED_INT, shape->ind.memptr(),
+        shape->ind.n_elem * sizeof(uint32_t));
+  }
 }
 
 /**
  * @brief Updates the vertex positions and normals.
  */
 void ShaderObject::UpdateVAO(const glm::mat4& mv, const glm::mat3& normal_mat) {
+  if (vertex_format != VertexFormat::kSeparate)
+    throw std::runtime_error("Only separate vertex buffers can be updated.");
+
   if (!shape->v.empty()) {
     auto vertex_view = librender::util::MatMult(mv, shape->v);
     void* data_ptr = vertex_view.memptr();
@@ -102,6 +141,12 @@ void ShaderObject::FillUniformLocations(
       glGetUniformLocation(shader_id, "iVectorModelViewMatrix");
   this->matrices.projection =
       glGetUniformLocation(shader_id, "iProjectionMatrix");
+  this->decoding.position_scale =
+      glGetUniformLocation(shader_id, "iPositionScale");
+  this->decoding.position_offset =
+      glGetUniformLocation(shader_id, "iPositionOffset");
+  this->decoding.has_octahedral_normals =
+      glGetUniformLocation(shader_id, "iHasOctahedralNormals");
 
   for (auto& kv : shader_globals) {
     kv.second.uniform_location =
@@ -119,6 +164,9 @@ ShaderObject::~ShaderObject() {
   if (color_buffer) {
     delete color_buffer;
   }
+  if (texture_buffer) {
+    delete texture_buffer;
+  }
   if (index_buffer) {
     delete index_buffer;
   }
@@ -127,6 +175,7 @@ ShaderObject::~ShaderObject() {
 }
 
 void ShaderObject::Draw(const RenderParams& render_params, bool is_view_space) {
+  ScopedGpuTimer gpu_timer(timer_name);
   glBindVertexArray(this->vertex_array_id);
   glUseProgram(this->shader_id);
 
@@ -162,6 +211,10 @@ void ShaderObject::Draw(const RenderParams& render_params, bool is_view_space) {
                      &render_params.shader_params.projection_mat[0][0]);
   glUniformMatrix3fv(this->matrices.vector_model_view, 1, GL_FALSE,
                      &normal_mat[0][0]);
+  // Not present in every program, in which case these do nothing.
+  glUniform3fv(this->decoding.position_scale, 1, &position_scale[0]);
+  glUniform3fv(this->decoding.position_offset, 1, &position_offset[0]);
+  glUniform1i(this->decoding.has_octahedral_normals, has_octahedral_normals);
 
   for (auto& kv : this->attribs) {
     switch (kv.second.type) {
@@ -172,13 +225,17 @@ void ShaderObject::Draw(const RenderParams& render_params, bool is_view_space) {
         glUniform1f(kv.second.uniform_location, kv.second.data_float);
         break;
       case AttribType::kVec3:
-        glUniform3fv(kv.second.uniform_location, 1,
+        glUniform3fv(kv.second.uniform_location, kv.second.count,
                      (const float*)kv.second.data_pointer);
         break;
       case AttribType::kVec4:
-        glUniform4fv(kv.second.uniform_location, 1,
+        glUniform4fv(kv.second.uniform_location, kv.second.count,
                      (const float*)kv.second.data_pointer);
         break;
+      case AttribType::kMat4:
+        glUniformMatrix4fv(kv.second.uniform_location, kv.second.count,
+                           GL_FALSE, (const float*)kv.second.data_pointer);
+        break;
       default:
         throw std::runtime_error("Unreconized shader attribute type");
         break;
@@ -16,6 +16,7 @@
 #include "databuffer.h"
 #include "shader.h"
 #include "graphics.h"
+#include "vertex_format.h"
 
 namespace librender {
 namespace shader {
@@ -36,18 +37,29 @@ struct ShaderMatrices {
   GLuint vector_model_view;
 };
 
+// Of the decoding parameters of quantized vertices.
+struct VertexDecodingLocations {
+  GLint position_scale;
+  GLint position_offset;
+  GLint has_octahedral_normals;
+};
+
 struct ShaderAttribute {
   ShaderAttribute() = default;
   ShaderAttribute(AttribType type, float data) : type(type), data_float(data){};
   ShaderAttribute(AttribType type, int data) : type(type), data_int(data){};
   ShaderAttribute(AttribType type, void* data)
       : type(type), data_pointer(data){};
+  // Uniform array of \a count elements.
+  ShaderAttribute(AttribType type, void* data, GLsizei count)
+      : type(type), data_pointer(data), count(count){};
 
   AttribType type;
   GLuint uniform_location;
   void* data_pointer;
   int data_int;
   float data_float;
+  GLsizei count = 1;
 };
 
 enum DataBufferLocation {
@@ -70,17 +82,29 @@ class ShaderObject {
 
   const Shape* shape;
 
+  // Pass name in GPU timings.
+  const char* timer_name = "gpu draw";
+
   VertexAttribBuffer* position_buffer = nullptr;
   VertexAttribBuffer* normal_buffer = nullptr;
   VertexAttribBuffer* color_buffer = nullptr;
   VertexAttribBuffer* texture_buffer = nullptr;
   IndexBuffer* index_buffer = nullptr;
 
+  // As uploaded by SetupVAO. Interleaved vertices are all in position_buffer.
+  VertexFormat vertex_format = VertexFormat::kSeparate;
+  glm::vec3 position_scale = glm::vec3(1);
+  glm::vec3 position_offset = glm::vec3(0);
+  bool has_octahedral_normals = false;
+
   ShaderMatrices matrices;
+  VertexDecodingLocations decoding;
   unordered_map<string, ShaderAttribute> attribs;
 
  protected:
-  void SetupVAO(const Shape* shape);
+  void SetupVAO(const Shape* shape,
+                VertexFormat format = VertexFormat::kSeparate);
+  void SetupIndexBuffer(const Shape* shape);
   void UpdateVAO(const glm::mat4& mv, const glm::mat3& normal_mat);
   void FillUniformLocations(const GLuint shader_id,
                             unordered_map<string, ShaderAttribute>& attribs);
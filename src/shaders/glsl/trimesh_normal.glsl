@@ -40,6 +40,10 @@ layout(location = 1) in vec3 VertexNormal;
 layout(location = 2) in vec4 VertexColor;
 layout(location = 3) in vec2 VertexTexCoord;
 
+// Quantized positions. See vertex_format.h.
+uniform vec3 iPositionScale;
+uniform vec3 iPositionOffset;
+
 // Output to the geometry shader
 //-----------------------------------------------------------------------------
 // out VS_GS_VERTEX { // Currently unused
@@ -49,7 +53,7 @@ layout(location = 3) in vec2 VertexTexCoord;
 
 //-----------------------------------------------------------------------------
 void main() {
-    gl_Position = vec4(VertexPosition, 1);
+    gl_Position = vec4(VertexPosition * iPositionScale + iPositionOffset, 1);
 }
 #endif
 #ifdef GEOMETRY_SHADER
@@ -38,6 +38,14 @@ uniform vec4 iEdgeColor;
 const int NumMaxLights = 20;
 uniform Light iLights[NumMaxLights];
 
+// Layered rendering. NUM_LAYERS and NUM_LAYER_VERTICES (3 * NUM_LAYERS) are
+// defined by the application. Each triangle is emitted once per layer.
+#ifdef NUM_LAYERS
+uniform int iNumLayers;
+uniform mat4 iLayerViewProjectionMatrix[NUM_LAYERS];
+uniform vec3 iLayerEyeDirection[NUM_LAYERS];
+#endif
+
 #ifdef VERTEX_SHADER
 // in view space
 layout(location = 0) in vec3 VertexPosition;
@@ -45,20 +53,42 @@ layout(location = 1) in vec3 VertexNormal;
 layout(location = 2) in vec4 VertexColor;
 layout(location = 3) in vec2 VertexTexCoord;
 
+// Quantized vertices. See vertex_format.h.
+uniform vec3 iPositionScale;
+uniform vec3 iPositionOffset;
+uniform bool iHasOctahedralNormals;
+
 out VS_GS_VERTEX {
     vec3 normal;
     vec4 color;
 } vertex_out;
 
+vec3 DecodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(e.yx)) *
+            vec2(e.x < 0.0 ? -1.0 : 1.0, e.y < 0.0 ? -1.0 : 1.0);
+    }
+    return normalize(n);
+}
+
 void main() {
     vertex_out.color = VertexColor;
-    vertex_out.normal = VertexNormal;
-    gl_Position = vec4(VertexPosition, 1);
+    if (iHasOctahedralNormals) {
+        vertex_out.normal = DecodeOctahedral(VertexNormal.xy);
+    } else {
+        vertex_out.normal = VertexNormal;
+    }
+    gl_Position = vec4(VertexPosition * iPositionScale + iPositionOffset, 1);
 }
 #endif
 #ifdef GEOMETRY_SHADER
 layout(triangles) in;
+#ifdef NUM_LAYERS
+layout(triangle_strip, max_vertices=NUM_LAYER_VERTICES) out;
+#else
 layout(triangle_strip, max_vertices=3) out;
+#endif
 
 in VS_GS_VERTEX {
     vec3 normal;
@@ -70,14 +100,10 @@ out GS_FS_VERTEX {
     vec4 color;
     vec3 normal;
     vec3 d;
+    flat int layer;
 } vertex_out;
 
-void main() {
-    vec4 mid[3];
-    mid[0] = (gl_in[1].gl_Position+gl_in[2].gl_Position)/2.0;
-    mid[1] = (gl_in[2].gl_Position+gl_in[0].gl_Position)/2.0;
-    mid[2] = (gl_in[0].gl_Position+gl_in[1].gl_Position)/2.0;
-
+void EmitTriangle(mat4 mvp, int layer) {
     for (int i = 0; i < gl_in.length(); i++) {
         vertex_out.position = gl_in[i].gl_Position;
         vertex_out.normal = vertex_in[i].normal;
@@ -94,12 +120,26 @@ void main() {
         vec3 p = v1;
 
         vertex_out.d[i] = length((a-p)-dot(a-p, n)*n);
+        vertex_out.layer = layer;
 
-        gl_Position = iModelViewProjectionMatrix * vertex_out.position;
+#ifdef NUM_LAYERS
+        gl_Layer = layer;
+#endif
+        gl_Position = mvp * vertex_out.position;
         EmitVertex();
     }
     EndPrimitive();
 }
+
+void main() {
+#ifdef NUM_LAYERS
+    for (int layer = 0; layer < iNumLayers; layer++) {
+        EmitTriangle(iLayerViewProjectionMatrix[layer], layer);
+    }
+#else
+    EmitTriangle(iModelViewProjectionMatrix, 0);
+#endif
+}
 #endif
 #ifdef FRAGMENT_SHADER
 
@@ -108,11 +148,26 @@ in GS_FS_VERTEX {
     vec4 color;
     vec3 normal;
     vec3 d;
+    flat int layer;
 } fragment_in;
 
 layout(location=0) out vec4 FragmentColor;
+// Only written if the framebuffer has attachments for them.
+layout(location=1) out vec4 FragmentNormal;
+layout(location=2) out float FragmentMask;
 
 void main() {
+    // View space normal in [0, 1].
+    FragmentNormal = vec4(
+        normalize(iVectorModelViewMatrix * fragment_in.normal) * 0.5 + 0.5,
+        1.0);
+    FragmentMask = 1.0;
+
+#ifdef NUM_LAYERS
+    vec3 eye_direction = iLayerEyeDirection[fragment_in.layer];
+#else
+    vec3 eye_direction = iEyeDirection;
+#endif
     vec3 normal = normalize(fragment_in.normal);
     vec4 col = vec4(iAmbient, fragment_in.color[3]);
 
@@ -134,7 +189,7 @@ void main() {
              (iLights[i].QuadraticAttenuation * light_dist * light_dist));
 
         if (lambertian > 0.0) {
-            vec3 half_dir = normalize(light_dir + iEyeDirection);
+            vec3 half_dir = normalize(light_dir + eye_direction);
             float spec_angle = max(dot(half_dir, fragment_in.normal), 0.0);
             specular = pow(spec_angle, iShininess) * iStrength;
         }
@@ -1,10 +1,10 @@
 #pragma once
 #include <string>
 
-// Generated from trimesh_shape.glsl on 2015-01-13
+// Generated from trimesh_shape.glsl on 2026-10-18
 namespace librender {
 namespace shader {
 static const std::string kTrimeshShapeShader =
-"#version 330 core\n#define __SHADER_NAME__\nuniform mat4 iModelViewMatrix;uniform mat4 iProjectionMatrix;uniform mat4 iModelViewProjectionMatrix;uniform mat3 iVectorModelViewMatrix;struct Light {bool IsEnabled;vec3 Color;vec3 Position;float ConstantAttenuation;float LinearAttenuation;float QuadraticAttenuation;};uniform vec3 iAmbient;uniform int iNumLights;uniform vec3 iEyeDirection;uniform float iShininess;uniform float iStrength;uniform float iEdgeThickness;uniform vec4 iEdgeColor;const int NumMaxLights = 20;uniform Light iLights[NumMaxLights];\n#ifdef VERTEX_SHADER\nlayout(location = 0) in vec3 VertexPosition;layout(location = 1) in vec3 VertexNormal;layout(location = 2) in vec4 VertexColor;layout(location = 3) in vec2 VertexTexCoord;out VS_GS_VERTEX {vec3 normal;vec4 color;} vertex_out;void main() {vertex_out.color = VertexColor;vertex_out.normal = VertexNormal;gl_Position = vec4(VertexPosition, 1);}\n#endif\n#ifdef GEOMETRY_SHADER\nlayout(triangles) in;layout(triangle_strip, max_vertices=3) out;in VS_GS_VERTEX {vec3 normal;vec4 color;} vertex_in[];out GS_FS_VERTEX {vec4 position;vec4 color;vec3 normal;vec3 d;} vertex_out;void main() {vec4 mid[3];mid[0] = (gl_in[1].gl_Position+gl_in[2].gl_Position)/2.0;mid[1] = (gl_in[2].gl_Position+gl_in[0].gl_Position)/2.0;mid[2] = (gl_in[0].gl_Position+gl_in[1].gl_Position)/2.0;for (int i = 0; i < gl_in.length(); i++) {vertex_out.position = gl_in[i].gl_Position;vertex_out.normal = vertex_in[i].normal;vertex_out.color = vertex_in[i].color;vertex_out.d[(i+1)%3] = vertex_out.d[(i+2)%3] = 0;vec3 v1 = gl_in[i].gl_Position.xyz;vec3 v2 = gl_in[(i+1)%3].gl_Position.xyz;vec3 v3 = gl_in[(i+2)%3].gl_Position.xyz;vec3 n = normalize(v3-v2);vec3 a = v2;vec3 p = v1;vertex_out.d[i] = length((a-p)-dot(a-p, n)*n);gl_Position = iModelViewProjectionMatrix * vertex_out.position;EmitVertex();}EndPrimitive();}\n#endif\n#ifdef FRAGMENT_SHADER\nin GS_FS_VERTEX {vec4 position;vec4 color;vec3 normal;vec3 d;} fragment_in;layout(location=0) out vec4 FragmentColor;void main() {vec3 normal = normalize(fragment_in.normal);vec4 col = vec4(iAmbient, fragment_in.color[3]);for (int i = 0; i < iNumLights; i++) {if (!iLights[i].IsEnabled) {continue;}vec3 light_dir = iLights[i].Position - vec3(fragment_in.position);float light_dist = length(light_dir);light_dir = light_dir / light_dist;float lambertian = max(dot(light_dir, fragment_in.normal), 0.0);float specular = 0.0;float attenuation = 1.0 /(iLights[i].ConstantAttenuation +(iLights[i].LinearAttenuation * light_dist) +(iLights[i].QuadraticAttenuation * light_dist * light_dist));if (lambertian > 0.0) {vec3 half_dir = normalize(light_dir + iEyeDirection);float spec_angle = max(dot(half_dir, fragment_in.normal), 0.0);specular = pow(spec_angle, iShininess) * iStrength;}col += vec4(lambertian * vec3(fragment_in.color) * attenuation +specular * mix(iLights[i].Color, vec3(fragment_in.color), 0.3)* attenuation, 0.0);}float edge_dist = min(min(fragment_in.d[0], fragment_in.d[1]),fragment_in.d[2]) / iEdgeThickness;if (edge_dist > 2.5 || iEdgeThickness < 1e-7) {FragmentColor = col;return;}float edge_intensity = pow(4, -pow(edge_dist, 2));FragmentColor = mix(col, iEdgeColor, edge_intensity);}\n#endif";
+"#version 330 core\n#define __SHADER_NAME__\nuniform mat4 iModelViewMatrix;uniform mat4 iProjectionMatrix;uniform mat4 iModelViewProjectionMatrix;uniform mat3 iVectorModelViewMatrix;struct Light {bool IsEnabled;vec3 Color;vec3 Position;float ConstantAttenuation;float LinearAttenuation;float QuadraticAttenuation;};uniform vec3 iAmbient;uniform int iNumLights;uniform vec3 iEyeDirection;uniform float iShininess;uniform float iStrength;uniform float iEdgeThickness;uniform vec4 iEdgeColor;const int NumMaxLights = 20;uniform Light iLights[NumMaxLights];\n#ifdef NUM_LAYERS\nuniform int iNumLayers;uniform mat4 iLayerViewProjectionMatrix[NUM_LAYERS];uniform vec3 iLayerEyeDirection[NUM_LAYERS];\n#endif\n#ifdef VERTEX_SHADER\nlayout(location = 0) in vec3 VertexPosition;layout(location = 1) in vec3 VertexNormal;layout(location = 2) in vec4 VertexColor;layout(location = 3) in vec2 VertexTexCoord;uniform vec3 iPositionScale;uniform vec3 iPositionOffset;uniform bool iHasOctahedralNormals;out VS_GS_VERTEX {vec3 normal;vec4 color;} vertex_out;vec3 DecodeOctahedral(vec2 e) {vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));if (n.z < 0.0) {n.xy = (1.0 - abs(e.yx)) *vec2(e.x < 0.0 ? -1.0 : 1.0, e.y < 0.0 ? -1.0 : 1.0);}return normalize(n);}void main() {vertex_out.color = VertexColor;if (iHasOctahedralNormals) {vertex_out.normal = DecodeOctahedral(VertexNormal.xy);} else {vertex_out.normal = VertexNormal;}gl_Position = vec4(VertexPosition * iPositionScale + iPositionOffset, 1);}\n#endif\n#ifdef GEOMETRY_SHADER\nlayout(triangles) in;\n#ifdef NUM_LAYERS\nlayout(triangle_strip, max_vertices=NUM_LAYER_VERTICES) out;\n#else\nlayout(triangle_strip, max_vertices=3) out;\n#endif\nin VS_GS_VERTEX {vec3 normal;vec4 color;} vertex_in[];out GS_FS_VERTEX {vec4 position;vec4 color;vec3 normal;vec3 d;flat int layer;} vertex_out;void EmitTriangle(mat4 mvp, int layer) {for (int i = 0; i < gl_in.length(); i++) {vertex_out.position = gl_in[i].gl_Position;vertex_out.normal = vertex_in[i].normal;vertex_out.color = vertex_in[i].color;vertex_out.d[(i+1)%3] = vertex_out.d[(i+2)%3] = 0;vec3 v1 = gl_in[i].gl_Position.xyz;vec3 v2 = gl_in[(i+1)%3].gl_Position.xyz;vec3 v3 = gl_in[(i+2)%3].gl_Position.xyz;vec3 n = normalize(v3-v2);vec3 a = v2;vec3 p = v1;vertex_out.d[i] = length((a-p)-dot(a-p, n)*n);vertex_out.layer = layer;\n#ifdef NUM_LAYERS\ngl_Layer = layer;\n#endif\ngl_Position = mvp * vertex_out.position;EmitVertex();}EndPrimitive();}void main() {\n#ifdef NUM_LAYERS\nfor (int layer = 0; layer < iNumLayers; layer++) {EmitTriangle(iLayerViewProjectionMatrix[layer], layer);}\n#else\nEmitTriangle(iModelViewProjectionMatrix, 0);\n#endif\n}\n#endif\n#ifdef FRAGMENT_SHADER\nin GS_FS_VERTEX {vec4 position;vec4 color;vec3 normal;vec3 d;flat int layer;} fragment_in;layout(location=0) out vec4 FragmentColor;layout(location=1) out vec4 FragmentNormal;layout(location=2) out float FragmentMask;void main() {FragmentNormal = vec4(normalize(iVectorModelViewMatrix * fragment_in.normal) * 0.5 + 0.5,1.0);FragmentMask = 1.0;\n#ifdef NUM_LAYERS\nvec3 eye_direction = iLayerEyeDirection[fragment_in.layer];\n#else\nvec3 eye_direction = iEyeDirection;\n#endif\nvec3 normal = normalize(fragment_in.normal);vec4 col = vec4(iAmbient, fragment_in.color[3]);for (int i = 0; i < iNumLights; i++) {if (!iLights[i].IsEnabled) {continue;}vec3 light_dir = iLights[i].Position - vec3(fragment_in.position);float light_dist = length(light_dir);light_dir = light_dir / light_dist;float lambertian = max(dot(light_dir, fragment_in.normal), 0.0);float specular = 0.0;float attenuation = 1.0 /(iLights[i].ConstantAttenuation +(iLights[i].LinearAttenuation * light_dist) +(iLights[i].QuadraticAttenuation * light_dist * light_dist));if (lambertian > 0.0) {vec3 half_dir = normalize(light_dir + eye_direction);float spec_angle = max(dot(half_dir, fragment_in.normal), 0.0);specular = pow(spec_angle, iShininess) * iStrength;}col += vec4(lambertian * vec3(fragment_in.color) * attenuation +specular * mix(iLights[i].Color, vec3(fragment_in.color), 0.3)* attenuation, 0.0);}float edge_dist = min(min(fragment_in.d[0], fragment_in.d[1]),fragment_in.d[2]) / iEdgeThickness;if (edge_dist > 2.5 || iEdgeThickness < 1e-7) {FragmentColor = col;return;}float edge_intensity = pow(4, -pow(edge_dist, 2));FragmentColor = mix(col, iEdgeColor, edge_intensity);}\n#endif";
 }
 }
\ No newline at end of file
@@ -8,12 +8,17 @@
  */
 #pragma once
 
+#include <stdint.h>
 #include <armadillo>
+#include <memory>
 
 namespace librender {
 using arma::fmat;
 using arma::umat;
 
+// Vertex indices. 32 bits, which GL takes as is.
+typedef arma::Mat<uint32_t> IndexMat;
+
 enum class ShapeType { kTriangles, kLines, kPoints };
 
 struct Shape {
@@ -23,6 +28,10 @@ struct Shape {
   fmat vn;   // vertex normal
   fmat vc;   // vertex color
   fmat uv;   // vertex texture coordinate
-  umat ind;  // index
+  IndexMat ind;  // index
+
+  // Memory that the matrices above may point into, e.g. a mapped cache
+  // file. Released with the last copy of the shape.
+  std::shared_ptr<void> storage;
 };
 }
@@ -0,0 +1,92 @@
+/**
+ * @file simd.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace librender {
+
+#ifdef __SSE2__
+/**
+ * @brief Four floats, or a mask of four lanes as returned by comparisons.
+ */
+struct Float4 {
+  __m128 v;
+
+  Float4(__m128 v) : v(v) {}
+  Float4(float x) : v(_mm_set1_ps(x)) {}
+  Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+  static Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+  void Store(float* p) const { _mm_storeu_ps(p, v); }
+  // One bit per lane of a mask.
+  int Bits() const { return _mm_movemask_ps(v); }
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+inline Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+inline Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline Float4 Select(Float4 mask, Float4 a, Float4 b) {
+  return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+#else
+struct Float4 {
+  float v[4];
+
+  Float4(float x) : v{x, x, x, x} {}
+  Float4(float a, float b, float c, float d) : v{a, b, c, d} {}
+
+  static Float4 Load(const float* p) { return Float4(p[0], p[1], p[2], p[3]); }
+  void Store(float* p) const { std::copy(v, v + 4, p); }
+  int Bits() const {
+    int bits = 0;
+    for (int i = 0; i < 4; ++i) bits |= (v[i] != 0) << i;
+    return bits;
+  }
+};
+
+#define LIBRENDER_FLOAT4_OP(name, expr)              \
+  inline Float4 name(Float4 a, Float4 b) {           \
+    Float4 c(0);                                     \
+    for (int i = 0; i < 4; ++i) c.v[i] = (expr);     \
+    return c;                                        \
+  }
+LIBRENDER_FLOAT4_OP(operator+, a.v[i] + b.v[i])
+LIBRENDER_FLOAT4_OP(operator-, a.v[i] - b.v[i])
+LIBRENDER_FLOAT4_OP(operator*, a.v[i] * b.v[i])
+LIBRENDER_FLOAT4_OP(operator/, a.v[i] / b.v[i])
+LIBRENDER_FLOAT4_OP(operator<, a.v[i] < b.v[i])
+LIBRENDER_FLOAT4_OP(operator>, a.v[i] > b.v[i])
+LIBRENDER_FLOAT4_OP(operator<=, a.v[i] <= b.v[i])
+LIBRENDER_FLOAT4_OP(operator>=, a.v[i] >= b.v[i])
+LIBRENDER_FLOAT4_OP(operator&, a.v[i] && b.v[i])
+// Like SSE, the second operand if either is NaN.
+LIBRENDER_FLOAT4_OP(Min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+LIBRENDER_FLOAT4_OP(Max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+#undef LIBRENDER_FLOAT4_OP
+
+inline Float4 Select(Float4 mask, Float4 a, Float4 b) {
+  Float4 c(0);
+  for (int i = 0; i < 4; ++i) c.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+  return c;
+}
+#endif
+}
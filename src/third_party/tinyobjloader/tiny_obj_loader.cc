@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
 
 #include <string>
 #include <vector>
@@ -39,15 +40,78 @@ struct vertex_index {
   vertex_index(int vidx, int vtidx, int vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {};
 
 };
-// for std::map
-static inline bool operator<(const vertex_index& a, const vertex_index& b)
-{
-  if (a.v_idx != b.v_idx) return (a.v_idx < b.v_idx);
-  if (a.vn_idx != b.vn_idx) return (a.vn_idx < b.vn_idx);
-  if (a.vt_idx != b.vt_idx) return (a.vt_idx < b.vt_idx);
+// Open-addressing hash table from face corners to the vertices made for them.
+// Its capacity is reserved up front; std::map spent most of the load time on
+// node allocations and tree walks.
+class VertexCache {
+public:
+  explicit VertexCache(size_t expected_size) : size_(0)
+  {
+    size_t capacity = 16;
+    while (capacity < 2 * expected_size) capacity *= 2;
+    slots_.resize(capacity);
+  }
 
-  return false;
-}
+  // Returns true and sets idx if i is cached.
+  bool find(const vertex_index& i, unsigned int& idx) const
+  {
+    size_t mask = slots_.size() - 1;
+    for (size_t k = hash(i) & mask; slots_[k].idx != kEmpty; k = (k + 1) & mask) {
+      const Slot& slot = slots_[k];
+      if (slot.v_idx == i.v_idx && slot.vt_idx == i.vt_idx && slot.vn_idx == i.vn_idx) {
+        idx = slot.idx;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // i must not be cached yet.
+  void insert(const vertex_index& i, unsigned int idx)
+  {
+    if (2 * (size_ + 1) > slots_.size()) grow();
+    size_t mask = slots_.size() - 1;
+    size_t k = hash(i) & mask;
+    while (slots_[k].idx != kEmpty) k = (k + 1) & mask;
+    Slot slot = {i.v_idx, i.vt_idx, i.vn_idx, idx};
+    slots_[k] = slot;
+    size_++;
+  }
+
+private:
+  static const unsigned int kEmpty = ~0u;
+
+  struct Slot {
+    int v_idx, vt_idx, vn_idx;
+    unsigned int idx;
+    Slot() : v_idx(0), vt_idx(0), vn_idx(0), idx(kEmpty) {}
+    Slot(int v, int vt, int vn, unsigned int i) : v_idx(v), vt_idx(vt), vn_idx(vn), idx(i) {}
+  };
+
+  static size_t hash(const vertex_index& i)
+  {
+    unsigned long long h = (unsigned int)i.v_idx * 0x9E3779B97F4A7C15ull;
+    h ^= ((unsigned long long)(unsigned int)i.vt_idx << 32 | (unsigned int)i.vn_idx) * 0xC2B2AE3D27D4EB4Full;
+    return (size_t)(h ^ (h >> 29));
+  }
+
+  void grow()
+  {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    size_t mask = slots_.size() - 1;
+    for (size_t j = 0; j < old.size(); j++) {
+      if (old[j].idx == kEmpty) continue;
+      vertex_index i(old[j].v_idx, old[j].vt_idx, old[j].vn_idx);
+      size_t k = hash(i) & mask;
+      while (slots_[k].idx != kEmpty) k = (k + 1) & mask;
+      slots_[k] = old[j];
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_;
+};
 
 struct obj_shape {
   std::vector<float> v;
@@ -163,7 +227,7 @@ static vertex_index parseTriple(
 
 static unsigned int
 updateVertex(
-  std::map<vertex_index, unsigned int>& vertexCache,
+  VertexCache& vertexCache,
   std::vector<float>& positions,
   std::vector<float>& normals,
   std::vector<float>& texcoords,
@@ -172,11 +236,10 @@ updateVertex(
   const std::vector<float>& in_texcoords,
   const vertex_index& i)
 {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
-
-  if (it != vertexCache.end()) {
+  unsigned int cached;
+  if (vertexCache.find(i, cached)) {
     // found cache
-    return it->second;
+    return cached;
   }
 
   assert(in_positions.size() > (unsigned int) (3*i.v_idx+2));
@@ -197,7 +260,7 @@ updateVertex(
   }
 
   unsigned int idx = positions.size() / 3 - 1;
-  vertexCache[i] = idx;
+  vertexCache.insert(i, idx);
 
   return idx;
 }
@@ -225,19 +288,27 @@ void InitMaterial(material_t& material) {
 static bool
 exportFaceGroupToShape(
   shape_t& shape,
-  std::map<vertex_index, unsigned int> vertexCache,
   const std::vector<float> &in_positions,
   const std::vector<float> &in_normals,
   const std::vector<float> &in_texcoords,
   const std::vector<std::vector<vertex_index> >& faceGroup,
   const int material_id,
-  const std::string &name,
-  bool clearCache)
+  const std::string &name)
 {
   if (faceGroup.empty()) {
     return false;
   }
 
+  // Reserve for the worst case, where no corner is shared, but not more than
+  // the distinct positions would need when each has a single vt/vn.
+  size_t numTriangles = 0;
+  for (size_t i = 0; i < faceGroup.size(); i++) {
+    if (faceGroup[i].size() >= 3) numTriangles += faceGroup[i].size() - 2;
+  }
+  VertexCache vertexCache(std::min(3 * numTriangles, in_positions.size() / 3));
+  shape.mesh.indices.reserve(shape.mesh.indices.size() + 3 * numTriangles);
+  shape.mesh.material_ids.reserve(shape.mesh.material_ids.size() + numTriangles);
+
   // Flatten vertices and indices
   for (size_t i = 0; i < faceGroup.size(); i++) {
     const std::vector<vertex_index>& face = faceGroup[i];
@@ -268,9 +339,6 @@ exportFaceGroupToShape(
 
   shape.name = name;
 
-  if (clearCache)
-      vertexCache.clear();
-
   return true;
 
 }
@@ -529,7 +597,6 @@ std::string LoadObj(
 
   // material
   std::map<std::string, int> material_map;
-  std::map<vertex_index, unsigned int> vertexCache;
   int  material = -1;
 
   shape_t shape;
@@ -652,7 +719,7 @@ std::string LoadObj(
     if (token[0] == 'g' && isSpace((token[1]))) {
 
       // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
       if (ret) {
         shapes.push_back(shape);
       }
@@ -685,7 +752,7 @@ std::string LoadObj(
     if (token[0] == 'o' && isSpace((token[1]))) {
 
       // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
       if (ret) {
         shapes.push_back(shape);
       }
@@ -707,7 +774,7 @@ std::string LoadObj(
     // Ignore unknown command.
   }
 
-  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, true);
+  bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
   if (ret) {
     shapes.push_back(shape);
   }
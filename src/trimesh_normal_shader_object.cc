@@ -8,6 +8,8 @@
  */
 #include "trimesh_normal_shader_object.h"
 
+#include "config.h"
+
 namespace librender {
 namespace shader {
 using glm::vec3;
@@ -23,10 +25,12 @@ TrimeshNormalShaderObject::TrimeshNormalShaderObject(
 
   this->shader_id = shader_id;
   this->shape = shape;
+  this->timer_name = "gpu normals";
 
   SetAttributes(render_params, this->attribs);
   FillUniformLocations(shader_id, this->attribs);
-  SetupVAO(shape);
+  SetupVAO(shape, config::is_vertex_quantized ? VertexFormat::kQuantized
+                                              : VertexFormat::kInterleaved);
 };
 
 /**
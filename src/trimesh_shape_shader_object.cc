@@ -8,6 +8,8 @@
  */
 #include "trimesh_shape_shader_object.h"
 
+#include "config.h"
+
 namespace librender {
 namespace shader {
 using glm::vec3;
@@ -23,10 +25,12 @@ TrimeshShapeShaderObject::TrimeshShapeShaderObject(
 
   this->shader_id = shader_id;
   this->shape = shape;
+  this->timer_name = "gpu shape";
 
   SetAttributes(render_params, this->attribs);
   FillUniformLocations(shader_id, this->attribs);
-  SetupVAO(shape);
+  SetupVAO(shape, config::is_vertex_quantized ? VertexFormat::kQuantized
+                                              : VertexFormat::kInterleaved);
 };
 
 /**
@@ -51,6 +55,18 @@ void TrimeshShapeShaderObject::SetAttributes(
       {"iGridColor", {AttribType::kVec4, (void*)&params.grid_color[0]}},
   };
 
+  // Only present in programs compiled with NUM_LAYERS.
+  if (!params.layer_view_projection_mats.empty()) {
+    GLsizei num_layers = params.layer_view_projection_mats.size();
+    attribs["iNumLayers"] = {AttribType::kInt, (int)num_layers};
+    attribs["iLayerViewProjectionMatrix"] = {
+        AttribType::kMat4, (void*)&params.layer_view_projection_mats[0][0][0],
+        num_layers};
+    attribs["iLayerEyeDirection"] = {
+        AttribType::kVec3, (void*)&params.layer_eye_directions[0][0],
+        num_layers};
+  }
+
   for (size_t i = 0; i < kNumMaxLights; i++) {
     string name_prefix = "iLights";
     name_prefix += "[" + std::to_string(i) + "].";
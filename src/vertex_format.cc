@@ -0,0 +1,213 @@
+/**
+ * @file vertex_format.cc
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string.h>
+#include "shader_object.h"
+
+namespace librender {
+namespace {
+
+using shader::DataBufferLocation;
+
+const float kMaxUnorm16 = 65535;
+const float kMaxSnorm16 = 32767;
+const float kMaxUnorm8 = 255;
+
+float SignNotZero(float x) { return (x < 0) ? -1.0f : 1.0f; }
+
+/**
+ * @brief Append an attribute of \a num_bytes bytes to the layout of \a packed.
+ *        Attributes start at multiples of 4 bytes.
+ */
+void AddAttrib(GLuint index, GLint size, GLenum gl_type,
+               GLboolean is_normalized, size_t num_bytes,
+               PackedVertices& packed) {
+  packed.attribs.push_back(
+      {index, size, gl_type, is_normalized, (size_t)packed.stride});
+  packed.stride += (num_bytes + 3) / 4 * 4;
+}
+
+/**
+ * @brief Copy the float columns of \a mat into the attribute at \a offset.
+ */
+void PackFloats(const arma::fmat& mat, size_t offset, PackedVertices& packed) {
+  size_t num_bytes = mat.n_rows * sizeof(float);
+  uint8_t* out = packed.data.data() + offset;
+  for (size_t i = 0; i < mat.n_cols; ++i, out += packed.stride)
+    memcpy(out, mat.colptr(i), num_bytes);
+}
+}
+
+/**
+ * @brief Interleave the attributes of \a shape, quantized if \a is_quantized.
+ *        Empty attributes are left out.
+ */
+void PackVertices(const Shape& shape, bool is_quantized,
+                  PackedVertices& packed) {
+  packed = PackedVertices();
+  size_t num_vertices = shape.v.n_cols;
+  const arma::fmat* floats[] = {&shape.v, &shape.vn, &shape.vc, &shape.uv};
+  const GLuint kLocations[] = {
+      DataBufferLocation::kVertex, DataBufferLocation::kVertexNormal,
+      DataBufferLocation::kVertexColor, DataBufferLocation::kVertexTexCoord};
+
+  for (const arma::fmat* mat : floats) {
+    if (!mat->empty() && mat->n_cols != num_vertices)
+      throw std::runtime_error("Vertex attributes differ in length.");
+  }
+
+  if (!is_quantized) {
+    std::vector<const arma::fmat*> attribs;
+    for (int i = 0; i < 4; ++i) {
+      if (floats[i]->empty()) continue;
+      AddAttrib(kLocations[i], floats[i]->n_rows, GL_FLOAT, GL_FALSE,
+                floats[i]->n_rows * sizeof(float), packed);
+      attribs.push_back(floats[i]);
+    }
+    packed.data.resize(num_vertices * packed.stride);
+    for (size_t i = 0; i < attribs.size(); ++i)
+      PackFloats(*attribs[i], packed.attribs[i].offset, packed);
+    return;
+  }
+
+  AddAttrib(kLocations[0], 3, GL_UNSIGNED_SHORT, GL_TRUE, 3 * sizeof(uint16_t),
+            packed);
+  size_t normal_offset = packed.stride;
+  if (!shape.vn.empty()) {
+    AddAttrib(kLocations[1], 2, GL_SHORT, GL_TRUE, 2 * sizeof(int16_t),
+              packed);
+    packed.has_octahedral_normals = true;
+  }
+  size_t color_offset = packed.stride;
+  if (!shape.vc.empty()) {
+    AddAttrib(kLocations[2], shape.vc.n_rows, GL_UNSIGNED_BYTE, GL_TRUE,
+              shape.vc.n_rows, packed);
+  }
+  size_t uv_offset = packed.stride;
+  if (!shape.uv.empty()) {
+    AddAttrib(kLocations[3], shape.uv.n_rows, GL_HALF_FLOAT, GL_FALSE,
+              shape.uv.n_rows * sizeof(uint16_t), packed);
+  }
+  packed.data.resize(num_vertices * packed.stride);
+
+  glm::vec3 vmin(0), vmax(0);
+  if (num_vertices > 0) {
+    vmin = vmax = glm::vec3(shape.v(0, 0), shape.v(1, 0), shape.v(2, 0));
+  }
+  for (size_t i = 0; i < num_vertices; ++i) {
+    const float* p = shape.v.colptr(i);
+    for (int k = 0; k < 3; ++k) {
+      vmin[k] = std::min(vmin[k], p[k]);
+      vmax[k] = std::max(vmax[k], p[k]);
+    }
+  }
+  glm::vec3 range = vmax - vmin;
+  glm::vec3 inverse_range;
+  for (int k = 0; k < 3; ++k)
+    inverse_range[k] = (range[k] > 0) ? kMaxUnorm16 / range[k] : 0;
+  packed.position_scale = range;
+  packed.position_offset = vmin;
+
+  uint8_t* out = packed.data.data();
+  for (size_t i = 0; i < num_vertices; ++i, out += packed.stride) {
+    const float* p = shape.v.colptr(i);
+    uint16_t position[3];
+    for (int k = 0; k < 3; ++k) {
+      float q = (p[k] - vmin[k]) * inverse_range[k];
+      position[k] = (uint16_t)std::lround(std::min(q, kMaxUnorm16));
+    }
+    memcpy(out, position, sizeof(position));
+
+    if (!shape.vn.empty()) {
+      int16_t normal[2];
+      EncodeOctahedral(shape.vn.colptr(i), normal);
+      memcpy(out + normal_offset, normal, sizeof(normal));
+    }
+    for (size_t k = 0; k < shape.vc.n_rows; ++k) {
+      float c = std::min(std::max(shape.vc(k, i), 0.0f), 1.0f);
+      out[color_offset + k] = (uint8_t)std::lround(c * kMaxUnorm8);
+    }
+    for (size_t k = 0; k < shape.uv.n_rows; ++k) {
+      uint16_t uv = FloatToHalf(shape.uv(k, i));
+      memcpy(out + uv_offset + k * sizeof(uv), &uv, sizeof(uv));
+    }
+  }
+}
+
+/**
+ * @brief Map a unit vector onto the octahedron |x| + |y| + |z| = 1, unfold the
+ *        lower half over the upper one and store x and y as 16-bit snorm. The
+ *        error is below 1e-4 radians. Zero, infinite and NaN normals become
+ *        (0, 0, 1).
+ * @param[in] normal 3 floats
+ * @param[out] encoded 2 values
+ */
+void EncodeOctahedral(const float* normal, int16_t* encoded) {
+  float l1 = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+  // Tested on the bits, since -Ofast lets the compiler assume that floats are
+  // finite and drop comparisons with NaN and infinity.
+  uint32_t bits;
+  memcpy(&bits, &l1, sizeof(bits));
+  if ((bits & 0x7fffffff) == 0 || (bits & 0x7fffffff) >= 0x7f800000) {
+    encoded[0] = encoded[1] = 0;
+    return;
+  }
+  float x = normal[0] / l1, y = normal[1] / l1;
+  if (normal[2] < 0) {
+    float folded_x = (1 - std::abs(y)) * SignNotZero(x);
+    y = (1 - std::abs(x)) * SignNotZero(y);
+    x = folded_x;
+  }
+  encoded[0] = (int16_t)std::lround(x * kMaxSnorm16);
+  encoded[1] = (int16_t)std::lround(y * kMaxSnorm16);
+}
+
+/**
+ * @brief Inverse of EncodeOctahedral(), as done by the shaders.
+ * @return Unit vector.
+ */
+glm::vec3 DecodeOctahedral(const int16_t* encoded) {
+  float x = std::max(encoded[0] / kMaxSnorm16, -1.0f);
+  float y = std::max(encoded[1] / kMaxSnorm16, -1.0f);
+  glm::vec3 n(x, y, 1 - std::abs(x) - std::abs(y));
+  if (n.z < 0) {
+    n.x = (1 - std::abs(y)) * SignNotZero(x);
+    n.y = (1 - std::abs(x)) * SignNotZero(y);
+  }
+  return glm::normalize(n);
+}
+
+/**
+ * @brief Round \a value to the nearest IEEE half float, ties to even.
+ */
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t magnitude = bits & 0x7fffffff;
+
+  // Infinity and NaN, which stays quiet.
+  if (magnitude >= 0x7f800000)
+    return sign | 0x7c00 | ((magnitude > 0x7f800000) ? 0x200 : 0);
+  // 65520 and above round to infinity.
+  if (magnitude >= 0x477ff000) return sign | 0x7c00;
+  // Below 2^-14, in units of 2^-24. 1024 is the smallest normal half.
+  if (magnitude < 0x38800000)
+    return sign | (uint16_t)std::nearbyint(std::abs(value) * 16777216.0f);
+
+  // Rebias the exponent from 127 to 15 and round off 13 mantissa bits.
+  uint32_t half = magnitude - 0x38000000;
+  half += 0xfff + ((half >> 13) & 1);
+  return sign | (uint16_t)(half >> 13);
+}
+}
@@ -0,0 +1,54 @@
+/**
+ * @file vertex_format.h
+ * @author Daeyun Shin <daeyun@dshin.org>
+ * @version 0.1
+ * @date 2026-10-18
+ * @copyright librender is free software released under the BSD 2-Clause
+ * license.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "databuffer.h"
+#include "shape.h"
+
+namespace librender {
+
+/**
+ * @brief How the vertices of a shape are laid out in GL buffers.
+ */
+enum class VertexFormat {
+  // One float buffer per attribute, as UpdateVAO expects.
+  kSeparate,
+  // Float attributes of each vertex next to each other in one buffer.
+  kInterleaved,
+  // kInterleaved at 20 instead of 48 bytes per vertex: 16-bit positions
+  // within the bounding box, octahedral normals in 2 x 16 bits, RGBA8 colors
+  // and half float texture coordinates.
+  kQuantized
+};
+
+/**
+ * @brief Interleaved vertices of a shape, ready for upload. Shaders recover
+ *        the model space position as position * position_scale +
+ *        position_offset, and decode the normal if has_octahedral_normals.
+ */
+struct PackedVertices {
+  std::vector<uint8_t> data;
+  GLsizei stride = 0;
+  std::vector<VertexAttrib> attribs;
+
+  glm::vec3 position_scale = glm::vec3(1);
+  glm::vec3 position_offset = glm::vec3(0);
+  bool has_octahedral_normals = false;
+};
+
+void PackVertices(const Shape& shape, bool is_quantized,
+                  PackedVertices& packed);
+
+void EncodeOctahedral(const float* normal, int16_t* encoded);
+glm::vec3 DecodeOctahedral(const int16_t* encoded);
+uint16_t FloatToHalf(float value);
+}
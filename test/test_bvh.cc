@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include "bvh.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+namespace {
+
+const float kInfinity = std::numeric_limits<float>::infinity();
+
+float Random() { return rand() / (float)RAND_MAX * 2 - 1; }
+
+// Small triangles scattered in [-1, 1]^3.
+std::vector<float> RandomTriangles(size_t n) {
+  std::vector<float> triangles(9 * n);
+  for (size_t i = 0; i < n; ++i) {
+    float center[3] = {Random(), Random(), Random()};
+    for (int j = 0; j < 9; ++j)
+      triangles[9 * i + j] = center[j % 3] + Random() * 0.1f;
+  }
+  return triangles;
+}
+
+// Reference Moeller-Trumbore, in double.
+bool Hits(const float* v, const float* o, const float* d, double& t) {
+  double e1[3], e2[3], s[3], p[3], q[3];
+  for (int k = 0; k < 3; ++k) {
+    e1[k] = v[3 + k] - v[k];
+    e2[k] = v[6 + k] - v[k];
+    s[k] = o[k] - v[k];
+  }
+  auto cross = [](const double* a, const double* b, double* c) {
+    c[0] = a[1] * b[2] - a[2] * b[1];
+    c[1] = a[2] * b[0] - a[0] * b[2];
+    c[2] = a[0] * b[1] - a[1] * b[0];
+  };
+  auto dot = [](const double* a, const double* b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  };
+  double dd[3] = {d[0], d[1], d[2]};
+  cross(dd, e2, p);
+  double det = dot(e1, p);
+  if (det == 0) return false;
+  double u = dot(s, p) / det;
+  cross(s, e1, q);
+  double w = dot(dd, q) / det;
+  t = dot(e2, q) / det;
+  return u > 0 && w > 0 && u + w < 1;
+}
+}
+
+TEST(Bvh, MatchesBruteForce) {
+  srand(5);
+  const size_t n = 20000;
+  std::vector<float> triangles = RandomTriangles(n);
+  Bvh bvh;
+  bvh.Build(triangles.data(), n);
+  EXPECT_EQ(n, bvh.NumTriangles());
+  Bvh serial;
+  serial.Build(triangles.data(), n, 1);
+
+  std::vector<Bvh::Hit> hits;
+  for (int i = 0; i < 200; ++i) {
+    float origin[3] = {Random() * 2, Random() * 2, Random() * 2};
+    float direction[3] = {Random(), Random(), Random()};
+    // Some rays are parallel to an axis.
+    if (i % 4 == 0) direction[i % 3] = direction[(i + 1) % 3] = 0;
+
+    std::vector<int> expected;
+    double closest_t = kInfinity;
+    int closest = -1;
+    for (size_t j = 0; j < n; ++j) {
+      double t;
+      if (!Hits(&triangles[9 * j], origin, direction, t)) continue;
+      expected.push_back(j);
+      if (t > 0 && t < closest_t) {
+        closest_t = t;
+        closest = j;
+      }
+    }
+
+    bvh.Intersect(origin, direction, -kInfinity, kInfinity, hits);
+    std::vector<int> actual;
+    for (const Bvh::Hit& hit : hits) actual.push_back(hit.triangle);
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(expected, actual) << i;
+
+    serial.Intersect(origin, direction, -kInfinity, kInfinity, hits);
+    actual.clear();
+    for (const Bvh::Hit& hit : hits) actual.push_back(hit.triangle);
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(expected, actual) << i;
+
+    Bvh::IntersectEach(triangles.data(), n, origin, direction, -kInfinity,
+                       kInfinity, hits);
+    actual.clear();
+    for (const Bvh::Hit& hit : hits) actual.push_back(hit.triangle);
+    EXPECT_EQ(expected, actual) << i;
+
+    Bvh::Hit hit;
+    EXPECT_EQ(closest >= 0,
+              bvh.IntersectClosest(origin, direction, 0, kInfinity, hit));
+    EXPECT_EQ(closest, hit.triangle);
+    if (closest >= 0) {
+      EXPECT_NEAR(closest_t, hit.t, 1e-4);
+    }
+  }
+}
+
+TEST(Bvh, Limits) {
+  // Unit triangle in the plane z = 1.
+  float triangle[9] = {0, 0, 1, 1, 0, 1, 0, 1, 1};
+  Bvh bvh;
+  bvh.Build(triangle, 1);
+  float origin[3] = {0.25f, 0.25f, 0};
+  float direction[3] = {0, 0, 2};
+
+  Bvh::Hit hit;
+  ASSERT_TRUE(bvh.IntersectClosest(origin, direction, 0, kInfinity, hit));
+  EXPECT_EQ(0, hit.triangle);
+  EXPECT_FLOAT_EQ(0.5f, hit.t);
+  EXPECT_FALSE(bvh.IntersectClosest(origin, direction, 0, 0.5f, hit));
+  EXPECT_FALSE(bvh.IntersectClosest(origin, direction, 0.5f, 1, hit));
+
+  // Through the edge.
+  float edge[3] = {0.5f, 0.5f, 0};
+  EXPECT_FALSE(bvh.IntersectClosest(edge, direction, 0, kInfinity, hit));
+
+  Bvh empty;
+  empty.Build(nullptr, 0);
+  std::vector<Bvh::Hit> hits(1);
+  empty.Intersect(origin, direction, -kInfinity, kInfinity, hits);
+  EXPECT_TRUE(hits.empty());
+}
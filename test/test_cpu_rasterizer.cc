@@ -0,0 +1,129 @@
+#include <vector>
+#include "cpu_rasterizer.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+// Identity matrices, so that vertex positions are clip coordinates. Without
+// lights or edges, a covered pixel is (0, 0, 0, vertex alpha).
+RenderParams FlatParams(int width, int height, int num_msaa_samples) {
+  RenderParams params;
+  params.image_width = width;
+  params.image_height = height;
+  params.num_msaa_samples = num_msaa_samples;
+  params.background = glm::vec4(1, 1, 1, 0);
+  ShaderParams& shader_params = params.shader_params;
+  shader_params.view_mat = glm::mat4(1);
+  shader_params.projection_mat = glm::mat4(1);
+  shader_params.model_mat = glm::mat4(1);
+  shader_params.eye_direction = glm::vec3(0, 0, 1);
+  shader_params.lights.clear();
+  shader_params.ambient = glm::vec3(0);
+  shader_params.edge_thickness = 0;
+  return params;
+}
+
+// Appends a triangle of the given depth and alpha.
+void AddTriangle(Shape& shape, float x0, float y0, float x1, float y1,
+                 float x2, float y2, float z, float alpha) {
+  const float xy[3][2] = {{x0, y0}, {x1, y1}, {x2, y2}};
+  size_t n = shape.v.n_cols;
+  fmat v = shape.v, vc = shape.vc;
+  IndexMat ind = shape.ind;
+  shape.v.set_size(3, n + 3);
+  shape.vc.set_size(4, n + 3);
+  shape.ind.set_size(3, n / 3 + 1);
+  for (size_t i = 0; i < n; ++i) {
+    for (int j = 0; j < 3; ++j) shape.v(j, i) = v(j, i);
+    for (int j = 0; j < 4; ++j) shape.vc(j, i) = vc(j, i);
+  }
+  for (size_t i = 0; i < n / 3; ++i) {
+    for (int j = 0; j < 3; ++j) shape.ind(j, i) = ind(j, i);
+  }
+  for (int k = 0; k < 3; ++k) {
+    shape.v(0, n + k) = xy[k][0];
+    shape.v(1, n + k) = xy[k][1];
+    shape.v(2, n + k) = z;
+    for (int j = 0; j < 3; ++j) shape.vc(j, n + k) = 0;
+    shape.vc(3, n + k) = alpha;
+    shape.ind(k, n / 3) = n + k;
+  }
+}
+
+std::vector<uint8_t> Draw(const Shape& shape, const RenderParams& params,
+                          int num_threads = 1) {
+  std::vector<uint8_t> pixels(
+      (size_t)params.image_width * params.image_height * 4, 7);
+  CpuRasterizer rasterizer(num_threads);
+  rasterizer.Draw(shape, params, pixels.data());
+  return pixels;
+}
+
+TEST(CpuRasterizer, Background) {
+  Shape shape;
+  shape.type = ShapeType::kTriangles;
+  // Behind the camera and beyond the far plane.
+  AddTriangle(shape, -1, -1, 1, -1, 0, 1, -2, 1);
+  AddTriangle(shape, -1, -1, 1, -1, 0, 1, 2, 1);
+  std::vector<uint8_t> pixels = Draw(shape, FlatParams(70, 130, 4));
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    ASSERT_EQ(255, pixels[i]);
+    ASSERT_EQ(0, pixels[i + 3]);
+  }
+}
+
+TEST(CpuRasterizer, NearerTriangleWins) {
+  for (int order = 0; order < 2; ++order) {
+    Shape shape;
+    shape.type = ShapeType::kTriangles;
+    // Both cover the whole image.
+    float z[2] = {0.5f, -0.5f}, alpha[2] = {0.2f, 1};
+    for (int i = 0; i < 2; ++i) {
+      int k = i ^ order;
+      AddTriangle(shape, -1, -1, 3, -1, -1, 3, z[k], alpha[k]);
+    }
+    std::vector<uint8_t> pixels = Draw(shape, FlatParams(100, 80, 4));
+    for (size_t i = 0; i < pixels.size(); i += 4)
+      ASSERT_EQ(255, pixels[i + 3]);
+  }
+}
+
+TEST(CpuRasterizer, SharedEdge) {
+  // Two halves of a quad covering the image. Pixels along the diagonal must
+  // be fully covered, with no sample falling through to the background.
+  Shape shape;
+  shape.type = ShapeType::kTriangles;
+  AddTriangle(shape, -1, -1, 1, -1, 1, 1, 0, 1);
+  AddTriangle(shape, -1, -1, 1, 1, -1, 1, 0, 1);
+  for (int num_samples : {1, 4, 8}) {
+    std::vector<uint8_t> pixels = Draw(shape, FlatParams(97, 97, num_samples));
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+      ASSERT_EQ(0, pixels[i]);
+      ASSERT_EQ(255, pixels[i + 3]);
+    }
+  }
+
+  // The left half of the image, ending between two columns of pixels.
+  Shape half;
+  half.type = ShapeType::kTriangles;
+  AddTriangle(half, -1, -1, 0, -1, 0, 1, 0, 1);
+  AddTriangle(half, -1, -1, 0, 1, -1, 1, 0, 1);
+  std::vector<uint8_t> pixels = Draw(half, FlatParams(64, 16, 1));
+  for (int y = 0; y < 16; ++y) {
+    for (int x = 0; x < 64; ++x)
+      ASSERT_EQ(x < 32 ? 255 : 0, pixels[(y * 64 + x) * 4 + 3]);
+  }
+}
+
+TEST(CpuRasterizer, SameResultOnAnyNumberOfThreads) {
+  Shape shape;
+  shape.type = ShapeType::kTriangles;
+  for (int i = 0; i < 200; ++i) {
+    float x = -1.2f + 0.013f * i, y = 1.1f - 0.011f * i;
+    AddTriangle(shape, x, y, x + 0.4f, y - 0.3f, x + 0.1f, y + 0.5f,
+                0.005f * (i % 37) - 0.1f, (i % 5 + 1) / 5.0f);
+  }
+  RenderParams params = FlatParams(300, 200, 4);
+  std::vector<uint8_t> expected = Draw(shape, params, 1);
+  EXPECT_TRUE(Draw(shape, params, 3) == expected);
+}
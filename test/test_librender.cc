@@ -0,0 +1,39 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "config.h"
+#include "librender.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+namespace fs = boost::filesystem;
+
+TEST(InitFromMainArgs, PngFilterOfConfigOverridesPreset) {
+  fs::path dir = fs::temp_directory_path() / "librender_test_renderrc";
+  fs::create_directories(dir);
+  std::string config_file = (dir / kConfigFileName).string();
+  std::ofstream(config_file) << "png-filter: none\n";
+
+  // The preset alone would use the Up filter.
+  const char* args[] = {"render", "--config-file", config_file.c_str(),
+                        "--png-compression", "fast", "a.obj"};
+  std::vector<RenderParams> all_params;
+  ASSERT_EQ(0, config::InitFromMainArgs(6, const_cast<char**>(args),
+                                        all_params));
+  ASSERT_EQ(1u, all_params.size());
+  EXPECT_EQ(1, all_params[0].png_options.level);
+  EXPECT_TRUE(all_params[0].png_options.is_rle);
+  EXPECT_EQ(0, all_params[0].png_options.filter);
+
+  // The command line overrides both.
+  const char* filter_args[] = {"render", "--config-file", config_file.c_str(),
+                               "--png-compression", "fast", "--png-filter",
+                               "paeth", "a.obj"};
+  all_params.clear();
+  ASSERT_EQ(0, config::InitFromMainArgs(8, const_cast<char**>(filter_args),
+                                        all_params));
+  EXPECT_EQ(4, all_params[0].png_options.filter);
+
+  fs::remove_all(dir);
+}
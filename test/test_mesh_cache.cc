@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+#include "mesh_cache.h"
+#include "shape.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+namespace fs = boost::filesystem;
+
+namespace {
+
+const std::string kDir = "/tmp/librender_test_mesh_cache";
+
+template <typename T>
+bool IsSame(const arma::Mat<T>& a, const arma::Mat<T>& b) {
+  return a.n_rows == b.n_rows && a.n_cols == b.n_cols &&
+         std::equal(a.begin(), a.end(), b.begin());
+}
+
+Shape MakeShape(int num_vertices) {
+  Shape shape;
+  shape.type = ShapeType::kTriangles;
+  shape.v.set_size(3, num_vertices);
+  shape.vn.set_size(3, num_vertices);
+  shape.vc.set_size(4, num_vertices);
+  shape.ind.set_size(3, num_vertices / 3);
+  for (size_t i = 0; i < shape.v.n_elem; ++i) {
+    shape.v[i] = i * 0.5f;
+    shape.vn[i] = -(float)i;
+  }
+  for (size_t i = 0; i < shape.vc.n_elem; ++i) shape.vc[i] = 1;
+  for (size_t i = 0; i < shape.ind.n_elem; ++i) shape.ind[i] = i;
+  return shape;
+}
+
+RenderParams MakeParams(const std::string& name, const std::string& content) {
+  fs::create_directories(kDir + "/in");
+  RenderParams params;
+  params.in_filename = kDir + "/in/" + name;
+  std::ofstream(params.in_filename) << content;
+  return params;
+}
+
+size_t NumEntries() {
+  size_t count = 0;
+  for (fs::directory_iterator it(kDir), end; it != end; ++it)
+    count += it->path().extension() == ".mesh";
+  return count;
+}
+
+void SetMtime(const std::string& filename, time_t seconds) {
+  struct timespec times[2] = {{seconds, 0}, {seconds, 0}};
+  utimensat(AT_FDCWD, filename.c_str(), times, 0);
+}
+}
+
+TEST(MeshCache, LoadsWhatWasSaved) {
+  fs::remove_all(kDir);
+  MeshCache cache(kDir, 1 << 20);
+  RenderParams params = MakeParams("a.obj", "a");
+  Shape shape = MakeShape(30);
+
+  Shape loaded;
+  EXPECT_FALSE(cache.Load(params, loaded));
+  cache.Save(params, shape);
+  ASSERT_TRUE(cache.Load(params, loaded));
+  EXPECT_TRUE(loaded.storage != nullptr);
+  EXPECT_TRUE(IsSame(shape.v, loaded.v));
+  EXPECT_TRUE(IsSame(shape.vn, loaded.vn));
+  EXPECT_TRUE(IsSame(shape.vc, loaded.vc));
+  EXPECT_TRUE(loaded.uv.empty());
+  EXPECT_TRUE(IsSame(shape.ind, loaded.ind));
+  fs::remove_all(kDir);
+}
+
+TEST(MeshCache, MissesWhenInputOrParamsChange) {
+  fs::remove_all(kDir);
+  MeshCache cache(kDir, 1 << 20);
+  RenderParams params = MakeParams("a.obj", "a");
+  cache.Save(params, MakeShape(30));
+
+  Shape loaded;
+  RenderParams other = params;
+  other.up_axis = (params.up_axis == Z) ? Y : Z;
+  EXPECT_FALSE(cache.Load(other, loaded));
+  other = params;
+  other.will_normalize = !params.will_normalize;
+  EXPECT_FALSE(cache.Load(other, loaded));
+
+  MakeParams("a.obj", "changed");
+  EXPECT_FALSE(cache.Load(params, loaded));
+  fs::remove_all(kDir);
+}
+
+TEST(MeshCache, EvictsLeastRecentlyUsed) {
+  fs::remove_all(kDir);
+  RenderParams a = MakeParams("a.obj", "a");
+  RenderParams b = MakeParams("b.obj", "b");
+  RenderParams c = MakeParams("c.obj", "c");
+  MeshCache unbounded(kDir, 1 << 20);
+  unbounded.Save(a, MakeShape(300));
+  unbounded.Save(b, MakeShape(300));
+  for (fs::directory_iterator it(kDir), end; it != end; ++it)
+    SetMtime(it->path().string(), 1000);
+
+  // Used after b.
+  Shape loaded;
+  ASSERT_TRUE(unbounded.Load(a, loaded));
+
+  // Room for two entries.
+  uint64_t entry_size = 0;
+  for (fs::directory_iterator it(kDir), end; it != end; ++it) {
+    if (it->path().extension() == ".mesh")
+      entry_size = std::max<uint64_t>(entry_size, fs::file_size(it->path()));
+  }
+  MeshCache bounded(kDir, 2 * entry_size);
+  bounded.Save(c, MakeShape(300));
+  EXPECT_EQ(2u, NumEntries());
+  EXPECT_TRUE(bounded.Load(a, loaded));
+  EXPECT_FALSE(bounded.Load(b, loaded));
+  EXPECT_TRUE(bounded.Load(c, loaded));
+  fs::remove_all(kDir);
+}
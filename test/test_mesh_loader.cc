@@ -1,3 +1,7 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
 #include "mesh_loader.h"
 #include "shape.h"
 #include "gtest/gtest.h"
@@ -11,4 +15,158 @@ bool is_close(arma::fmat& X, arma::fmat& Y) {
   return false;
 }
 
-TEST(SanityCheck, AlwaysTrue) { EXPECT_TRUE(42); }
\ No newline at end of file
+TEST(SanityCheck, AlwaysTrue) { EXPECT_TRUE(42); }
+
+namespace {
+
+// Unit cube, corner i at the bits of i, with outward triangles.
+void MakeCube(Shape& mesh) {
+  mesh.v.set_size(3, 8);
+  for (int i = 0; i < 8; ++i)
+    for (int k = 0; k < 3; ++k) mesh.v(k, i) = (i >> k) & 1;
+  const uint32_t quads[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+                                {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+  mesh.ind.set_size(3, 12);
+  for (int i = 0; i < 6; ++i) {
+    const uint32_t* q = quads[i];
+    uint32_t faces[2][3] = {{q[0], q[1], q[2]}, {q[0], q[2], q[3]}};
+    for (int j = 0; j < 2; ++j)
+      for (int k = 0; k < 3; ++k) mesh.ind(k, 2 * i + j) = faces[j][k];
+  }
+}
+}
+
+TEST(ComputeNormals, Weighting) {
+  // Vertex 0 is shared by a face in z = 0 and a face in y = 0 with four
+  // times the area, both with a right angle there. Vertex 5 is unused.
+  fmat v(3, 6);
+  const float positions[6][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0},
+                                 {0, 0, 2}, {2, 0, 0}, {5, 5, 5}};
+  for (int i = 0; i < 6; ++i)
+    for (int k = 0; k < 3; ++k) v(k, i) = positions[i][k];
+  IndexMat f(3, 2);
+  const uint32_t faces[2][3] = {{0, 1, 2}, {0, 3, 4}};
+  for (int i = 0; i < 2; ++i)
+    for (int k = 0; k < 3; ++k) f(k, i) = faces[i][k];
+
+  fmat vn;
+  ComputeNormals(v, f, vn, NormalWeighting::kArea);
+  ASSERT_EQ(6u, vn.n_cols);
+  EXPECT_NEAR(0, vn(0, 0), 1e-6);
+  EXPECT_NEAR(4 / std::sqrt(17.0f), vn(1, 0), 1e-6);
+  EXPECT_NEAR(1 / std::sqrt(17.0f), vn(2, 0), 1e-6);
+  EXPECT_NEAR(1, vn(2, 1), 1e-6);
+  EXPECT_NEAR(1, vn(1, 3), 1e-6);
+  for (int k = 0; k < 3; ++k) EXPECT_EQ(0, vn(k, 5));
+
+  ComputeNormals(v, f, vn, NormalWeighting::kAngle);
+  EXPECT_NEAR(0, vn(0, 0), 1e-6);
+  EXPECT_NEAR(std::sqrt(0.5f), vn(1, 0), 1e-6);
+  EXPECT_NEAR(std::sqrt(0.5f), vn(2, 0), 1e-6);
+
+  f(1, 1) = 6;
+  EXPECT_THROW(ComputeNormals(v, f, vn), std::runtime_error);
+}
+
+TEST(ComputeNormals, Cube) {
+  // Each face has a right angle at each of its corners, over one or two
+  // triangles, so only angles give the diagonal.
+  Shape mesh;
+  MakeCube(mesh);
+  ComputeNormals(mesh.v, mesh.ind, mesh.vn, NormalWeighting::kAngle);
+  for (int i = 0; i < 8; ++i)
+    for (int k = 0; k < 3; ++k)
+      EXPECT_NEAR((mesh.v(k, i) - 0.5f) / std::sqrt(0.75f), mesh.vn(k, i),
+                  1e-6);
+}
+
+TEST(ComputeCreasedNormals, Cube) {
+  Shape mesh;
+  MakeCube(mesh);
+  mesh.uv.set_size(2, 8);
+  for (int i = 0; i < 8; ++i) mesh.uv(0, i) = mesh.uv(1, i) = i;
+  Shape original = mesh;
+
+  // Each corner of the cube becomes one vertex per face.
+  ComputeCreasedNormals(kPi / 3, NormalWeighting::kArea, mesh);
+  ASSERT_EQ(24u, mesh.v.n_cols);
+  ASSERT_EQ(24u, mesh.vn.n_cols);
+  ASSERT_EQ(24u, mesh.uv.n_cols);
+  for (int i = 0; i < 12; ++i) {
+    // Axis and side of the face.
+    int axis = 2 - i / 4;
+    float side = (i / 2) % 2 ? 1 : -1;
+    for (int j = 0; j < 3; ++j) {
+      uint32_t vertex = mesh.ind(j, i), old_vertex = original.ind(j, i);
+      for (int k = 0; k < 3; ++k) {
+        EXPECT_EQ(original.v(k, old_vertex), mesh.v(k, vertex));
+        EXPECT_NEAR(k == axis ? side : 0, mesh.vn(k, vertex), 1e-6);
+      }
+      EXPECT_EQ(old_vertex, mesh.uv(0, vertex));
+    }
+  }
+
+  // Nothing to split.
+  mesh = original;
+  ComputeCreasedNormals(kPi, NormalWeighting::kAngle, mesh);
+  ASSERT_EQ(8u, mesh.v.n_cols);
+  for (int i = 0; i < 8; ++i)
+    for (int k = 0; k < 3; ++k)
+      EXPECT_NEAR((mesh.v(k, i) - 0.5f) / std::sqrt(0.75f), mesh.vn(k, i),
+                  1e-6);
+}
+
+TEST(ComputeCreasedNormals, SmoothFan) {
+  // A cone of 64 sides. Neighboring sides meet at less than 6 degrees, and
+  // opposite ones at 90, so the apex is not split.
+  const int kSides = 64;
+  Shape mesh;
+  mesh.v.zeros(3, kSides + 1);
+  mesh.v(2, kSides) = 1;
+  mesh.ind.set_size(3, kSides);
+  for (int i = 0; i < kSides; ++i) {
+    mesh.v(0, i) = std::cos(2 * kPi * i / kSides);
+    mesh.v(1, i) = std::sin(2 * kPi * i / kSides);
+    mesh.ind(0, i) = i;
+    mesh.ind(1, i) = (i + 1) % kSides;
+    mesh.ind(2, i) = kSides;
+  }
+
+  ComputeCreasedNormals(kPi / 6, NormalWeighting::kAngle, mesh);
+  ASSERT_EQ(kSides + 1u, mesh.v.n_cols);
+  EXPECT_NEAR(0, mesh.vn(0, kSides), 1e-6);
+  EXPECT_NEAR(0, mesh.vn(1, kSides), 1e-6);
+  EXPECT_NEAR(1, mesh.vn(2, kSides), 1e-6);
+}
+
+TEST(LoadObj, UpAxisAndNormals) {
+  const std::string filename = "/tmp/librender_test_mesh_loader.obj";
+  std::ofstream(filename) << "v 0 0 0\nv 2 0 0\nv 0 4 0\n"
+                             "vn 0 0 2\nvn 0 0 3\nvn 0 0 4\n"
+                             "vt 0.25 0.75\n"
+                             "f 1/1/1 2/1/2 3/1/3\n";
+  RenderParams params;
+  params.in_filename = filename;
+  params.will_normalize = true;
+  params.up_axis = Y;
+  params.color = arma::fvec({1, 0, 0, 1});
+  Shape mesh;
+  LoadObj(params, mesh);
+  std::remove(filename.c_str());
+
+  // Centered, scaled to a largest side of 1, and then y up becomes z up.
+  const float expected_v[3][3] = {
+      {0, -0.25f, -0.5f}, {0, 0.25f, -0.5f}, {0, -0.25f, 0.5f}};
+  ASSERT_EQ(3u, mesh.v.n_cols);
+  ASSERT_EQ(3u, mesh.vn.n_cols);
+  ASSERT_EQ(3u, mesh.vc.n_cols);
+  for (int i = 0; i < 3; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      EXPECT_FLOAT_EQ(expected_v[i][k], mesh.v(k, i));
+      EXPECT_FLOAT_EQ(k == 0, mesh.vn(k, i));
+    }
+    EXPECT_FLOAT_EQ(0.75f, mesh.uv(0, i));
+    EXPECT_FLOAT_EQ(0.25f, mesh.uv(1, i));
+    EXPECT_FLOAT_EQ(1, mesh.vc(0, i));
+  }
+}
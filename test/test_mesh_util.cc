@@ -1,34 +1,84 @@
 #include "gtest/gtest.h"
 
+#include <set>
+#include <utility>
+#include <igl/slice.h>
 #include "mesh_util.h"
 
 using namespace std;
 using namespace Eigen;
 
-TEST(ComputeAdjacency, Simple) {
+namespace {
+
+// Whether faces that share an edge run along it in opposite directions.
+bool IsConsistentlyOriented(const MatrixX3i& face) {
+  set<pair<int, int>> edges;
+  for (int i = 0; i < face.rows(); ++i) {
+    for (int k = 0; k < 3; ++k) {
+      if (!edges.insert({face(i, k), face(i, (k + 1) % 3)}).second)
+        return false;
+    }
+  }
+  return true;
+}
+}
+
+TEST(ComputeConnectivity, Simple) {
   MatrixX3i face(6, 3);
   face << 0, 1, 2, 1, 2, 3, 2, 3, 4, 5, 6, 7, 6, 7, 8, 9, 10, 11;
 
-  librender::util::Adjacency adj;
-  librender::util::ComputeAdjacency(face, 12, adj);
+  librender::util::Connectivity conn;
+  librender::util::ComputeConnectivity(face, 12, conn);
+
+  EXPECT_EQ(conn.vertex_offsets.size(), 13);
+  EXPECT_EQ(conn.vertex_faces.size(), 18);
+  EXPECT_EQ(conn.NumFaces(), 6);
+  vector<int> faces_of_2(
+      conn.vertex_faces.begin() + conn.vertex_offsets[2],
+      conn.vertex_faces.begin() + conn.vertex_offsets[3]);
+  EXPECT_EQ(faces_of_2, vector<int>({0, 1, 2}));
+
+  // Edge (1, 2) is the first half-edge of face 1 and the second of face 0.
+  EXPECT_EQ(conn.twins[1], 3);
+  EXPECT_EQ(conn.twins[3], 1);
+  EXPECT_EQ(conn.twins[0], -1);
+
+  int neighbors[3];
+  EXPECT_EQ(conn.Neighbors(0, neighbors), 1);
+  EXPECT_EQ(neighbors[0], 1);
+  EXPECT_EQ(conn.Neighbors(1, neighbors), 2);
+  EXPECT_EQ(conn.Neighbors(5, neighbors), 0);
+}
 
-  EXPECT_EQ(adj.v_to_f.size(), 12);
-  EXPECT_EQ(adj.v_to_v.size(), 12);
-  EXPECT_EQ(adj.f_to_f.size(), 6);
-  EXPECT_EQ(*adj.f_to_f[0].begin(), 1);
-  EXPECT_EQ(adj.f_to_f[0].size(), 1);
-  EXPECT_EQ(adj.f_to_f[1].size(), 2);
+TEST(ComputeConnectivity, NonManifold) {
+  // Three faces on edge (0, 1).
+  MatrixX3i face(4, 3);
+  face << 0, 1, 2, 1, 0, 3, 0, 1, 4, 2, 1, 5;
+
+  librender::util::Connectivity conn;
+  librender::util::ComputeConnectivity(face, 6, conn);
+
+  EXPECT_EQ(conn.twins[0], -1);
+  EXPECT_EQ(conn.twins[3], -1);
+  EXPECT_EQ(conn.twins[6], -1);
+  EXPECT_EQ(conn.is_non_manifold[0], 1);
+  EXPECT_EQ(conn.is_non_manifold[3], 1);
+  EXPECT_EQ(conn.is_non_manifold[6], 1);
+  EXPECT_EQ(conn.is_non_manifold[1], 0);
+  // Edge (1, 2) is still manifold.
+  EXPECT_EQ(conn.twins[1], 9);
+  EXPECT_EQ(conn.twins[9], 1);
 }
 
 TEST(FindConnectedComponents, Simple) {
   MatrixX3i face(6, 3);
   face << 0, 1, 2, 1, 2, 3, 2, 3, 4, 5, 6, 7, 6, 7, 8, 9, 10, 11;
 
-  librender::util::Adjacency adj;
-  librender::util::ComputeAdjacency(face, 12, adj);
+  librender::util::Connectivity conn;
+  librender::util::ComputeConnectivity(face, 12, conn);
 
   vector<vector<int>> result;
-  librender::util::FindConnectedComponents(adj, result);
+  librender::util::FindConnectedComponents(conn, result);
 
   EXPECT_EQ(result.size(), 3);
   EXPECT_EQ(result[0].size(), 3);
@@ -94,4 +144,87 @@ TEST(ReorientMeshNormals, Simple) {
 
   Matrix<double, Dynamic, 3> n(u.rows(), 3);
   librender::util::RowwiseCross(u, v, n);
+
+  EXPECT_TRUE(IsConsistentlyOriented(face_out));
+}
+
+TEST(ReorientMeshNormals, ClosedMesh) {
+  // Octahedron around the origin, with every other face flipped.
+  MatrixX3d vertex(6, 3);
+  vertex << 1, 0, 0, -1, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 1, 0, 0, -1;
+  MatrixX3i face(8, 3);
+  face << 0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4, 2, 0, 5, 1, 2, 5, 3, 1, 5,
+      0, 3, 5;
+  for (int i = 0; i < face.rows(); i += 2)
+    librender::util::FlipTriangleOrientation(face, i);
+
+  MatrixX3i face_out(8, 3);
+  librender::util::ReorientMeshNormals(face, vertex, face_out);
+
+  EXPECT_TRUE(IsConsistentlyOriented(face_out));
+  for (int i = 0; i < face_out.rows(); ++i) {
+    RowVector3d a = vertex.row(face_out(i, 0));
+    RowVector3d b = vertex.row(face_out(i, 1));
+    RowVector3d c = vertex.row(face_out(i, 2));
+    EXPECT_GT((b - a).cross(c - a).dot(a + b + c), 0) << i;
+  }
+
+  MatrixX3i face_serial(8, 3);
+  librender::util::ReorientMeshNormals(face, vertex, face_serial, 1);
+  EXPECT_TRUE(face_out == face_serial);
+}
+
+TEST(UnifyNeighborNormals, Strip) {
+  // Strip of four faces that are not consistently oriented.
+  MatrixX3i face(4, 3);
+  face << 0, 1, 2, 1, 2, 3, 3, 4, 2, 3, 4, 5;
+  librender::util::Connectivity conn;
+  librender::util::ComputeConnectivity(face, 6, conn);
+
+  vector<bool> visited(4, false);
+  librender::util::UnifyNeighborNormals(conn, face, 0, visited);
+
+  EXPECT_EQ(visited, vector<bool>(4, true));
+  EXPECT_EQ(face.row(0), RowVector3i(0, 1, 2));
+  EXPECT_TRUE(IsConsistentlyOriented(face));
+}
+
+TEST(FindOneFaceNormal, Deterministic) {
+  // Octahedron around the origin.
+  MatrixX3d vertex(6, 3);
+  vertex << 1, 0, 0, -1, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 1, 0, 0, -1;
+  MatrixX3i face(8, 3);
+  face << 0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4, 2, 0, 5, 1, 2, 5, 3, 1, 5,
+      0, 3, 5;
+
+  int face_index;
+  RowVector3d normal;
+  Matrix<double, 1, 6> line;
+  librender::util::FindOneFaceNormal(vertex, face, face_index, normal, line);
+  ASSERT_GE(face_index, 0);
+  // Outward, as the face center is away from the origin.
+  RowVector3d center = (vertex.row(face(face_index, 0)) +
+                        vertex.row(face(face_index, 1)) +
+                        vertex.row(face(face_index, 2))) /
+                       3;
+  EXPECT_GT(normal.dot(center), 0);
+  EXPECT_NEAR(normal.norm(), 1, 1e-9);
+
+  for (uint32_t seed : {0u, 1u}) {
+    int face_index2;
+    RowVector3d normal2;
+    Matrix<double, 1, 6> line2;
+    librender::util::FindOneFaceNormal(vertex, face, face_index, normal, line,
+                                       seed);
+    librender::util::FindOneFaceNormal(vertex, face, face_index2, normal2,
+                                       line2, seed);
+    EXPECT_EQ(face_index, face_index2);
+    EXPECT_EQ(line, line2);
+  }
+
+  // Too few faces.
+  MatrixX3i one_face = face.topRows(1);
+  librender::util::FindOneFaceNormal(vertex, one_face, face_index, normal,
+                                     line);
+  EXPECT_EQ(face_index, -1);
 }
@@ -0,0 +1,51 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "npy_writer.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+TEST(NpyHeader, AlignedAndParsable) {
+  std::string header = io::NpyHeader({10, 600, 800, 4});
+  EXPECT_EQ(0u, header.size() % 64);
+  EXPECT_EQ(std::string("\x93NUMPY\x01\x00", 8), header.substr(0, 8));
+  EXPECT_EQ(header.size() - 10,
+            (size_t)(uint8_t)header[8] | ((uint8_t)header[9] << 8));
+  EXPECT_NE(std::string::npos, header.find("'shape': (10, 600, 800, 4)"));
+  EXPECT_EQ('\n', header.back());
+}
+
+TEST(NpyWriter, WritesFramesIntoSlots) {
+  std::string filename = "/tmp/librender_test_npy_writer.npy";
+  {
+    io::NpyWriter writer(filename, 3, 2, 2, 4);
+    std::vector<uint8_t> frame(writer.FrameSize());
+    for (size_t slot : {2, 0}) {
+      std::fill(frame.begin(), frame.end(), slot + 1);
+      writer.Write(slot, frame.data());
+    }
+    EXPECT_THROW(writer.Write(3, frame.data()), std::runtime_error);
+  }
+
+  std::ifstream file(filename, std::ios::binary);
+  std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+  size_t header_size = io::NpyHeader({3, 2, 2, 4}).size();
+  ASSERT_EQ(header_size + 3 * 16, contents.size());
+  for (size_t i = 0; i < 16; ++i) {
+    EXPECT_EQ(1, contents[header_size + i]);
+    EXPECT_EQ(0, contents[header_size + 16 + i]);  // never written
+    EXPECT_EQ(3, contents[header_size + 32 + i]);
+  }
+  remove(filename.c_str());
+}
+
+TEST(NpyHeader, Types) {
+  EXPECT_NE(std::string::npos,
+            io::NpyHeader({2, 3}, io::NpyType::kFloat32).find("'<f4'"));
+  EXPECT_NE(std::string::npos,
+            io::NpyHeader({5}, io::NpyType::kUint16).find("(5,)"));
+}
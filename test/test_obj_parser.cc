@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "obj_parser.h"
+#include "third_party/tinyobjloader/tiny_obj_loader.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+namespace {
+
+// Groups of tinyobj, concatenated.
+ObjMesh LoadWithTinyObj(const std::string& text) {
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::istringstream stream(text);
+  tinyobj::MaterialFileReader reader("");
+  EXPECT_EQ("", tinyobj::LoadObj(shapes, materials, stream, reader));
+
+  ObjMesh mesh;
+  for (const tinyobj::shape_t& shape : shapes) {
+    uint32_t offset = mesh.positions.size() / 3;
+    const tinyobj::mesh_t& m = shape.mesh;
+    mesh.positions.insert(mesh.positions.end(), m.positions.begin(),
+                          m.positions.end());
+    mesh.normals.insert(mesh.normals.end(), m.normals.begin(),
+                        m.normals.end());
+    mesh.texcoords.insert(mesh.texcoords.end(), m.texcoords.begin(),
+                          m.texcoords.end());
+    for (unsigned int index : m.indices) mesh.indices.push_back(offset + index);
+  }
+  return mesh;
+}
+
+void ExpectSame(const ObjMesh& expected, const ObjMesh& actual) {
+  EXPECT_EQ(expected.positions, actual.positions);
+  EXPECT_EQ(expected.normals, actual.normals);
+  EXPECT_EQ(expected.texcoords, actual.texcoords);
+  EXPECT_EQ(expected.indices, actual.indices);
+}
+
+// A noisy n by n grid of quads, with every kind of face corner, relative
+// indices, comments, tabs and CRLF line breaks.
+std::string MakeGridObj(int n, int num_groups) {
+  std::ostringstream out;
+  out << "# grid\r\n\n";
+  srand(1);
+  for (int y = 0; y <= n; ++y) {
+    for (int x = 0; x <= n; ++x) {
+      char line[128];
+      snprintf(line, sizeof(line), "v %.9g %.6f\t%g\n", x / (double)n,
+               y * 0.731, (rand() % 1000 - 500) * 1e-5);
+      out << line;
+      out << "vt " << x << "." << y << " " << (y * 0.25) << "\n";
+      out << "  vn 0 0 " << (rand() % 2 ? "1" : "1.0e0") << "\r\n";
+    }
+  }
+  for (int y = 0; y < n; ++y) {
+    if (y % (n / num_groups) == 0) out << "g part" << y << "\n";
+    for (int x = 0; x < n; ++x) {
+      int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+      switch ((x + y) % 4) {
+        case 0:
+          out << "f " << a << " " << b << " " << d << " " << c << "\n";
+          break;
+        case 1:
+          out << "f " << a << "/" << a << " " << b << "/" << b << " " << d
+              << "/" << d << "\n"
+              << "f " << a << "/" << a << " " << d << "/" << d << " " << c
+              << "/" << c << "\n";
+          break;
+        case 2:
+          out << "f " << a << "//" << a << "\t" << b << "//" << b << " " << d
+              << "//" << d << "  " << c << "//" << c << " \r\n";
+          break;
+        default: {
+          int total = (n + 1) * (n + 1);
+          out << "f " << a - total - 1 << "/" << a << "/" << a - total - 1
+              << " " << b << "/" << b - total - 1 << "/" << b << " " << d
+              << "/" << d << "/" << d << "\n";
+          out << "f " << a << " " << d << " " << c << "\n";
+        }
+      }
+    }
+  }
+  out << "# end without a line break";
+  return out.str();
+}
+
+std::string WriteTempFile(const std::string& text) {
+  std::string filename = "/tmp/librender_test_obj_parser.obj";
+  std::ofstream(filename, std::ios::binary) << text;
+  return filename;
+}
+}
+
+TEST(ObjParser, SameAsTinyObj) {
+  std::string text = MakeGridObj(40, 1);
+  ObjMesh expected = LoadWithTinyObj(text);
+  ASSERT_FALSE(expected.indices.empty());
+
+  ObjMesh mesh;
+  ParseObjFile(WriteTempFile(text), 1, mesh);
+  ExpectSame(expected, mesh);
+  std::remove("/tmp/librender_test_obj_parser.obj");
+}
+
+TEST(ObjParser, SameOnAnyNumberOfThreads) {
+  std::string text = MakeGridObj(40, 4);
+  ObjMesh expected = LoadWithTinyObj(text);
+  for (int num_threads : {1, 2, 3, 8, 64}) {
+    ObjMesh mesh;
+    ParseObj(text.data(), text.size(), num_threads, mesh);
+    ExpectSame(expected, mesh);
+  }
+}
+
+TEST(ObjParser, ParseFloatMatchesAtof) {
+  std::vector<std::string> tokens = {
+      "0",        "-0",        "1",       "+2.5",     ".5",     "5.",
+      "-1e-3",    "1E+10",     "3.4e38",  "1e39",     "1e-46",  "0.1",
+      "0.30000000000000004",   "123456789012345678901234", "1.5abc",
+      "abc",      "0x1p3",     "1e",      "-.0000000000000000001"};
+  srand(2);
+  for (int i = 0; i < 1000; ++i) {
+    char token[64];
+    double x = (rand() - RAND_MAX / 2.0) / (1 + rand() % 1000);
+    snprintf(token, sizeof(token), (i % 2) ? "%.9g" : "%f", x);
+    tokens.push_back(token);
+  }
+  for (const std::string& token : tokens) {
+    std::string line = token + " 7";
+    const char* p = line.data();
+    float value = ParseFloat(p, line.data() + line.size());
+    EXPECT_EQ((float)atof(token.c_str()), value) << token;
+    EXPECT_EQ(line.data() + token.size(), p) << token;
+  }
+}
+
+TEST(ObjParser, MissingVertex) {
+  std::string text = "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+  ObjMesh mesh;
+  EXPECT_THROW(ParseObj(text.data(), text.size(), 1, mesh),
+               std::runtime_error);
+}
+
+TEST(ObjParser, HugeIndex) {
+  const char* faces[] = {"f 1 2 99999999999\n", "f 1 2 -99999999999\n",
+                         "f 1 2 4294967298\n", "f -4 -2 -1\n",
+                         "f 1/-9223372036854775808 2 3\n"};
+  for (const char* face : faces) {
+    std::string text = std::string("v 0 0 0\nv 1 0 0\nv 0 1 0\n") + face;
+    ObjMesh mesh;
+    EXPECT_THROW(ParseObj(text.data(), text.size(), 1, mesh),
+                 std::runtime_error);
+  }
+}
+
+TEST(ObjParser, RelativeIndex) {
+  std::string text = "v 0 0 0\nv 1 0 0\nf 1 2 -1\nv 0 1 0\nf -3 -2 -1\n";
+  ObjMesh mesh;
+  ParseObj(text.data(), text.size(), 1, mesh);
+  ASSERT_EQ(6u, mesh.indices.size());
+  EXPECT_EQ(9u, mesh.positions.size());
+  EXPECT_EQ(mesh.indices[1], mesh.indices[2]);
+  EXPECT_EQ(1.0f, mesh.positions[3 * mesh.indices[5] + 1]);
+}
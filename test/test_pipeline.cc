@@ -0,0 +1,54 @@
+#include <thread>
+#include <vector>
+#include "pipeline.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+TEST(BoundedQueue, KeepsOrderAcrossThreads) {
+  BoundedQueue<int> queue(2);
+  std::thread producer([&queue] {
+    for (int i = 0; i < 100; ++i) queue.Push(i);
+    queue.Close();
+  });
+
+  std::vector<int> items;
+  int item;
+  while (queue.Pop(item)) items.push_back(item);
+  producer.join();
+
+  ASSERT_EQ(100u, items.size());
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(i, items[i]);
+
+  QueueStats stats = queue.stats();
+  EXPECT_EQ(100u, stats.num_items);
+  EXPECT_EQ(2u, stats.capacity);
+  EXPECT_LE(stats.max_depth, 2u);
+}
+
+TEST(BoundedQueue, DrainsAfterClose) {
+  BoundedQueue<int> queue(4);
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  queue.Close();
+  EXPECT_FALSE(queue.Push(3));
+
+  int item;
+  EXPECT_TRUE(queue.Pop(item));
+  EXPECT_EQ(1, item);
+  EXPECT_TRUE(queue.Pop(item));
+  EXPECT_EQ(2, item);
+  EXPECT_FALSE(queue.Pop(item));
+}
+
+TEST(DefaultPipelineOptions, BoundsLoadedMeshes) {
+  PipelineOptions options = DefaultPipelineOptions(64);
+  EXPECT_EQ(64, options.num_encoders);
+  EXPECT_LE(options.num_loaders, 2);
+  EXPECT_LE(options.mesh_queue_capacity, 2u);
+  EXPECT_GE(options.num_loader_threads, 1);
+
+  options = DefaultPipelineOptions(1);
+  EXPECT_EQ(1, options.num_loaders);
+  EXPECT_EQ(1, options.num_encoders);
+}
@@ -0,0 +1,79 @@
+#include <random>
+#include <vector>
+#include "png_encoder.h"
+#include "third_party/lodepng/lodepng.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+std::vector<uint8_t> RandomImage(int w, int h, bool is_opaque) {
+  std::mt19937 rng(0);
+  std::vector<uint8_t> rgba((size_t)w * h * 4);
+  for (size_t i = 0; i < rgba.size(); ++i) {
+    // Mostly smooth, with some noise so that every filter type gets used.
+    rgba[i] = (i % 7 == 0) ? rng() % 256 : (i / 4000) % 256;
+    if (is_opaque && i % 4 == 3) rgba[i] = 255;
+  }
+  return rgba;
+}
+
+void ExpectRoundTrip(const std::vector<uint8_t>& rgba, int w, int h,
+                     int num_threads) {
+  std::vector<uint8_t> png, decoded;
+  io::EncodePNG(rgba.data(), w, h, png, io::PngOptions(), num_threads);
+
+  unsigned decoded_w, decoded_h;
+  ASSERT_EQ(0u, lodepng::decode(decoded, decoded_w, decoded_h, png));
+  EXPECT_EQ((unsigned)w, decoded_w);
+  EXPECT_EQ((unsigned)h, decoded_h);
+  EXPECT_TRUE(decoded == rgba);
+}
+
+TEST(EncodePNG, SingleBand) {
+  ExpectRoundTrip(RandomImage(64, 48, false), 64, 48, 1);
+  ExpectRoundTrip(RandomImage(1, 1, true), 1, 1, 1);
+}
+
+TEST(EncodePNG, ManyBands) {
+  // Large enough to be split into 8 bands.
+  ExpectRoundTrip(RandomImage(1001, 703, false), 1001, 703, 8);
+  ExpectRoundTrip(RandomImage(1001, 703, true), 1001, 703, 8);
+}
+
+TEST(EncodePNG, Presets) {
+  std::vector<uint8_t> rgba = RandomImage(1001, 703, true);
+  for (const char* preset : {"store", "fast", "default", "best"}) {
+    std::vector<uint8_t> png, decoded;
+    io::EncodePNG(rgba.data(), 1001, 703, png, io::PngPreset(preset), 4);
+    unsigned w, h;
+    ASSERT_EQ(0u, lodepng::decode(decoded, w, h, png)) << preset;
+    EXPECT_TRUE(decoded == rgba) << preset;
+  }
+  EXPECT_THROW(io::PngPreset("fastest"), std::runtime_error);
+  EXPECT_EQ(io::kAdaptiveFilter, io::PngFilterFromName("adaptive"));
+  EXPECT_EQ(4, io::PngFilterFromName("paeth"));
+}
+
+TEST(EncodePNG, GrayAnd16Bit) {
+  const int w = 301, h = 203;
+  std::vector<uint8_t> gray(w * h);
+  std::vector<uint16_t> rgb16(w * h * 3);
+  for (size_t i = 0; i < gray.size(); ++i) gray[i] = (i % 3 == 0) ? 255 : 0;
+  for (size_t i = 0; i < rgb16.size(); ++i) rgb16[i] = i * 257;
+
+  std::vector<uint8_t> png, decoded;
+  unsigned decoded_w, decoded_h;
+  io::EncodePNG(gray.data(), w, h, 1, 8, png, io::PngOptions(), 4);
+  ASSERT_EQ(0u, lodepng::decode(decoded, decoded_w, decoded_h, png, LCT_GREY,
+                                8));
+  EXPECT_TRUE(decoded == gray);
+
+  // Decoded samples are big-endian.
+  io::EncodePNG(rgb16.data(), w, h, 3, 16, png, io::PngOptions(), 4);
+  decoded.clear();
+  ASSERT_EQ(0u, lodepng::decode(decoded, decoded_w, decoded_h, png, LCT_RGB,
+                                16));
+  ASSERT_EQ(rgb16.size() * 2, decoded.size());
+  for (size_t i = 0; i < rgb16.size(); ++i)
+    ASSERT_EQ(rgb16[i], decoded[2 * i] << 8 | decoded[2 * i + 1]) << i;
+}
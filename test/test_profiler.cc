@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "profiler.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+TEST(Profiler, Percentile) {
+  std::vector<double> values = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(5, profiler::Percentile(values, 0.5));
+  EXPECT_EQ(10, profiler::Percentile(values, 0.95));
+  EXPECT_EQ(1, profiler::Percentile(values, 0));
+  EXPECT_EQ(10, profiler::Percentile(values, 1));
+  EXPECT_EQ(7, profiler::Percentile({7}, 0.95));
+  EXPECT_EQ(0, profiler::Percentile({}, 0.5));
+}
+
+TEST(Profiler, DisabledRecordsNothing) {
+  profiler::Reset();
+  profiler::is_enabled = false;
+  { profiler::ScopedTimer timer("stage"); }
+  EXPECT_TRUE(profiler::AggregateStats().empty());
+}
+
+TEST(Profiler, AggregatesAllThreads) {
+  profiler::Reset();
+  profiler::is_enabled = true;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([i] {
+      profiler::SetThreadName("worker " + std::to_string(i));
+      profiler::SetJob(i);
+      for (int j = 0; j < 10; ++j) {
+        int64_t start = 1000000 * j;
+        profiler::ScopedTimer::Record("a", start, start + 1000000 * (j + 1));
+      }
+      profiler::ScopedTimer::Record("b", 0, 500000);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+
+  std::vector<profiler::StageStats> stats = profiler::AggregateStats();
+  ASSERT_EQ(2u, stats.size());
+  // Slowest first.
+  EXPECT_EQ("a", stats[0].name);
+  EXPECT_EQ(40u, stats[0].count);
+  EXPECT_NEAR(220, stats[0].total_ms, 1e-6);
+  EXPECT_NEAR(5, stats[0].p50_ms, 1e-6);
+  EXPECT_NEAR(10, stats[0].p95_ms, 1e-6);
+  EXPECT_NEAR(10, stats[0].max_ms, 1e-6);
+  EXPECT_EQ("b", stats[1].name);
+  EXPECT_EQ(4u, stats[1].count);
+
+  std::string filename = "/tmp/librender_test_profiler.json";
+  profiler::WriteChromeTrace(filename);
+  std::ifstream file(filename);
+  std::stringstream trace;
+  trace << file.rdbuf();
+  EXPECT_NE(std::string::npos, trace.str().find("\"traceEvents\""));
+  EXPECT_NE(std::string::npos, trace.str().find("\"name\":\"worker 3\""));
+  EXPECT_NE(std::string::npos, trace.str().find("\"args\":{\"job\":2}"));
+
+  remove(filename.c_str());
+
+  profiler::is_enabled = false;
+  profiler::Reset();
+}
@@ -0,0 +1,141 @@
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string.h>
+#include <vector>
+#include "vertex_format.h"
+#include "gtest/gtest.h"
+
+using namespace librender;
+
+namespace {
+
+// Unit vector in the direction of (x, y, z).
+glm::vec3 Direction(float x, float y, float z) {
+  return glm::normalize(glm::vec3(x, y, z));
+}
+
+float Random() { return rand() / (float)RAND_MAX * 2 - 1; }
+}
+
+TEST(VertexFormat, FloatToHalf) {
+  EXPECT_EQ(0x0000, FloatToHalf(0.0f));
+  EXPECT_EQ(0x8000, FloatToHalf(-0.0f));
+  EXPECT_EQ(0x3c00, FloatToHalf(1.0f));
+  EXPECT_EQ(0xc000, FloatToHalf(-2.0f));
+  EXPECT_EQ(0x3555, FloatToHalf(1 / 3.0f));
+  EXPECT_EQ(0x7bff, FloatToHalf(65504.0f));
+  EXPECT_EQ(0x7bff, FloatToHalf(65519.0f));
+  EXPECT_EQ(0x7c00, FloatToHalf(65520.0f));
+  EXPECT_EQ(0xfc00, FloatToHalf(-std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0x7e00, FloatToHalf(std::numeric_limits<float>::quiet_NaN()));
+  // Smallest normal and subnormal.
+  EXPECT_EQ(0x0400, FloatToHalf(std::ldexp(1.0f, -14)));
+  EXPECT_EQ(0x0001, FloatToHalf(std::ldexp(1.0f, -24)));
+  EXPECT_EQ(0x0000, FloatToHalf(std::ldexp(1.0f, -26)));
+  // Ties to even.
+  EXPECT_EQ(0x3c00, FloatToHalf(1 + std::ldexp(1.0f, -11)));
+  EXPECT_EQ(0x3c02, FloatToHalf(1 + 3 * std::ldexp(1.0f, -11)));
+}
+
+TEST(VertexFormat, OctahedralRoundTrip) {
+  std::vector<glm::vec3> normals = {
+      Direction(1, 0, 0),  Direction(-1, 0, 0), Direction(0, 1, 0),
+      Direction(0, -1, 0), Direction(0, 0, 1),  Direction(0, 0, -1),
+      Direction(1, 1, 1),  Direction(-1, 1, -1), Direction(1, -1, -1)};
+  srand(3);
+  for (int i = 0; i < 10000; ++i)
+    normals.push_back(Direction(Random(), Random(), Random()));
+
+  for (const glm::vec3& normal : normals) {
+    int16_t encoded[2];
+    EncodeOctahedral(&normal[0], encoded);
+    glm::vec3 decoded = DecodeOctahedral(encoded);
+    EXPECT_LT(glm::length(normal - decoded), 1e-4f)
+        << normal[0] << " " << normal[1] << " " << normal[2];
+  }
+
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  const float kInfinity = std::numeric_limits<float>::infinity();
+  const float kMax = std::numeric_limits<float>::max();
+  const float invalid[][3] = {{0, 0, 0},      {-0.0f, 0, 0},
+                              {kNaN, 0, 1},   {0, -kInfinity, 0},
+                              {kMax, kMax, 0}, {-kNaN, kNaN, kNaN}};
+  for (const float* normal : invalid) {
+    int16_t encoded[2] = {1, 1};
+    EncodeOctahedral(normal, encoded);
+    EXPECT_EQ(0, encoded[0]) << normal[0] << " " << normal[1];
+    EXPECT_EQ(0, encoded[1]) << normal[0] << " " << normal[1];
+  }
+}
+
+TEST(VertexFormat, Interleaved) {
+  Shape shape;
+  shape.v.set_size(3, 5);
+  shape.vc.set_size(4, 5);
+  for (size_t i = 0; i < shape.v.n_elem; ++i) shape.v[i] = i;
+  for (size_t i = 0; i < shape.vc.n_elem; ++i) shape.vc[i] = -(float)i;
+
+  PackedVertices packed;
+  PackVertices(shape, false, packed);
+  ASSERT_EQ(2u, packed.attribs.size());
+  EXPECT_EQ(28, packed.stride);
+  EXPECT_EQ(12u, packed.attribs[1].offset);
+  ASSERT_EQ(5u * 28, packed.data.size());
+  for (size_t i = 0; i < 5; ++i) {
+    float vertex[7];
+    memcpy(vertex, &packed.data[i * 28], sizeof(vertex));
+    for (int k = 0; k < 3; ++k) EXPECT_EQ(shape.v(k, i), vertex[k]);
+    for (int k = 0; k < 4; ++k) EXPECT_EQ(shape.vc(k, i), vertex[3 + k]);
+  }
+}
+
+TEST(VertexFormat, Quantized) {
+  const size_t n = 100;
+  Shape shape;
+  shape.v.set_size(3, n);
+  shape.vn.set_size(3, n);
+  shape.vc.set_size(4, n);
+  shape.uv.set_size(2, n);
+  srand(4);
+  for (size_t i = 0; i < n; ++i) {
+    glm::vec3 normal = Direction(Random(), Random(), Random());
+    for (int k = 0; k < 3; ++k) {
+      shape.v(k, i) = Random() * (k + 1) + 10;
+      shape.vn(k, i) = normal[k];
+    }
+    for (int k = 0; k < 4; ++k) shape.vc(k, i) = (Random() + 1) / 2;
+    for (int k = 0; k < 2; ++k) shape.uv(k, i) = Random();
+  }
+
+  PackedVertices packed;
+  PackVertices(shape, true, packed);
+  ASSERT_EQ(4u, packed.attribs.size());
+  EXPECT_EQ(20, packed.stride);
+  EXPECT_TRUE(packed.has_octahedral_normals);
+  ASSERT_EQ(n * 20, packed.data.size());
+
+  for (size_t i = 0; i < n; ++i) {
+    const uint8_t* vertex = &packed.data[i * 20];
+    uint16_t position[3];
+    memcpy(position, vertex + packed.attribs[0].offset, sizeof(position));
+    for (int k = 0; k < 3; ++k) {
+      float decoded = position[k] / 65535.0f * packed.position_scale[k] +
+                      packed.position_offset[k];
+      EXPECT_NEAR(shape.v(k, i), decoded, 1e-4 * (k + 1));
+    }
+
+    int16_t normal[2];
+    memcpy(normal, vertex + packed.attribs[1].offset, sizeof(normal));
+    glm::vec3 expected(shape.vn(0, i), shape.vn(1, i), shape.vn(2, i));
+    EXPECT_LT(glm::length(expected - DecodeOctahedral(normal)), 1e-4f);
+
+    for (int k = 0; k < 4; ++k) {
+      EXPECT_NEAR(shape.vc(k, i),
+                  vertex[packed.attribs[2].offset + k] / 255.0f, 0.5 / 255);
+    }
+    uint16_t uv[2];
+    memcpy(uv, vertex + packed.attribs[3].offset, sizeof(uv));
+    for (int k = 0; k < 2; ++k) EXPECT_EQ(FloatToHalf(shape.uv(k, i)), uv[k]);
+  }
+}